@@ -0,0 +1,563 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE libopusfile SOFTWARE CODEC SOURCE CODE. *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE libopusfile SOURCE CODE IS (C) COPYRIGHT 1994-2020           *
+ * by the Xiph.Org Foundation and contributors https://xiph.org/    *
+ *                                                                  *
+ ********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/*A decoding benchmark.
+  With no arguments, this synthesizes a small corpus (mono, stereo, 5.1, 7.1,
+   a VBR file whose bitrate jumps around every few seconds, and a heavily
+   chained file) with libopus.
+  Otherwise, it uses the files named on the command line.
+  Each file is opened from a real file, from memory, and through
+   application-provided callbacks, and for each we measure the open latency,
+   the throughput of op_read(), op_read_float(), and op_read_stereo(), and the
+   latency of random op_pcm_seek() and op_raw_seek() calls.
+  For op_pcm_seek(), we also report the number of bisection steps and pages
+   read per seek, from op_get_stats().
+  For the callback source, we also report the number of read and seek calls
+   per operation.
+  Times are CPU time, as measured by clock().*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <opusfile.h>
+#if defined(_WIN32)
+# include "win32utf8.h"
+#endif
+
+/*The number of times to repeat the open test.*/
+#define BENCH_NOPENS  (20)
+/*The number of random seeks to make in each seek test.*/
+#define BENCH_NSEEKS  (100)
+/*The size of the buffer used for decoding, in samples (not per channel).*/
+#define BENCH_BUF_SIZE (120*48*8)
+/*The name of the temporary file used to test synthesized files.*/
+#define BENCH_TMP_PATH "opusfile_bench.tmp"
+
+#if !defined(M_PI)
+# define M_PI (3.1415926535897931)
+#endif
+
+typedef struct BenchBuffer BenchBuffer;
+typedef struct BenchStream BenchStream;
+typedef struct BenchFile   BenchFile;
+
+/*A growable block of memory.*/
+struct BenchBuffer{
+  unsigned char *data;
+  size_t         size;
+  size_t         cdata;
+};
+
+/*A memory stream accessed through our own callbacks, which counts calls.*/
+struct BenchStream{
+  const unsigned char *data;
+  opus_int64           size;
+  opus_int64           pos;
+  long                 nreads;
+  long                 nseeks;
+};
+
+/*A corpus entry.*/
+struct BenchFile{
+  char        name[64];
+  /*The path of the file, or NULL if it was synthesized.*/
+  const char *path;
+  BenchBuffer buf;
+};
+
+static int bench_buffer_append(BenchBuffer *_buf,
+ const unsigned char *_data,size_t _size){
+  if(_buf->size+_size>_buf->cdata){
+    unsigned char *data;
+    size_t         cdata;
+    cdata=2*_buf->cdata+_size;
+    data=(unsigned char *)realloc(_buf->data,cdata);
+    if(data==NULL)return -1;
+    _buf->data=data;
+    _buf->cdata=cdata;
+  }
+  memcpy(_buf->data+_buf->size,_data,_size);
+  _buf->size+=_size;
+  return 0;
+}
+
+static int bench_write_page(BenchBuffer *_buf,const ogg_page *_og){
+  if(bench_buffer_append(_buf,_og->header,_og->header_len)<0)return -1;
+  return bench_buffer_append(_buf,_og->body,_og->body_len);
+}
+
+static void bench_put_le32(unsigned char *_dst,opus_uint32 _x){
+  _dst[0]=(unsigned char)(_x&0xFF);
+  _dst[1]=(unsigned char)(_x>>8&0xFF);
+  _dst[2]=(unsigned char)(_x>>16&0xFF);
+  _dst[3]=(unsigned char)(_x>>24&0xFF);
+}
+
+/*The bitrates (per channel) a VBR link switches between.*/
+static const opus_int32 BENCH_VBR_RATES[4]={8000,16000,64000,128000};
+
+/*Encode one link of synthetic audio and append it to _buf.
+  If _vbr is non-zero, the bitrate changes at random every 3 seconds.*/
+static int bench_encode_link(BenchBuffer *_buf,int _channels,
+ opus_int32 _nsamples,int _serialno,int _vbr,opus_uint32 *_seed){
+  static const char     VENDOR[]="opusfile_bench";
+  OpusMSEncoder        *enc;
+  ogg_stream_state      os;
+  ogg_packet            op;
+  ogg_page              og;
+  unsigned char         head[19+2+8];
+  unsigned char         tags[8+4+sizeof(VENDOR)-1+4];
+  unsigned char         packet[1500*8];
+  float                 pcm[960*8];
+  unsigned char         mapping[8];
+  opus_int32            lookahead;
+  opus_int32            pos;
+  int                   family;
+  int                   streams;
+  int                   coupled;
+  int                   head_size;
+  int                   err;
+  int                   ci;
+  family=_channels>2;
+  enc=opus_multistream_surround_encoder_create(48000,_channels,family,
+   &streams,&coupled,mapping,OPUS_APPLICATION_AUDIO,&err);
+  if(enc==NULL)return -1;
+  opus_multistream_encoder_ctl(enc,OPUS_SET_BITRATE(48000*_channels));
+  opus_multistream_encoder_ctl(enc,OPUS_GET_LOOKAHEAD(&lookahead));
+  ogg_stream_init(&os,_serialno);
+  memcpy(head,"OpusHead",8);
+  head[8]=1;
+  head[9]=(unsigned char)_channels;
+  head[10]=(unsigned char)(lookahead&0xFF);
+  head[11]=(unsigned char)(lookahead>>8&0xFF);
+  bench_put_le32(head+12,48000);
+  head[16]=head[17]=0;
+  head[18]=(unsigned char)family;
+  head_size=19;
+  if(family){
+    head[19]=(unsigned char)streams;
+    head[20]=(unsigned char)coupled;
+    memcpy(head+21,mapping,_channels);
+    head_size+=2+_channels;
+  }
+  memcpy(tags,"OpusTags",8);
+  bench_put_le32(tags+8,sizeof(VENDOR)-1);
+  memcpy(tags+12,VENDOR,sizeof(VENDOR)-1);
+  bench_put_le32(tags+12+sizeof(VENDOR)-1,0);
+  memset(&op,0,sizeof(op));
+  op.packet=head;
+  op.bytes=head_size;
+  op.b_o_s=1;
+  ogg_stream_packetin(&os,&op);
+  while(ogg_stream_flush(&os,&og))bench_write_page(_buf,&og);
+  op.packet=tags;
+  op.bytes=sizeof(tags);
+  op.b_o_s=0;
+  op.packetno=1;
+  ogg_stream_packetin(&os,&op);
+  while(ogg_stream_flush(&os,&og))bench_write_page(_buf,&og);
+  /*Encode enough extra frames to flush the encoder's lookahead.*/
+  for(pos=0;pos<_nsamples+lookahead;pos+=960){
+    opus_int32 nbytes;
+    int        i;
+    if(_vbr&&pos%(3*48000)==0){
+      *_seed=*_seed*1103515245+12345&0xFFFFFFFFU;
+      opus_multistream_encoder_ctl(enc,
+       OPUS_SET_BITRATE(BENCH_VBR_RATES[*_seed>>16&3]*_channels));
+    }
+    for(i=0;i<960;i++){
+      for(ci=0;ci<_channels;ci++){
+        float s;
+        /*A tone per channel, plus a little noise.*/
+        *_seed=*_seed*1103515245+12345&0xFFFFFFFFU;
+        s=0.3F*(float)sin(2*M_PI*(220+110*ci)*(pos+i)/48000.0);
+        s+=0.05F*((float)(*_seed>>8)/16777216.0F-0.5F);
+        pcm[i*_channels+ci]=s;
+      }
+    }
+    nbytes=opus_multistream_encode_float(enc,pcm,960,packet,sizeof(packet));
+    if(nbytes<0)break;
+    op.packet=packet;
+    op.bytes=nbytes;
+    op.packetno++;
+    op.e_o_s=pos+960>=_nsamples+lookahead;
+    /*End-trim the last packet.*/
+    op.granulepos=op.e_o_s?_nsamples+lookahead:pos+960;
+    ogg_stream_packetin(&os,&op);
+    while(ogg_stream_pageout(&os,&og))bench_write_page(_buf,&og);
+  }
+  while(ogg_stream_flush(&os,&og))bench_write_page(_buf,&og);
+  ogg_stream_clear(&os);
+  opus_multistream_encoder_destroy(enc);
+  return pos<_nsamples+lookahead?-1:0;
+}
+
+static int bench_synthesize(BenchFile *_files){
+  static const int CHANNELS[4]={1,2,6,8};
+  static const char *NAMES[4]={"mono","stereo","5.1","7.1"};
+  opus_uint32 seed;
+  int         nfiles;
+  int         i;
+  seed=1;
+  nfiles=0;
+  for(i=0;i<4;i++){
+    memset(_files+nfiles,0,sizeof(*_files));
+    strcpy(_files[nfiles].name,NAMES[i]);
+    if(bench_encode_link(&_files[nfiles].buf,CHANNELS[i],20*48000,
+     i+1,0,&seed)<0){
+      return -1;
+    }
+    nfiles++;
+  }
+  /*A long VBR file, where assuming a constant bitrate makes seeking slow.*/
+  memset(_files+nfiles,0,sizeof(*_files));
+  strcpy(_files[nfiles].name,"vbr");
+  if(bench_encode_link(&_files[nfiles].buf,2,300*48000,50,1,&seed)<0){
+    return -1;
+  }
+  nfiles++;
+  /*A heavily chained file, switching channel counts every link.*/
+  memset(_files+nfiles,0,sizeof(*_files));
+  strcpy(_files[nfiles].name,"chained");
+  for(i=0;i<40;i++){
+    if(bench_encode_link(&_files[nfiles].buf,CHANNELS[i%3],24000,
+     100+i,0,&seed)<0){
+      return -1;
+    }
+  }
+  nfiles++;
+  return nfiles;
+}
+
+static int bench_load(BenchFile *_file,const char *_path){
+  unsigned char  chunk[65536];
+  FILE          *fp;
+  size_t         nread;
+  memset(_file,0,sizeof(*_file));
+  fp=fopen(_path,"rb");
+  if(fp==NULL)return -1;
+  do{
+    nread=fread(chunk,1,sizeof(chunk),fp);
+    if(bench_buffer_append(&_file->buf,chunk,nread)<0){
+      fclose(fp);
+      return -1;
+    }
+  }
+  while(nread>0);
+  fclose(fp);
+  _file->path=_path;
+  strncpy(_file->name,_path,sizeof(_file->name)-1);
+  return 0;
+}
+
+static int bench_read(void *_stream,unsigned char *_ptr,int _nbytes){
+  BenchStream *stream;
+  opus_int64   nbytes;
+  stream=(BenchStream *)_stream;
+  stream->nreads++;
+  nbytes=stream->size-stream->pos;
+  if(nbytes>_nbytes)nbytes=_nbytes;
+  if(nbytes<=0)return 0;
+  memcpy(_ptr,stream->data+stream->pos,(size_t)nbytes);
+  stream->pos+=nbytes;
+  return (int)nbytes;
+}
+
+static int bench_seek(void *_stream,opus_int64 _offset,int _whence){
+  BenchStream *stream;
+  opus_int64   pos;
+  stream=(BenchStream *)_stream;
+  stream->nseeks++;
+  switch(_whence){
+    case SEEK_SET:pos=_offset;break;
+    case SEEK_CUR:pos=stream->pos+_offset;break;
+    case SEEK_END:pos=stream->size+_offset;break;
+    default:return -1;
+  }
+  if(pos<0)return -1;
+  stream->pos=pos;
+  return 0;
+}
+
+static opus_int64 bench_tell(void *_stream){
+  return ((BenchStream *)_stream)->pos;
+}
+
+static const OpusFileCallbacks BENCH_CALLBACKS={
+  bench_read,
+  bench_seek,
+  bench_tell,
+  NULL
+};
+
+typedef enum{
+  BENCH_SOURCE_FILE,
+  BENCH_SOURCE_MEMORY,
+  BENCH_SOURCE_CALLBACKS
+}BenchSource;
+
+static const char *BENCH_SOURCE_NAMES[3]={"file","memory","callbacks"};
+
+static OggOpusFile *bench_open(const BenchFile *_file,const char *_path,
+ BenchSource _source,BenchStream *_stream){
+  int error;
+  switch(_source){
+    case BENCH_SOURCE_FILE:return op_open_file(_path,&error);
+    case BENCH_SOURCE_MEMORY:{
+      return op_open_memory(_file->buf.data,_file->buf.size,&error);
+    }
+    default:{
+      memset(_stream,0,sizeof(*_stream));
+      _stream->data=_file->buf.data;
+      _stream->size=(opus_int64)_file->buf.size;
+      return op_open_callbacks(_stream,&BENCH_CALLBACKS,NULL,0,&error);
+    }
+  }
+}
+
+/*Open a stream in lazy mode, which only finds the first link up front.*/
+static OggOpusFile *bench_open_lazy(const BenchFile *_file,const char *_path,
+ BenchSource _source,BenchStream *_stream){
+  OggOpusFile *of;
+  int          error;
+  switch(_source){
+    case BENCH_SOURCE_FILE:{
+      of=op_test_file(_path,&error);
+    }break;
+    case BENCH_SOURCE_MEMORY:{
+      of=op_test_memory(_file->buf.data,_file->buf.size,&error);
+    }break;
+    default:{
+      memset(_stream,0,sizeof(*_stream));
+      _stream->data=_file->buf.data;
+      _stream->size=(opus_int64)_file->buf.size;
+      of=op_test_callbacks(_stream,&BENCH_CALLBACKS,NULL,0,&error);
+    }break;
+  }
+  if(of==NULL)return NULL;
+  if(op_set_lazy_links(of,1)<0||op_test_open(of)<0){
+    op_free(of);
+    return NULL;
+  }
+  return of;
+}
+
+static double bench_elapsed(clock_t _start){
+  return (double)(clock()-_start)/CLOCKS_PER_SEC;
+}
+
+static void bench_report(const BenchFile *_file,BenchSource _source,
+ const char *_test,const char *_result,const BenchStream *_stream,long _nops){
+  printf("%-10s %-10s %-12s %-26s",_file->name,BENCH_SOURCE_NAMES[_source],
+   _test,_result);
+  if(_stream!=NULL&&_nops>0){
+    printf(" %8.1f reads/op %8.1f seeks/op",
+     _stream->nreads/(double)_nops,_stream->nseeks/(double)_nops);
+  }
+  printf("\n");
+}
+
+static opus_uint32 bench_rand(opus_uint32 *_seed){
+  *_seed=*_seed*1664525+1013904223&0xFFFFFFFFU;
+  return *_seed>>8;
+}
+
+typedef int (*bench_read_func)(OggOpusFile *_of,void *_pcm,int _buf_size);
+
+static int bench_op_read(OggOpusFile *_of,void *_pcm,int _buf_size){
+  return op_read(_of,(opus_int16 *)_pcm,_buf_size,NULL);
+}
+
+static int bench_op_read_float(OggOpusFile *_of,void *_pcm,int _buf_size){
+  return op_read_float(_of,(float *)_pcm,_buf_size,NULL);
+}
+
+static int bench_op_read_stereo(OggOpusFile *_of,void *_pcm,int _buf_size){
+  return op_read_stereo(_of,(opus_int16 *)_pcm,_buf_size);
+}
+
+static void bench_file(const BenchFile *_file,const char *_path,
+ BenchSource _source){
+  static float     pcm[BENCH_BUF_SIZE];
+  static const struct{
+    const char      *name;
+    bench_read_func  read;
+  }READS[3]={
+    {"op_read",bench_op_read},
+    {"op_read_float",bench_op_read_float},
+    {"op_read_stereo",bench_op_read_stereo}
+  };
+  BenchStream      stream;
+  BenchStream     *pstream;
+  OggOpusFile     *of;
+  OpusFileStats    stats;
+  char             result[64];
+  clock_t          start;
+  double           elapsed;
+  opus_int64       size;
+  ogg_int64_t      total;
+  opus_uint32      seed;
+  int              ti;
+  int              i;
+  pstream=_source==BENCH_SOURCE_CALLBACKS?&stream:NULL;
+  /*Open latency.*/
+  start=clock();
+  for(i=0;i<BENCH_NOPENS;i++){
+    of=bench_open(_file,_path,_source,&stream);
+    if(of==NULL){
+      fprintf(stderr,"Failed to open '%s' from %s.\n",
+       _file->name,BENCH_SOURCE_NAMES[_source]);
+      return;
+    }
+    if(i+1<BENCH_NOPENS)op_free(of);
+  }
+  elapsed=bench_elapsed(start);
+  sprintf(result,"%10.3f ms/open",1000*elapsed/BENCH_NOPENS);
+  /*Only count the calls made by the last open.*/
+  bench_report(_file,_source,"open",result,pstream,1);
+  total=op_pcm_total(of,-1);
+  size=op_raw_total(of,-1);
+  op_free(of);
+  /*Lazy open latency.*/
+  start=clock();
+  for(i=0;i<BENCH_NOPENS;i++){
+    of=bench_open_lazy(_file,_path,_source,&stream);
+    if(of==NULL){
+      fprintf(stderr,"Failed to open '%s' lazily from %s.\n",
+       _file->name,BENCH_SOURCE_NAMES[_source]);
+      return;
+    }
+    if(i+1<BENCH_NOPENS)op_free(of);
+  }
+  elapsed=bench_elapsed(start);
+  sprintf(result,"%10.3f ms/open",1000*elapsed/BENCH_NOPENS);
+  bench_report(_file,_source,"lazy open",result,pstream,1);
+  op_free(of);
+  /*Decoding throughput.*/
+  for(ti=0;ti<3;ti++){
+    ogg_int64_t nsamples;
+    int         ret;
+    of=bench_open(_file,_path,_source,&stream);
+    if(of==NULL)return;
+    if(pstream!=NULL)stream.nreads=stream.nseeks=0;
+    nsamples=0;
+    start=clock();
+    do{
+      ret=(*READS[ti].read)(of,pcm,BENCH_BUF_SIZE);
+      if(ret>0)nsamples+=ret;
+    }
+    while(ret>0||ret==OP_HOLE);
+    elapsed=bench_elapsed(start);
+    if(elapsed<=0)elapsed=1.0/CLOCKS_PER_SEC;
+    sprintf(result,"%10.3f Msamples/s %6.0fx",
+     nsamples/elapsed*1E-6,nsamples/(48000*elapsed));
+    bench_report(_file,_source,READS[ti].name,result,pstream,
+     (long)((nsamples+959)/960));
+    op_free(of);
+  }
+  /*Random PCM seeks.*/
+  of=bench_open(_file,_path,_source,&stream);
+  if(of==NULL)return;
+  if(pstream!=NULL)stream.nreads=stream.nseeks=0;
+  op_reset_stats(of);
+  seed=1;
+  start=clock();
+  for(i=0;i<BENCH_NSEEKS;i++){
+    ogg_int64_t target;
+    target=(ogg_int64_t)((double)bench_rand(&seed)/16777216.0*total);
+    if(op_pcm_seek(of,target)<0){
+      fprintf(stderr,"op_pcm_seek() failed in '%s'.\n",_file->name);
+      break;
+    }
+  }
+  elapsed=bench_elapsed(start);
+  sprintf(result,"%10.3f ms/seek",1000*elapsed/BENCH_NSEEKS);
+  bench_report(_file,_source,"op_pcm_seek",result,pstream,BENCH_NSEEKS);
+  if(op_get_stats(of,&stats)>=0){
+    sprintf(result,"%5.1f steps %6.1f pages",
+     stats.bisect_steps/(double)BENCH_NSEEKS,
+     stats.pages_framed/(double)BENCH_NSEEKS);
+    bench_report(_file,_source,"  per seek",result,NULL,0);
+  }
+  /*Random raw seeks.*/
+  if(pstream!=NULL)stream.nreads=stream.nseeks=0;
+  start=clock();
+  for(i=0;i<BENCH_NSEEKS;i++){
+    opus_int64 target;
+    target=(opus_int64)((double)bench_rand(&seed)/16777216.0*size);
+    if(op_raw_seek(of,target)<0){
+      fprintf(stderr,"op_raw_seek() failed in '%s'.\n",_file->name);
+      break;
+    }
+  }
+  elapsed=bench_elapsed(start);
+  sprintf(result,"%10.3f ms/seek",1000*elapsed/BENCH_NSEEKS);
+  bench_report(_file,_source,"op_raw_seek",result,pstream,BENCH_NSEEKS);
+  op_free(of);
+}
+
+int main(int _argc,const char **_argv){
+  BenchFile *files;
+  int        nfiles;
+  int        fi;
+#if defined(_WIN32)
+  win32_utf8_setup(&_argc,&_argv);
+#endif
+  files=(BenchFile *)malloc(sizeof(*files)*(_argc>1?_argc-1:6));
+  if(files==NULL)return EXIT_FAILURE;
+  if(_argc>1){
+    for(nfiles=0;nfiles<_argc-1;nfiles++){
+      if(bench_load(files+nfiles,_argv[nfiles+1])<0){
+        fprintf(stderr,"Failed to read '%s'.\n",_argv[nfiles+1]);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  else{
+    nfiles=bench_synthesize(files);
+    if(nfiles<0){
+      fprintf(stderr,"Failed to synthesize the test corpus.\n");
+      return EXIT_FAILURE;
+    }
+  }
+  printf("%-10s %-10s %-12s %s\n","file","source","test","result");
+  for(fi=0;fi<nfiles;fi++){
+    const char *path;
+    int         source;
+    path=files[fi].path;
+    if(path==NULL){
+      FILE *fp;
+      /*Write synthesized files out so we can test reading them from disk.*/
+      path=BENCH_TMP_PATH;
+      fp=fopen(path,"wb");
+      if(fp==NULL||fwrite(files[fi].buf.data,1,files[fi].buf.size,fp)
+       !=files[fi].buf.size){
+        fprintf(stderr,"Failed to write '%s'.\n",path);
+        if(fp!=NULL)fclose(fp);
+        return EXIT_FAILURE;
+      }
+      fclose(fp);
+    }
+    for(source=BENCH_SOURCE_FILE;source<=BENCH_SOURCE_CALLBACKS;source++){
+      bench_file(files+fi,path,(BenchSource)source);
+    }
+    if(files[fi].path==NULL)remove(path);
+    free(files[fi].buf.data);
+  }
+  free(files);
+  return EXIT_SUCCESS;
+}
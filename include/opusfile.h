@@ -129,7 +129,14 @@ typedef struct OpusHead          OpusHead;
 typedef struct OpusTags          OpusTags;
 typedef struct OpusPictureTag    OpusPictureTag;
 typedef struct OpusServerInfo    OpusServerInfo;
+typedef struct OpusHTTPConnPool  OpusHTTPConnPool;
+typedef struct OpusHTTPCache     OpusHTTPCache;
 typedef struct OpusFileCallbacks OpusFileCallbacks;
+typedef struct OpusChainSource   OpusChainSource;
+typedef struct OpusPacketInfo    OpusPacketInfo;
+typedef struct OpusDecoderPool   OpusDecoderPool;
+typedef struct OpusFileStats     OpusFileStats;
+typedef struct OpusHTTPStats     OpusHTTPStats;
 typedef struct OggOpusFile       OggOpusFile;
 
 /*Warning attributes for libopusfile functions.*/
@@ -199,6 +206,11 @@ typedef struct OggOpusFile       OggOpusFile;
 #define OP_ENOSEEK       (-138)
 /**The first or last granule position of a link failed basic validity checks.*/
 #define OP_EBADTIMESTAMP (-139)
+/**A stream put in non-blocking mode with op_url_stream_set_nonblocking() had
+    no data ready.
+   The call can be repeated once the stream's socket becomes readable (see
+    op_url_stream_get_poll_fd()).*/
+#define OP_EAGAIN        (-140)
 
 /**@}*/
 /**@}*/
@@ -697,6 +709,10 @@ void opus_picture_tag_clear(OpusPictureTag *_pic) OP_ARG_NONNULL(1);
 #define OP_HTTP_PROXY_USER_REQUEST            (6656)
 #define OP_HTTP_PROXY_PASS_REQUEST            (6720)
 #define OP_GET_SERVER_INFO_REQUEST            (6784)
+#define OP_HTTP_CONN_POOL_REQUEST             (6848)
+#define OP_HTTP_PREFETCH_SIZE_REQUEST         (6912)
+#define OP_HTTP_CACHE_REQUEST                 (6976)
+#define OP_HTTP_FETCH_TAIL_REQUEST            (7040)
 
 #define OP_URL_OPT(_request) ((char *)(_request))
 
@@ -705,6 +721,9 @@ void opus_picture_tag_clear(OpusPictureTag *_pic) OP_ARG_NONNULL(1);
 #define OP_CHECK_INT(_x) ((void)((_x)==(opus_int32)0),(opus_int32)(_x))
 #define OP_CHECK_CONST_CHAR_PTR(_x) ((_x)+((_x)-(const char *)(_x)))
 #define OP_CHECK_SERVER_INFO_PTR(_x) ((_x)+((_x)-(OpusServerInfo *)(_x)))
+#define OP_CHECK_HTTP_CONN_POOL_PTR(_x) \
+ ((_x)+((_x)-(OpusHTTPConnPool *)(_x)))
+#define OP_CHECK_HTTP_CACHE_PTR(_x) ((_x)+((_x)-(OpusHTTPCache *)(_x)))
 
 /**@endcond*/
 
@@ -763,6 +782,105 @@ void opus_server_info_init(OpusServerInfo *_info) OP_ARG_NONNULL(1);
    \note If you use this function, you must link against <tt>libopusurl</tt>.*/
 void opus_server_info_clear(OpusServerInfo *_info) OP_ARG_NONNULL(1);
 
+/**Creates a pool of idle HTTP connections that can be shared by many URL
+    streams.
+   When a stream created with the #OP_HTTP_CONN_POOL option is closed, any of
+    its persistent (HTTP/1.1 keep-alive) connections that are idle and still
+    allowed to make more requests are kept in the pool, instead of being
+    closed.
+   The next stream to the same server can then pick one up instead of paying
+    for a new TCP connection and TLS handshake.
+   A connection is only re-used by a stream with the same scheme, host, port,
+    and proxy settings (including proxy credentials), and the same certificate
+    check setting.
+   Connections that have been idle for more than a few seconds are closed
+    instead of being re-used.
+   The pool also remembers the addresses of the last few hosts it resolved,
+    for up to 10 minutes, so streams to the same host do not have to wait for
+    another DNS lookup.
+   For https streams, the pool also shares one TLS context (with the system
+    certificate store already loaded) between all of its streams, and caches
+    the last few TLS sessions, so that a new connection to the same host can
+    resume a session instead of performing a full handshake.
+   A pool is not thread-safe.
+   Use a separate pool for each thread, or serialize all calls that might
+    use the pool on every stream attached to it (including opening, reading,
+    seeking, and closing).
+   \param _max_idle The maximum number of idle connections to keep.
+                    When the pool is full, the least recently used connection
+                     is closed to make room.
+   \return The new pool, or <code>NULL</code> if \a _max_idle was not
+            positive, memory could not be allocated, or <tt>libopusurl</tt>
+            was built without HTTP support.
+   \note If you use this function, you must link against <tt>libopusurl</tt>.*/
+OP_WARN_UNUSED_RESULT OpusHTTPConnPool *op_http_conn_pool_create(
+ int _max_idle);
+
+/**Closes all of the connections in a pool created by
+    op_http_conn_pool_create() and frees it.
+   No stream that uses the pool may still be open.
+   \param _pool The pool to free.
+                This may be <code>NULL</code>, in which case nothing happens.
+   \note If you use this function, you must link against <tt>libopusurl</tt>.*/
+void op_http_conn_pool_free(OpusHTTPConnPool *_pool);
+
+/**Resolves a host name and stores its addresses in a connection pool.
+   A stream that uses the pool and connects to this host and port soon
+    afterwards can then skip the DNS lookup.
+   The lookup itself blocks, so call this when a delay is acceptable, e.g.,
+    after opening the current track, to prepare for the next one.
+   Like every other use of the pool, this must not run at the same time as
+    any other call that uses the same pool.
+   \param _pool The pool in which to store the addresses.
+   \param _host The host to resolve.
+                This should be the proxy server, if the streams will use one.
+   \param _port The port the streams will connect to.
+                This must be in the range 0...65535 (inclusive).
+   \return 0 on success, or a negative value on error.
+   \retval #OP_FALSE The host could not be resolved.
+   \retval #OP_EINVAL \a _port was out of range.
+   \retval #OP_EIMPL  <tt>libopusurl</tt> was built without HTTP support.
+   \note If you use this function, you must link against <tt>libopusurl</tt>.*/
+int op_url_prefetch_host(OpusHTTPConnPool *_pool,
+ const char *_host,opus_int32 _port) OP_ARG_NONNULL(1) OP_ARG_NONNULL(2);
+
+/**Opens a persistent on-disk cache of data fetched from http/https servers.
+   Streams created with the #OP_HTTP_CACHE option store the byte ranges they
+    download in the cache, and read them back from disk instead of fetching
+    them again, including when a later stream opens the same URL.
+   Only seekable streams are cached, and only if the server sends a strong
+    <tt>ETag</tt> or a <tt>Last-Modified</tt> header.
+   The stored data is keyed by the URL passed to the stream function.
+   It is only used if the initial response for a new stream has the same
+    validator and length; otherwise it is thrown away and fetched again.
+   The initial request is still always made, and it also supplies data
+    that is not in the cache yet.
+   When the cache grows past its size limit, the least recently used
+    resources that no open stream is reading are removed.
+   The cache keeps an index file and one data file per resource in \a _dir.
+   The index is written out whenever a stream using the cache is closed and
+    when the cache is freed.
+   A cache is not thread-safe, and a directory must not be used by more than
+    one cache object at a time (including in other processes).
+   \param _dir      The directory to keep the cache in.
+                    This must already exist.
+   \param _max_size The maximum number of bytes of data to store.
+   \return The new cache, or <code>NULL</code> if \a _max_size was not
+            positive, memory could not be allocated, or <tt>libopusurl</tt>
+            was built without HTTP support.
+   \note If you use this function, you must link against <tt>libopusurl</tt>.*/
+OP_WARN_UNUSED_RESULT OpusHTTPCache *op_http_cache_create(const char *_dir,
+ opus_int64 _max_size) OP_ARG_NONNULL(1);
+
+/**Writes out the index of a cache created by op_http_cache_create() and frees
+    it.
+   The data stays on disk for the next cache opened in the same directory.
+   No stream that uses the cache may still be open.
+   \param _cache The cache to free.
+                 This may be <code>NULL</code>, in which case nothing happens.
+   \note If you use this function, you must link against <tt>libopusurl</tt>.*/
+void op_http_cache_free(OpusHTTPCache *_cache);
+
 /**Skip the certificate check when connecting via TLS/SSL (https).
    \param _b <code>opus_int32</code>: Whether or not to skip the certificate
               check.
@@ -843,6 +961,74 @@ void opus_server_info_clear(OpusServerInfo *_info) OP_ARG_NONNULL(1);
 #define OP_GET_SERVER_INFO(_info) \
  OP_URL_OPT(OP_GET_SERVER_INFO_REQUEST),OP_CHECK_SERVER_INFO_PTR(_info)
 
+/**Share idle connections with other streams through the given pool.
+   The stream will try to use an idle connection from the pool before opening
+    a new one, and will return its re-usable connections to the pool when it
+    is closed.
+   The pool must remain valid until the stream is closed.
+   This is ignored for non-http and non-https URLs.
+   \param _pool OpusHTTPConnPool *: The pool created with
+                                    op_http_conn_pool_create() to use.
+                                   This may be <code>NULL</code> to disable
+                                    connection sharing.
+   \hideinitializer*/
+#define OP_HTTP_CONN_POOL(_pool) \
+ OP_URL_OPT(OP_HTTP_CONN_POOL_REQUEST),OP_CHECK_HTTP_CONN_POOL_PTR(_pool)
+
+/**Buffer up to the given number of bytes of the response ahead of the
+    current read position.
+   Each time the stream is read, any data that has already arrived from the
+    server is moved into this buffer without blocking, up to the end of the
+    current response.
+   This keeps the TCP receive window open while the application is busy
+    decoding, so the server is not throttled between reads.
+   A forward seek to a position inside the buffered data is served from the
+    buffer, without touching the connection.
+   No background thread is used: the buffer is only filled from inside calls
+    to the stream's read function.
+   To buffer a given amount of playback time, multiply the desired duration
+    by the stream's bitrate (e.g., as returned by op_bitrate()).
+   This is ignored for non-http and non-https URLs.
+   \param _bytes <code>opus_int32</code>: The size of the buffer, in bytes.
+                 This may be 0 (the default) to disable buffering.
+                 Negative values cause the URL function this is passed to to
+                  fail.
+   \hideinitializer*/
+#define OP_HTTP_PREFETCH_SIZE(_bytes) \
+ OP_URL_OPT(OP_HTTP_PREFETCH_SIZE_REQUEST),OP_CHECK_INT(_bytes)
+
+/**Store the data the stream downloads in the given on-disk cache, and read
+    whatever it already has from there.
+   The cache must remain valid until the stream is closed.
+   This is ignored for non-http and non-https URLs.
+   \param _cache OpusHTTPCache *: The cache created with
+                                 op_http_cache_create() to use.
+                                This may be <code>NULL</code> to disable
+                                 caching.
+   \hideinitializer*/
+#define OP_HTTP_CACHE(_cache) \
+ OP_URL_OPT(OP_HTTP_CACHE_REQUEST),OP_CHECK_HTTP_CACHE_PTR(_cache)
+
+/**Request the end of the resource at the same time as the start.
+   To find the duration of a seekable stream, op_open_callbacks() needs the
+    last page, which normally costs a separate request after the initial one.
+   With this option, a second connection asks for the last 64&nbsp;kB as soon
+    as the response to the initial request arrives, so its round trip overlaps
+    reading the headers.
+   When the decoder first reads from that region, the whole response is read
+    into memory, and all later reads from it are served from there.
+   This costs an extra connection and up to 64&nbsp;kB of memory.
+   Nothing is requested if the server does not support range requests, or if
+    the resource is small enough that the initial request covers it.
+   This is ignored for non-http and non-https URLs.
+   \param _b <code>opus_int32</code>: Whether or not to fetch the end of the
+              resource early.
+             It is fetched if \a _b is non-zero, and not if \a _b is zero (the
+              default).
+   \hideinitializer*/
+#define OP_HTTP_FETCH_TAIL(_b) \
+ OP_URL_OPT(OP_HTTP_FETCH_TAIL_REQUEST),OP_CHECK_INT(_b)
+
 /**@}*/
 /**@}*/
 
@@ -865,7 +1051,14 @@ void opus_server_info_clear(OpusServerInfo *_info) OP_ARG_NONNULL(1);
                        This function may return fewer, though it will not
                         return zero unless it reaches end-of-file.
    \return The number of bytes successfully read, or a negative value on
-            error.*/
+            error.
+   \retval #OP_EAGAIN No data was available right now, but more may arrive
+                      later.
+                     This is passed on to the application by the reading
+                      functions, which may be called again to continue where
+                      they left off.
+                     It should only be returned by a stream the application
+                      has explicitly asked not to block.*/
 typedef int (*op_read_func)(void *_stream,unsigned char *_ptr,int _nbytes);
 
 /**Sets the position indicator for \a _stream.
@@ -986,6 +1179,28 @@ OP_WARN_UNUSED_RESULT void *op_freopen(OpusFileCallbacks *_cb,
 OP_WARN_UNUSED_RESULT void *op_mem_stream_create(OpusFileCallbacks *_cb,
  const unsigned char *_data,size_t _size) OP_ARG_NONNULL(1);
 
+/**Maps a file into memory and fills in a set of callbacks that can be used to
+    read from it.
+   Streams opened this way (and those created with op_mem_stream_create())
+    let the decoder frame Ogg pages directly from the mapped data, instead of
+    copying each chunk into an intermediate buffer first.
+   The file is mapped read-only, and the system is advised that it will mostly
+    be read sequentially.
+   The file must not be truncated while it is mapped.
+   \param[out] _cb   The callbacks to use for this file.
+                     If there is an error opening the file, nothing will be
+                      filled in here.
+   \param      _path The path to the file to open.
+                     On Windows, this string must be UTF-8 (to allow access to
+                      files whose names cannot be represented in the current
+                      MBCS code page).
+                     All other systems use the native character encoding.
+   \return A stream handle to use with the callbacks, or <code>NULL</code> on
+            error (including when \a _path does not name a regular file, or
+            the system does not support mapping it).*/
+OP_WARN_UNUSED_RESULT void *op_mmap_open(OpusFileCallbacks *_cb,
+ const char *_path) OP_ARG_NONNULL(1) OP_ARG_NONNULL(2);
+
 /**Creates a stream that reads from the given URL.
    This function behaves identically to op_url_stream_create(), except that it
     takes a va_list instead of a variable number of arguments.
@@ -1034,6 +1249,103 @@ OP_WARN_UNUSED_RESULT void *op_url_stream_vcreate(OpusFileCallbacks *_cb,
 OP_WARN_UNUSED_RESULT void *op_url_stream_create(OpusFileCallbacks *_cb,
  const char *_url,...) OP_ARG_NONNULL(1) OP_ARG_NONNULL(2);
 
+/**Puts a stream created by op_url_stream_create() into or out of non-blocking
+    mode.
+   In non-blocking mode, a read that would have to wait for more data from the
+    server returns #OP_EAGAIN instead, and so do op_read(), op_read_float(),
+    op_read_packet(), and the other reading functions that call it.
+   This lets a single event loop drive many streams: open each one normally,
+    turn on non-blocking mode, read until #OP_EAGAIN, and then wait for the
+    socket returned by op_url_stream_get_poll_fd() to become ready.
+   Only waiting for response data is avoided.
+   For <https:> streams, a read is only attempted once a complete TLS record
+    has arrived, so a partially received record returns #OP_EAGAIN rather
+    than blocking.
+   Opening a stream, seeking, reconnecting after the server closes the
+    connection, finishing a partially received response header or chunk
+    header, and a TLS renegotiation that needs to send data still block, so
+    non-blocking mode should be turned off around calls to
+    op_open_callbacks() and the seeking functions.
+   To use this with an #OggOpusFile, create the stream with
+    op_url_stream_create() and open it with op_open_callbacks(), so that the
+    application has the stream handle.
+   \param _stream      The stream handle returned by op_url_stream_create().
+   \param _cb          The callbacks filled in by op_url_stream_create().
+   \param _nonblocking Non-zero to enable non-blocking mode, or zero to go
+                        back to blocking reads.
+   \return 0 on success, or a negative value on error.
+   \retval #OP_EIMPL The stream does not use <http:> or <https:>.
+                     Streams that read from a file never wait for the
+                      network, and do not need this.
+   \note If you use this function, you must link against <tt>libopusurl</tt>.*/
+int op_url_stream_set_nonblocking(void *_stream,const OpusFileCallbacks *_cb,
+ int _nonblocking) OP_ARG_NONNULL(1) OP_ARG_NONNULL(2);
+
+/**Retrieves the socket a non-blocking stream is waiting on.
+   After a read returns #OP_EAGAIN, the application should wait until this
+    socket is ready for the returned events before reading again.
+   The socket can change whenever the stream reads, so this should be called
+    again after every #OP_EAGAIN.
+   \param      _stream The stream handle returned by op_url_stream_create().
+   \param      _cb     The callbacks filled in by op_url_stream_create().
+   \param[out] _fd     Returns the socket descriptor.
+                       On Windows, this is a <code>SOCKET</code> cast to an
+                        <code>int</code>.
+   \param[out] _events Returns the <code>poll()</code> events to wait for
+                        (currently always <code>POLLIN</code>).
+   \return 0 on success, or a negative value on error.
+   \retval #OP_FALSE The next read will not return #OP_EAGAIN (e.g., because
+                      the stream has data buffered, or has no open
+                      connection), so there is nothing to wait for.
+   \retval #OP_EIMPL The stream does not use <http:> or <https:>.
+   \note If you use this function, you must link against <tt>libopusurl</tt>.*/
+int op_url_stream_get_poll_fd(void *_stream,const OpusFileCallbacks *_cb,
+ int *_fd,int *_events) OP_ARG_NONNULL(1) OP_ARG_NONNULL(2)
+ OP_ARG_NONNULL(3) OP_ARG_NONNULL(4);
+
+/**The network measurements and request sizing decisions of an http/https
+    stream, as returned by op_url_stream_get_stats().
+   When the server supports pipelining, the stream reads the resource with a
+    series of range requests.
+   The first request after a seek asks for about one bandwidth-delay product
+    (but at least 32&nbsp;kB), since another seek may follow soon.
+   While reading linearly, each request asks for at least twice as much as the
+    previous one, and at least four bandwidth-delay products, until it passes
+    1&nbsp;MB and the stream just asks for the rest of the resource.*/
+struct OpusHTTPStats{
+  /**The estimated time to open a new connection, in milliseconds.*/
+  opus_int32 connect_ms;
+  /**The estimated time from sending a request on an open connection until
+      its response headers arrive, in milliseconds.*/
+  opus_int32 latency_ms;
+  /**The most recent throughput estimate, in bytes per second, or 0 if
+      nothing has been measured yet.*/
+  opus_int64 read_rate;
+  /**The estimated bandwidth-delay product, in bytes.
+     This is \a read_rate times \a latency_ms.*/
+  opus_int64 bdp;
+  /**The number of range requests made after the initial one.*/
+  opus_int64 requests;
+  /**The number of bytes asked for by the most recent range request, or -1 if
+      it asked for the rest of the resource (or there has not been one).*/
+  opus_int64 last_request_size;
+  /**The number of bytes the next pipelined request on the current
+      connection will ask for, or -1 if it will ask for the rest of the
+      resource or there will not be one.*/
+  opus_int32 next_request_size;
+};
+
+/**Retrieves the network measurements and request sizing decisions of a
+    stream created by op_url_stream_create().
+   \param      _stream The stream handle returned by op_url_stream_create().
+   \param      _cb     The callbacks filled in by op_url_stream_create().
+   \param[out] _stats  Returns the current values.
+   \return 0 on success, or a negative value on error.
+   \retval #OP_EIMPL The stream does not use <http:> or <https:>.
+   \note If you use this function, you must link against <tt>libopusurl</tt>.*/
+int op_url_stream_get_stats(void *_stream,const OpusFileCallbacks *_cb,
+ OpusHTTPStats *_stats) OP_ARG_NONNULL(1) OP_ARG_NONNULL(2) OP_ARG_NONNULL(3);
+
 /**@}*/
 /**@}*/
 
@@ -1230,6 +1542,148 @@ OP_WARN_UNUSED_RESULT OggOpusFile *op_open_callbacks(void *_stream,
  const OpusFileCallbacks *_cb,const unsigned char *_initial_data,
  size_t _initial_bytes,int *_error) OP_ARG_NONNULL(2);
 
+/**Open a stream using the given set of callbacks to access it, and a link
+    index previously created with op_link_index_export().
+   Opening a seekable stream normally requires scanning it to find the
+    boundaries and durations of each link, which can take many seeks for
+    chained streams.
+   If the index matches the stream, this scan is skipped entirely, and the
+    link structure is loaded from the index instead.
+   The index is checked against the size of the stream and the CRCs of its
+    first and last pages, as well as the offsets, starting timestamp, serial
+    number, and ID and comment headers of the first link.
+   If it does not match (e.g., because the file was modified after the index
+    was created), or the stream is not seekable, it is ignored, and the stream
+    is opened exactly as with op_open_callbacks().
+   \param _stream        The stream to read from (e.g., a <code>FILE *</code>).
+   \param _cb            The callbacks with which to access the stream.
+                         See op_open_callbacks() for details.
+   \param _initial_data  An initial buffer of data from the start of the
+                          stream.
+   \param _initial_bytes The number of bytes in \a _initial_data.
+   \param _index         The link index to use.
+                         You may pass <code>NULL</code>, in which case this
+                          function behaves identically to
+                          op_open_callbacks().
+                         The contents are not retained after this function
+                          returns.
+   \param _index_size    The number of bytes in \a _index.
+   \param[out] _error    Returns 0 on success, or a failure code on error.
+                         You may pass in <code>NULL</code> if you don't want
+                          the failure code.
+                         See op_open_callbacks() for a full list of failure
+                          codes.
+   \return A freshly opened \c OggOpusFile, or <code>NULL</code> on error.
+           <tt>libopusfile</tt> does <em>not</em> take ownership of the stream
+            if the call fails.*/
+OP_WARN_UNUSED_RESULT OggOpusFile *op_open_callbacks_with_index(void *_stream,
+ const OpusFileCallbacks *_cb,const unsigned char *_initial_data,
+ size_t _initial_bytes,const unsigned char *_index,size_t _index_size,
+ int *_error) OP_ARG_NONNULL(2);
+
+/**Open a stream from the given file path using a link index.
+   \see op_open_callbacks_with_index
+   \param      _path       The path to the file to open.
+   \param      _index      The link index to use, or <code>NULL</code>.
+   \param      _index_size The number of bytes in \a _index.
+   \param[out] _error      Returns 0 on success, or a failure code on error.
+                           You may pass in <code>NULL</code> if you don't want
+                            the failure code.
+                           The failure code will be #OP_EFAULT if the file
+                            could not be opened, or one of the other failure
+                            codes from op_open_callbacks() otherwise.
+   \return A freshly opened \c OggOpusFile, or <code>NULL</code> on error.*/
+OP_WARN_UNUSED_RESULT OggOpusFile *op_open_file_with_index(const char *_path,
+ const unsigned char *_index,size_t _index_size,int *_error)
+ OP_ARG_NONNULL(1);
+
+/**Open a stream from a memory buffer using a link index.
+   \see op_open_callbacks_with_index
+   \param      _data       The memory buffer to open.
+   \param      _size       The number of bytes in the buffer.
+   \param      _index      The link index to use, or <code>NULL</code>.
+   \param      _index_size The number of bytes in \a _index.
+   \param[out] _error      Returns 0 on success, or a failure code on error.
+                           You may pass in <code>NULL</code> if you don't want
+                            the failure code.
+                           See op_open_callbacks() for a full list of failure
+                            codes.
+   \return A freshly opened \c OggOpusFile, or <code>NULL</code> on error.*/
+OP_WARN_UNUSED_RESULT OggOpusFile *op_open_memory_with_index(
+ const unsigned char *_data,size_t _size,
+ const unsigned char *_index,size_t _index_size,int *_error);
+
+/**The op_open_chain() source is a file, given by its path.*/
+#define OP_CHAIN_SOURCE_FILE      (0)
+/**The op_open_chain() source is a block of memory.*/
+#define OP_CHAIN_SOURCE_MEMORY    (1)
+/**The op_open_chain() source is a stream accessed through a set of
+    callbacks.*/
+#define OP_CHAIN_SOURCE_CALLBACKS (2)
+
+/**One of the sources played back to back by op_open_chain().
+   Only the fields used by the given type need to be filled in.*/
+struct OpusChainSource{
+  /**One of #OP_CHAIN_SOURCE_FILE, #OP_CHAIN_SOURCE_MEMORY, or
+      #OP_CHAIN_SOURCE_CALLBACKS.*/
+  int                      type;
+  /**For #OP_CHAIN_SOURCE_FILE, the path to the file.
+     This is copied, and need not remain valid after op_open_chain()
+      returns.*/
+  const char              *path;
+  /**For #OP_CHAIN_SOURCE_MEMORY, the memory buffer.
+     This must remain valid until the \c OggOpusFile is freed.*/
+  const unsigned char     *data;
+  /**For #OP_CHAIN_SOURCE_MEMORY, the number of bytes in the buffer.*/
+  size_t                   size;
+  /**For #OP_CHAIN_SOURCE_CALLBACKS, the stream to read from.
+     This must be seekable.*/
+  void                    *stream;
+  /**For #OP_CHAIN_SOURCE_CALLBACKS, the callbacks used to access
+      \a stream.*/
+  const OpusFileCallbacks *cb;
+};
+
+/**Open a list of separate Ogg Opus sources (e.g., the files in a playlist) as
+    a single, seekable, chained stream.
+   Each source becomes one link (or several, if it is itself chained), and
+    all of the usual functions work across the whole list: op_pcm_seek() and
+    op_pcm_tell() use a single timeline, op_read() continues from one source
+    into the next, and op_current_link() reports which one is playing.
+   Consecutive sources may use the same serial number (e.g., the same file
+    played twice in a row).
+   The sources are opened in lazy mode (see op_set_lazy_links()): only the
+    first one is parsed up front, and the rest are parsed as they are needed.
+   Call op_enumerate_links() before asking for the length or bitrate of the
+    whole list.
+   Each file is opened once to find its size, but at most \a _max_open files
+    are kept open at any time, with the least recently read one being closed
+    to make room for another.
+   Memory and callback sources do not count against this limit.
+   When consecutive links have the same channel count and mapping, the decoder
+    is reset rather than re-created when playback moves from one to the next.
+   \param      _sources  The list of sources to play, in order.
+                         This is copied, and need not remain valid after this
+                          function returns.
+   \param      _nsources The number of sources.
+   \param      _max_open The maximum number of files to keep open at once.
+                         This must be at least 1.
+   \param[out] _error    Returns 0 on success, or a failure code on error.
+                         You may pass in <code>NULL</code> if you don't want
+                          the failure code.
+                         The failure code will be #OP_EINVAL if \a _nsources or
+                          \a _max_open is not positive, #OP_EFAULT if a source
+                          could not be opened or is not seekable, or one of
+                          the other failure codes from op_open_callbacks()
+                          otherwise.
+   \return A freshly opened \c OggOpusFile, or <code>NULL</code> on error.
+           <tt>libopusfile</tt> takes ownership of the streams of
+            #OP_CHAIN_SOURCE_CALLBACKS sources, and closes them when the
+            \c OggOpusFile is freed, but only if the call succeeds.*/
+OP_WARN_UNUSED_RESULT OggOpusFile *op_open_chain(
+ const OpusChainSource *_sources,int _nsources,int _max_open,int *_error)
+ OP_ARG_NONNULL(1);
+
 /**Partially open a stream from the given file path.
    \see op_test_callbacks
    \param      _path  The path to the file to open.
@@ -1406,6 +1860,73 @@ int op_test_open(OggOpusFile *_of) OP_ARG_NONNULL(1);
    \param _of The \c OggOpusFile to free.*/
 void op_free(OggOpusFile *_of);
 
+/**Creates a pool of idle decoders and decoding buffers that can be shared by
+    many \c OggOpusFile handles.
+   An \c OggOpusFile does not create its decoder or its scratch buffer until
+    it first decodes some audio.
+   When it has been attached to a pool with op_set_decoder_pool(), it takes
+    them from the pool if a compatible one is idle, and op_free() returns them
+    to the pool instead of releasing them.
+   Applications that open and close many streams can use this to avoid most of
+    the memory allocation and decoder initialization costs of each one.
+   A pool is not thread-safe.
+   Use a separate pool for each thread, or serialize all calls that might
+    use the pool on every handle attached to it (including opening, decoding,
+    seeking, and op_free()).
+   \param _max_idle The maximum number of idle decoders to keep, and also the
+                     maximum number of idle buffers to keep.
+                    Anything returned to a full pool is released.
+   \return The new pool, or <code>NULL</code> if \a _max_idle was not
+            positive or memory could not be allocated.*/
+OP_WARN_UNUSED_RESULT OpusDecoderPool *op_decoder_pool_create(int _max_idle);
+
+/**Releases a pool created by op_decoder_pool_create(), along with all of the
+    idle decoders and buffers in it.
+   Every \c OggOpusFile attached to the pool must be freed first.
+   \param _pool The pool to free.
+                This may be <code>NULL</code>.*/
+void op_decoder_pool_free(OpusDecoderPool *_pool);
+
+/**Attaches an \c OggOpusFile to a pool of decoders.
+   This must be called before the first read from the stream (it may be
+    called on a partially open stream, or right after opening it).
+   \param _of   The \c OggOpusFile to attach.
+   \param _pool The pool to borrow a decoder and buffer from, or
+                <code>NULL</code> to detach from the pool.
+   \return 0 on success, or a negative value on error.
+   \retval #OP_EINVAL \a _of has already allocated its own decoder or
+                      buffer.*/
+int op_set_decoder_pool(OggOpusFile *_of,OpusDecoderPool *_pool)
+ OP_ARG_NONNULL(1);
+
+/**Enables or disables lazy link enumeration for a partially opened stream.
+   Normally, opening a seekable stream finds every link in it, which for a
+    chained stream with thousands of links can take a long time.
+   In lazy mode, op_test_open() returns as soon as it knows where the first
+    link ends, and the remaining links are found as playback or a seek
+    reaches them.
+   Use op_enumerate_links() to find them ahead of time.
+   The functions that take a <code>const OggOpusFile *</code> never go looking
+    for links themselves.
+   Until all of the links have been found, op_link_count() returns #OP_FALSE,
+    op_pcm_total() and op_bitrate() fail with #OP_EINVAL when asked about the
+    whole stream, and op_serialno(), op_channel_count(), op_head(),
+    op_tags(), op_raw_total(), op_pcm_total(), and op_bitrate() treat links
+    that have not been found yet as out of range.
+   Finding more links may move the information stored for each one, so a
+    pointer returned by op_head() or op_tags() is only valid until the next
+    call that might find more links.
+   This has no effect on unseekable streams, or on streams opened with a link
+    index that still matches.
+   \param _of      The \c OggOpusFile on which to enable lazy mode.
+                   This must have been returned by op_test_callbacks() or one
+                    of the associated convenience functions, and not yet
+                    opened with op_test_open().
+   \param _enabled Non-zero to enable lazy mode, or 0 to disable it.
+   \return 0 on success, or a negative value on error.
+   \retval #OP_EINVAL The stream was not partially open.*/
+int op_set_lazy_links(OggOpusFile *_of,int _enabled) OP_ARG_NONNULL(1);
+
 /**@}*/
 /**@}*/
 
@@ -1449,9 +1970,37 @@ int op_seekable(const OggOpusFile *_of) OP_ARG_NONNULL(1);
    \param _of The \c OggOpusFile from which to retrieve the link count.
    \return For fully-open seekable streams, this returns the total number of
             links in the whole stream, which will be at least 1.
-           For partially-open or unseekable streams, this always returns 1.*/
+           For partially-open or unseekable streams, this always returns 1.
+   \retval #OP_FALSE The stream was opened in lazy mode (see
+                      op_set_lazy_links()), and we have not found all of the
+                      links yet.
+                     op_enumerate_links() returns the number found so far.*/
 int op_link_count(const OggOpusFile *_of) OP_ARG_NONNULL(1);
 
+/**Finds more of the links of a stream opened in lazy mode (see
+    op_set_lazy_links()).
+   This preserves the current playback position.
+   For streams that are not in lazy mode, or once every link has been found,
+    this just returns the number of links.
+   \param _of     The \c OggOpusFile in which to find more links.
+   \param _nlinks The number of links to find, counting the ones already
+                   found.
+                  Use a negative number to find all of them, after which
+                   op_link_count() reports the total.
+                  Use 0 to just get the number found so far.
+   \return The number of links found so far (which is less than \a _nlinks
+            only if the stream does not have that many), or a negative value
+            on error.
+   \retval #OP_EINVAL   The stream was only partially open.
+   \retval #OP_EREAD    An underlying read or seek operation failed.
+   \retval #OP_EFAULT   There was a memory allocation failure, or an internal
+                         library error.
+   \retval #OP_EBADLINK We failed to find data we had seen before, or a link
+                         was malformed.
+                        Any other error that op_test_open() can return for a
+                         malformed link is also possible.*/
+int op_enumerate_links(OggOpusFile *_of,int _nlinks) OP_ARG_NONNULL(1);
+
 /**Get the serial number of the given link in a (possibly-chained) Ogg Opus
     stream.
    This function may be called on partially-opened streams, but it will always
@@ -1491,6 +2040,8 @@ int op_channel_count(const OggOpusFile *_of,int _li) OP_ARG_NONNULL(1);
     logical streams (e.g., video), this returns the size of the entire stream
     (or link), not just the number of bytes in the first logical Opus stream.
    Returning the latter would require scanning the entire file.
+   In lazy mode (see op_set_lazy_links()), links that have not been found yet
+    are out of range, but the size of the entire stream is always available.
    \param _of The \c OggOpusFile from which to retrieve the compressed size.
    \param _li The index of the link whose compressed size should be computed.
               Use a negative number to get the compressed size of the entire
@@ -1513,6 +2064,9 @@ opus_int64 op_raw_total(const OggOpusFile *_of,int _li) OP_ARG_NONNULL(1);
    Because timestamps in Opus are fixed at 48 kHz, there is no need for a
     separate function to convert this to seconds (and leaving it out avoids
     introducing floating point to the API, for those that wish to avoid it).
+   In lazy mode (see op_set_lazy_links()), links that have not been found yet
+    are out of range, and the length of the entire stream is not available
+    until op_enumerate_links() has found all of them.
    \param _of The \c OggOpusFile from which to retrieve the PCM offset.
    \param _li The index of the link whose PCM length should be computed.
               Use a negative number to get the PCM length of the entire stream.
@@ -1521,7 +2075,9 @@ opus_int64 op_raw_total(const OggOpusFile *_of,int _li) OP_ARG_NONNULL(1);
             error.
    \retval #OP_EINVAL The stream is not seekable (so we can't know the length),
                        \a _li wasn't less than the total number of links in
-                       the stream, or the stream was only partially open.*/
+                       the stream, \a _li was negative and the stream is in
+                       lazy mode and not all of its links have been found, or
+                       the stream was only partially open.*/
 ogg_int64_t op_pcm_total(const OggOpusFile *_of,int _li) OP_ARG_NONNULL(1);
 
 /**Get the ID header information for the given link in a (possibly chained) Ogg
@@ -1588,13 +2144,17 @@ int op_current_link(const OggOpusFile *_of) OP_ARG_NONNULL(1);
     end.
    Install a trivial decoding callback with op_set_decode_callback() if you
     wish to skip actual decoding during this process.
+   In lazy mode (see op_set_lazy_links()), links that have not been found yet
+    are out of range, and the bitrate of the whole stream is not available
+    until op_enumerate_links() has found all of them.
    \param _of The \c OggOpusFile from which to retrieve the bitrate.
    \param _li The index of the link whose bitrate should be computed.
               Use a negative number to get the bitrate of the whole stream.
    \return The bitrate on success, or a negative value on error.
    \retval #OP_EINVAL The stream was only partially open, the stream was not
-                       seekable, or \a _li was larger than the number of
-                       links.*/
+                       seekable, \a _li was larger than the number of
+                       links, or \a _li was negative and the stream is in
+                       lazy mode and not all of its links have been found.*/
 opus_int32 op_bitrate(const OggOpusFile *_of,int _li) OP_ARG_NONNULL(1);
 
 /**Compute the instantaneous bitrate, measured as the ratio of bits to playable
@@ -1625,6 +2185,95 @@ opus_int64 op_raw_tell(const OggOpusFile *_of) OP_ARG_NONNULL(1);
    \retval #OP_EINVAL The stream was only partially open.*/
 ogg_int64_t op_pcm_tell(const OggOpusFile *_of) OP_ARG_NONNULL(1);
 
+/**Export the link structure of a stream as a persistent index.
+   The index can later be passed to op_open_callbacks_with_index() or one of
+    the associated convenience functions to open the same stream without
+    scanning it.
+   It contains the byte offsets, timestamps, serial numbers, and headers of
+    every link, along with enough information to detect if the stream changes.
+   It does not contain any pointers, and uses a fixed byte order, so it may be
+    stored on disk or shared between processes and machines.
+   This reads a few bytes from the start and end of the stream, but restores
+    the position indicator afterwards, so it may be called at any time during
+    decoding.
+   \param _of           The \c OggOpusFile from which to export the index.
+                        This must be a seekable stream that has been fully
+                         opened.
+   \param[out] _buf     A buffer in which to store the index.
+                        You may pass <code>NULL</code> to query the size of
+                         the index without exporting it.
+   \param[in,out] _size On input, the number of bytes available in \a _buf.
+                        On output, the number of bytes required to store the
+                         index.
+   \return 0 on success, or a negative value on error.
+   \retval #OP_EINVAL   The stream was only partially open, was not
+                         seekable, or \a _buf was too small.
+   \retval #OP_EREAD    An underlying read, seek, or tell operation failed.
+   \retval #OP_EFAULT   The index would be too large to represent.
+   \retval #OP_EBADLINK The start or end of the stream no longer contains a
+                         valid page.*/
+OP_WARN_UNUSED_RESULT int op_link_index_export(OggOpusFile *_of,
+ unsigned char *_buf,size_t *_size) OP_ARG_NONNULL(1) OP_ARG_NONNULL(3);
+
+/**Counters describing the work done by an \c OggOpusFile.
+   These are maintained only when libopusfile is built with statistics
+    enabled (<code>--enable-stats</code> or <code>OP_ENABLE_STATS</code>).
+   They accumulate from the time the stream is opened until they are reset
+    with op_reset_stats().
+   They are meant to help diagnose where a slow open or seek spends its time,
+    and are not part of the decoding state.*/
+struct OpusFileStats{
+  /**The number of calls to the \c read callback.*/
+  opus_int64 read_calls;
+  /**The total number of bytes returned by the \c read callback.*/
+  opus_int64 read_bytes;
+  /**The number of calls to the \c seek callback.*/
+  opus_int64 seek_calls;
+  /**The number of Ogg pages framed from the stream data.*/
+  opus_int64 pages_framed;
+  /**The number of bytes skipped while searching for a page boundary.*/
+  opus_int64 bytes_skipped;
+  /**The number of bisection iterations performed while seeking.*/
+  opus_int64 bisect_steps;
+  /**The number of chunks scanned while searching backwards for a page.*/
+  opus_int64 prev_page_chunks;
+  /**The number of packets decoded.*/
+  opus_int64 packets_decoded;
+  /**The number of decoded packets discarded entirely by pre-skip or by the
+      pre-roll after a seek.
+     Packets that were only partly discarded are not counted.*/
+  opus_int64 packets_discarded;
+  /**The number of samples (per channel) discarded by pre-skip or by the
+      pre-roll after a seek.*/
+  opus_int64 samples_discarded;
+  /**The number of times a decoder was created.*/
+  opus_int64 decoder_creations;
+  /**The number of times an existing decoder was reset and reused.*/
+  opus_int64 decoder_resets;
+  /**The total time spent opening the stream, in nanoseconds, or -1 if no
+      monotonic clock was available.*/
+  opus_int64 open_ns;
+  /**The total time spent in op_raw_seek() and op_pcm_seek(), in
+      nanoseconds, or -1 if no monotonic clock was available.*/
+  opus_int64 seek_ns;
+  /**The total time spent reading and decoding audio, in nanoseconds, or -1
+      if no monotonic clock was available.*/
+  opus_int64 read_ns;
+};
+
+/**Retrieve the I/O and decoding counters accumulated by \a _of.
+   \param _of         The \c OggOpusFile from which to retrieve the counters.
+   \param[out] _stats Returns the current counters.
+   \return 0 on success, or a negative value on error.
+   \retval #OP_EIMPL  libopusfile was built without statistics support.*/
+int op_get_stats(const OggOpusFile *_of,OpusFileStats *_stats)
+ OP_ARG_NONNULL(1) OP_ARG_NONNULL(2);
+
+/**Reset all the counters accumulated by \a _of to zero.
+   This does nothing if libopusfile was built without statistics support.
+   \param _of The \c OggOpusFile whose counters should be reset.*/
+void op_reset_stats(OggOpusFile *_of) OP_ARG_NONNULL(1);
+
 /**@}*/
 /**@}*/
 
@@ -1689,6 +2338,119 @@ int op_raw_seek(OggOpusFile *_of,opus_int64 _byte_offset) OP_ARG_NONNULL(1);
                          seeking to the target destination was impossible.*/
 int op_pcm_seek(OggOpusFile *_of,ogg_int64_t _pcm_offset) OP_ARG_NONNULL(1);
 
+/**Set the minimum spacing between entries in the seek table.
+   For seekable streams, <tt>libopusfile</tt> remembers the locations of some
+    of the pages it reads while opening, decoding, and seeking, and uses them
+    to narrow the range it has to search in later seeks.
+   This table is kept sparse by only storing pages whose timestamps are at
+    least this far apart.
+   Smaller values use more memory, but make seeks near previously visited
+    positions cheaper.
+   The default is 5 seconds.
+   This may be called on a partially opened stream (see op_test_callbacks()),
+    in which case the new spacing also applies to the pages read while
+    finishing opening the stream with op_test_open().
+   \param _of      The \c OggOpusFile on which to set the spacing.
+   \param _spacing The minimum spacing, in samples at 48 kHz.
+                   A value of 0 disables the seek table and releases any memory
+                    it used.
+   \return 0 on success, or a negative value on error.
+   \retval #OP_EINVAL \a _spacing was negative.*/
+int op_set_seek_table_spacing(OggOpusFile *_of,opus_int32 _spacing)
+ OP_ARG_NONNULL(1);
+
+/**Scan the stream to fill in the seek table.
+   This reads every page in the stream, so that every subsequent seek only
+    needs to examine a small range of data, e.g., for a user interface that
+    allows scrubbing through the stream.
+   The scan can be performed incrementally, by limiting the number of bytes read
+    per call, and calling this function again (e.g., when the application is
+    otherwise idle) until it returns 0.
+   It uses its own framing state and restores the position indicator of the
+    underlying stream before returning, so it can be interleaved with
+    decoding and seeking.
+   Like all other functions on an \c OggOpusFile, it must not be called
+    concurrently with any other function on the same \c OggOpusFile.
+   \param _of        The \c OggOpusFile whose seek table should be built.
+   \param _max_bytes The approximate maximum number of bytes to read in this
+                      call.
+                     The scan always stops at a page boundary, so it may read
+                      up to one chunk more than this.
+                     If this is 0 or negative, the rest of the stream is
+                      scanned in a single call.
+   \return 0 if the scan is complete, 1 if more of the stream remains to be
+            scanned, or a negative value on error.
+   \retval #OP_EINVAL  The stream was only partially open, or the seek table is
+                        disabled.
+   \retval #OP_ENOSEEK This stream is not seekable.
+   \retval #OP_EREAD   An underlying read or seek operation failed.
+   \retval #OP_EFAULT  An internal memory allocation failed.*/
+int op_build_seek_table(OggOpusFile *_of,opus_int64 _max_bytes)
+ OP_ARG_NONNULL(1);
+
+/**Get the number of entries currently in the seek table.
+   \param _of The \c OggOpusFile from which to retrieve the seek table size.
+   \return The number of entries in the seek table.*/
+int op_seek_table_count(const OggOpusFile *_of) OP_ARG_NONNULL(1);
+
+/**Get an entry from the seek table.
+   Entries are sorted by increasing byte offset.
+   \param _of               The \c OggOpusFile from which to retrieve the
+                             entry.
+   \param _i                The index of the entry to retrieve.
+                            This must be less than the value returned by
+                             op_seek_table_count().
+   \param[out] _byte_offset Returns the byte offset of the end of the page.
+                            Decoding from this offset produces the samples
+                             following \a _pcm_offset.
+                            You may pass <code>NULL</code> if you don't need
+                             this value.
+   \param[out] _pcm_offset  Returns the PCM offset of the last sample
+                             completed on the page, in samples at 48 kHz
+                             relative to the start of the stream.
+                            You may pass <code>NULL</code> if you don't need
+                             this value.
+   \return The index of the link containing the page, or a negative value on
+            error.
+   \retval #OP_EINVAL \a _i was out of range.*/
+int op_seek_table_get(const OggOpusFile *_of,int _i,
+ opus_int64 *_byte_offset,ogg_int64_t *_pcm_offset) OP_ARG_NONNULL(1);
+
+/**Keep snapshots of the decoder state to seek without pre-roll.
+   After a seek, <tt>libopusfile</tt> normally decodes and discards at least
+    80&nbsp;ms of audio to let the decoder converge, and the output that
+    follows still differs slightly from what a straight decode would have
+    produced.
+   With snapshots enabled, while decoding straight through a seekable stream,
+    the library copies the decoder state (and the dithering and soft clipping
+    state used by op_read() and op_read_stereo()) at page boundaries at least
+    \a _spacing samples apart.
+   A later op_pcm_seek() to a position no more than \a _spacing samples after
+    a snapshot restores it instead of searching the stream, decodes forward
+    from there without any pre-roll, and produces exactly the same output as
+    the original decode.
+   This is useful for scrubbing and looping over a section of a stream.
+   Snapshots are not taken while an application decode callback is installed
+    (see op_set_decode_callback()).
+   Each snapshot uses as much memory as the decoder itself (see
+    opus_multistream_decoder_get_size()).
+   When the total would exceed \a _max_bytes, the least recently used
+    snapshots are discarded.
+   Snapshots are disabled by default.
+   \param _of        The \c OggOpusFile on which to enable snapshots.
+   \param _spacing   The minimum spacing between snapshots in the same link,
+                      in samples at 48&nbsp;kHz.
+                     This is also the farthest a seek target can be past a
+                      snapshot for it to be used.
+                     A value of 0 disables snapshots and releases any memory
+                      they used.
+   \param _max_bytes The maximum amount of memory to use for snapshots, in
+                      bytes.
+   \return 0 on success, or a negative value on error.
+   \retval #OP_EINVAL \a _spacing or \a _max_bytes was negative.*/
+int op_set_decoder_snapshots(OggOpusFile *_of,opus_int32 _spacing,
+ opus_int64 _max_bytes) OP_ARG_NONNULL(1);
+
 /**@}*/
 /**@}*/
 
@@ -1912,6 +2674,10 @@ void op_set_dither_enabled(OggOpusFile *_of,int _enabled) OP_ARG_NONNULL(1);
    \retval #OP_EREAD         An underlying read operation failed.
                              This may signal a truncation attack from an
                               <https:> source.
+   \retval #OP_EAGAIN        The stream is in non-blocking mode and no
+                              data was available.
+                             Call this function again to continue decoding
+                              once there is.
    \retval #OP_EFAULT        An internal memory allocation failed.
    \retval #OP_EIMPL         An unseekable stream encountered a new link that
                               used a feature that is not implemented, such as
@@ -1993,6 +2759,10 @@ OP_WARN_UNUSED_RESULT int op_read(OggOpusFile *_of,
    \retval #OP_EREAD         An underlying read operation failed.
                              This may signal a truncation attack from an
                               <https:> source.
+   \retval #OP_EAGAIN        The stream is in non-blocking mode and no
+                              data was available.
+                             Call this function again to continue decoding
+                              once there is.
    \retval #OP_EFAULT        An internal memory allocation failed.
    \retval #OP_EIMPL         An unseekable stream encountered a new link that
                               used a feature that is not implemented, such as
@@ -2054,6 +2824,10 @@ OP_WARN_UNUSED_RESULT int op_read_float(OggOpusFile *_of,
    \retval #OP_EREAD         An underlying read operation failed.
                              This may signal a truncation attack from an
                               <https:> source.
+   \retval #OP_EAGAIN        The stream is in non-blocking mode and no
+                              data was available.
+                             Call this function again to continue decoding
+                              once there is.
    \retval #OP_EFAULT        An internal memory allocation failed.
    \retval #OP_EIMPL         An unseekable stream encountered a new link that
                               used a feature that is not implemented, such as
@@ -2115,6 +2889,10 @@ OP_WARN_UNUSED_RESULT int op_read_stereo(OggOpusFile *_of,
    \retval #OP_EREAD         An underlying read operation failed.
                              This may signal a truncation attack from an
                               <https:> source.
+   \retval #OP_EAGAIN        The stream is in non-blocking mode and no
+                              data was available.
+                             Call this function again to continue decoding
+                              once there is.
    \retval #OP_EFAULT        An internal memory allocation failed.
    \retval #OP_EIMPL         An unseekable stream encountered a new link that
                               used a feature that is not implemented, such as
@@ -2137,6 +2915,249 @@ OP_WARN_UNUSED_RESULT int op_read_stereo(OggOpusFile *_of,
 OP_WARN_UNUSED_RESULT int op_read_float_stereo(OggOpusFile *_of,
  float *_pcm,int _buf_size) OP_ARG_NONNULL(1);
 
+/**Decodes a range of samples from a seekable stream into a single buffer.
+   This seeks to \a _pcm_start and then calls op_read_float() until it has
+    decoded every sample before \a _pcm_end, the buffer is full, or the end of
+    the stream is reached.
+   The output is interleaved in the same manner as op_read_float().
+
+   To decode a large range on several threads at once, use
+    op_decode_range_parallel().
+   \param      _of        The \c OggOpusFile from which to read.
+   \param      _pcm_start The offset of the first sample to decode, in samples
+                           at 48 kHz relative to the start of the stream.
+   \param      _pcm_end   The offset one past the last sample to decode.
+   \param[out] _pcm       A buffer in which to store the output PCM samples.
+   \param      _buf_size  The number of floats that can be stored in \a _pcm.
+   \return The number of samples decoded per channel, or a negative value on
+            error.
+           This is less than the size of the range if the buffer fills up, the
+            end of the stream is reached, an error occurs after some samples
+            were decoded, or the range crosses into a link with a different
+            channel count.
+           In the last case, call this function again starting from the first
+            sample that was not returned.
+   \retval #OP_EINVAL   The stream was only partially open, or the range was
+                          invalid.
+   \retval #OP_ENOSEEK  The stream is not seekable.
+   \retval #OP_EREAD    An underlying read or seek operation failed.
+   \retval #OP_EFAULT   An internal memory allocation failed.
+   \retval #OP_EBADLINK We failed to find data we had seen before, or the
+                          bitstream structure was sufficiently malformed that
+                          seeking to the target destination was impossible.*/
+OP_WARN_UNUSED_RESULT int op_decode_range_float(OggOpusFile *_of,
+ ogg_int64_t _pcm_start,ogg_int64_t _pcm_end,float *_pcm,int _buf_size)
+ OP_ARG_NONNULL(1);
+
+/**Decodes a range of samples from a seekable stream on several threads.
+   This splits the range into \a n segments of equal length, and decodes
+    each one with
+    op_decode_range_float() on its own thread, into its own part of \a _pcm.
+   The first segment is decoded on the calling thread with \a _of itself.
+   The others use their own \c OggOpusFile, opened on the same data with a
+    link index (see op_link_index_export()), so they do not rescan the stream.
+   The gain settings of \a _of are copied to each of them.
+   The output is interleaved in the same manner as op_read_float().
+
+   Each segment after the first starts with a seek, which decodes 80&nbsp;ms
+    of pre-roll before the segment to let the decoder converge, exactly as
+    op_pcm_seek() does.
+   The output therefore matches a sequential decode with op_read_float()
+    everywhere except for a short stretch after each of the
+    <code>n-1</code> seams between the <code>n</code> segments, where it
+    differs by about as much as the output after any op_pcm_seek() does.
+   If \a m is the number of samples in the range, after it is clipped as
+    described below, then \a n is the smaller of \a _nthreads and
+    <code>m/480000</code> (so that no segment is shorter than 10&nbsp;seconds),
+    but at least 1, and seam \a k (for <code>0&lt;k&lt;n</code>) falls at
+    sample <code>_pcm_start+k*m/n</code> (rounded down in both cases).
+   A seam that falls at the start of a link is exact, since every link is
+    decoded with a freshly reset decoder anyway.
+   With <code>n==1</code> this is simply op_decode_range_float().
+
+   The range is only split when the stream data is already in memory, i.e.,
+    the stream was opened with op_open_memory() or a stream from
+    op_mmap_open(), and no decode callback was set with
+    op_set_decode_callback().
+   Otherwise, it is decoded in one piece, exactly as op_decode_range_float()
+    would.
+   If <tt>libopusfile</tt> was built without thread support, or a thread
+    cannot be started, the segments are still decoded separately, one after
+    another on the calling thread.
+   The seams, and so the output, therefore do not depend on how many threads
+    actually ran.
+   \a _of must not be used by any other thread during this call.
+   \param      _of        The \c OggOpusFile from which to read.
+   \param      _pcm_start The offset of the first sample to decode, in samples
+                           at 48&nbsp;kHz relative to the start of the stream.
+   \param      _pcm_end   The offset one past the last sample to decode.
+                          The range is clipped to end at the end of the
+                           stream, at the first link with a different channel
+                           count than the link containing \a _pcm_start, or
+                           when \a _pcm is full, whichever comes first.
+   \param[out] _pcm       A buffer in which to store the output PCM samples.
+   \param      _buf_size  The number of floats that can be stored in \a _pcm.
+   \param      _nthreads  The maximum number of threads to use, including the
+                           calling thread.
+                          This must be at least 1.
+   \return The number of samples decoded per channel, or a negative value on
+            error.
+           This is less than the size of the range if the range was clipped,
+            or if an error occurred after some samples were decoded.
+           In the latter case, every sample returned is valid, but samples
+            after them in \a _pcm may not be.
+   \retval #OP_EINVAL   The stream was only partially open, the range was
+                          invalid, or \a _nthreads was less than 1.
+   \retval #OP_ENOSEEK  The stream is not seekable.
+   \retval #OP_EREAD    An underlying read or seek operation failed.
+   \retval #OP_EFAULT   An internal memory allocation failed.
+   \retval #OP_EBADLINK We failed to find data we had seen before, or the
+                          bitstream structure was sufficiently malformed that
+                          seeking to the target destination was impossible.*/
+OP_WARN_UNUSED_RESULT int op_decode_range_parallel(OggOpusFile *_of,
+ ogg_int64_t _pcm_start,ogg_int64_t _pcm_end,float *_pcm,int _buf_size,
+ int _nthreads) OP_ARG_NONNULL(1);
+
+/**Reads more samples from a seekable stream, going backwards.
+   The first call starts at the current position (as returned by
+    op_pcm_tell()), and each call returns the samples immediately preceding
+    the ones returned by the previous call, with the last sample first.
+   This is meant for reverse playback and reverse scrubbing.
+   Rather than seeking for each call, the library walks backwards through the
+    stream a page at a time, remembering the pages it has found, and decodes
+    about a second of audio at a time (plus 80&nbsp;ms of pre-roll), so the
+    cost is comparable to forward playback.
+   As with op_read(), the samples are interleaved, and all of the samples
+    returned by a single call come from the same link.
+   While reading in reverse, op_pcm_tell() reports the position just after
+    the last sample not yet returned (i.e., the first sample returned by the
+    most recent call).
+   Calling op_read() or any of the other forward reading functions continues
+    forward from that position, and op_pcm_seek() or op_raw_seek() stops
+    reverse playback.
+   Because each block is decoded with a fresh decoder after the pre-roll, the
+    output is not guaranteed to be bit-identical to a forward decode.
+   \param      _of       The \c OggOpusFile from which to read.
+   \param[out] _pcm      A buffer in which to store the output PCM samples, as
+                          signed native-endian 16-bit values at 48&nbsp;kHz.
+   \param      _buf_size The number of values that can be stored in \a _pcm.
+                         This must be large enough to hold at least one sample
+                          for every channel.
+   \param[out] _li       The index of the link the samples came from.
+                         You may pass <code>NULL</code> if you don't need it.
+   \return The number of samples read per channel on success, or a negative
+            value on failure.
+           This returns 0 once the start of the stream has been reached.
+   \retval #OP_EINVAL   The stream was only partially open, or \a _buf_size
+                         was too small to hold one sample for each channel.
+   \retval #OP_ENOSEEK  The stream is not seekable.
+   \retval #OP_EREAD    An underlying read or seek operation failed.
+   \retval #OP_EFAULT   An internal memory allocation failed.
+   \retval #OP_EBADPACKET Failed to properly decode a packet.
+   \retval #OP_EBADLINK We failed to find data we had seen before, or the
+                         bitstream structure was sufficiently malformed that
+                         we could not locate the preceding data.*/
+OP_WARN_UNUSED_RESULT int op_read_reverse(OggOpusFile *_of,
+ opus_int16 *_pcm,int _buf_size,int *_li) OP_ARG_NONNULL(1);
+
+/**Reads more samples from a seekable stream as floats, going backwards.
+   This is the floating-point equivalent of op_read_reverse().
+   See op_read_reverse() for details.
+   \param      _of       The \c OggOpusFile from which to read.
+   \param[out] _pcm      A buffer in which to store the output PCM samples, as
+                          signed floats at 48&nbsp;kHz with a nominal range of
+                          <code>[-1.0,1.0]</code>.
+   \param      _buf_size The number of floats that can be stored in \a _pcm.
+   \param[out] _li       The index of the link the samples came from.
+                         You may pass <code>NULL</code> if you don't need it.
+   \return The number of samples read per channel on success, 0 once the start
+            of the stream has been reached, or a negative value on failure.
+           See op_read_reverse() for the possible error codes.*/
+OP_WARN_UNUSED_RESULT int op_read_reverse_float(OggOpusFile *_of,
+ float *_pcm,int _buf_size,int *_li) OP_ARG_NONNULL(1);
+
+/**Timing information for a packet returned by op_read_packet().
+   All durations are in samples at 48 kHz.
+   The samples to play from a packet are the
+    <code>trimmed_duration-discard</code> samples that follow the first
+    <code>discard</code> samples decoded from it.*/
+struct OpusPacketInfo{
+  /**The number of samples the packet decodes to, according to its TOC
+      sequence.*/
+  int duration;
+  /**The number of samples remaining after end-trimming.
+     This is less than <code>duration</code> only for the last packet of a
+      link whose granule position ends partway through it.*/
+  int trimmed_duration;
+  /**The number of samples to discard from the start of the packet.
+     This is non-zero for the packets at the start of a link that are covered
+      by its pre-skip, and for the packets decoded as pre-roll after a seek.*/
+  int discard;
+  /**The index of the link this packet came from, as returned by
+      op_current_link().
+     For seekable sources, this is a number between 0 (inclusive) and the
+      value returned by op_link_count() (exclusive).
+     For unseekable sources, this value starts at 0 and increments by one each
+      time a new link is encountered (even though op_link_count() always
+      returns 1).*/
+  int li;
+};
+
+/**Reads the next audio data packet from the stream without decoding it.
+   This is useful for applications that only need to cut, splice, or remux
+    Opus packets: it performs all of the same page handling, timestamping,
+    and trimming bookkeeping as op_read(), but never creates or runs a
+    decoder.
+   The granule position stored in the returned packet has been corrected to
+    mark the end of that packet (not just the end of the page), and the last
+    packet of each link has its <code>e_o_s</code> flag set.
+   Header packets are not returned, since they are available through op_head()
+    and op_tags().
+
+   It is possible to mix calls to this function with calls to op_read() and
+    friends, but any samples already decoded and not yet returned by those
+    functions are discarded, and the decoder will not have seen the packets
+    returned by this function, so the first output after switching back to
+    decoding may contain audible artifacts.
+   Seeking in between avoids that.
+   \param      _of   The \c OggOpusFile from which to read.
+   \param[out] _op   Returns the packet.
+                     Its data remains valid until the next call to any
+                      function that reads or seeks on \a _of.
+   \param[out] _info Returns the timing information for the packet.
+                     You may pass <code>NULL</code> if you don't need it.
+   \return The size of the packet in bytes, 0 at the end of the file, or a
+            negative value on error.
+   \retval #OP_HOLE      There was a hole in the data, and some samples may
+                           have been skipped.
+                          Call this function again to continue reading data
+                           from the stream.
+   \retval #OP_EREAD     An underlying read operation failed.
+   \retval #OP_EAGAIN    The stream is in non-blocking mode and no data was
+                          available.
+                         Call this function again to continue reading once
+                          there is.
+   \retval #OP_EFAULT    An internal memory allocation failed.
+   \retval #OP_EIMPL     An unseekable stream encountered a new link that
+                           used a feature that is not implemented, such as an
+                           unsupported channel family.
+   \retval #OP_EINVAL    The stream was only partially open.
+   \retval #OP_ENOTFORMAT An unseekable stream encountered a new link that
+                           did not have any logical Opus streams in it.
+   \retval #OP_EBADHEADER An unseekable stream encountered a new link with a
+                           required header packet that was not properly
+                           formatted, contained illegal values, or was missing
+                           altogether.
+   \retval #OP_EVERSION  An unseekable stream encountered a new link with an
+                           ID header that contained an unrecognized version
+                           number.
+   \retval #OP_EBADLINK  We failed to find data we had seen before.
+   \retval #OP_EBADTIMESTAMP An unseekable stream encountered a new link with
+                              a starting timestamp that failed basic validity
+                              checks.*/
+OP_WARN_UNUSED_RESULT int op_read_packet(OggOpusFile *_of,ogg_packet *_op,
+ OpusPacketInfo *_info) OP_ARG_NONNULL(1) OP_ARG_NONNULL(2);
+
 /**@}*/
 /**@}*/
 
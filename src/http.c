@@ -51,6 +51,10 @@ typedef struct OpusParsedURL   OpusParsedURL;
 typedef struct OpusStringBuf   OpusStringBuf;
 typedef struct OpusHTTPConn    OpusHTTPConn;
 typedef struct OpusHTTPStream  OpusHTTPStream;
+typedef struct OpusHTTPIdleConn OpusHTTPIdleConn;
+typedef struct OpusHTTPResolved OpusHTTPResolved;
+typedef struct OpusHTTPSession  OpusHTTPSession;
+typedef struct OpusHTTPCacheEntry OpusHTTPCacheEntry;
 
 static char *op_string_range_dup(const char *_start,const char *_end){
   size_t  len;
@@ -388,6 +392,18 @@ typedef struct timeb op_time;
    results for dual-stack hosts.*/
 # define OP_RESOLVE_CACHE_TIMEOUT_MS (10*60*(opus_int32)1000)
 
+/*The maximum number of resolved hosts an OpusHTTPConnPool remembers.*/
+# define OP_RESOLVE_CACHE_SIZE (16)
+
+/*The maximum number of TLS sessions an OpusHTTPConnPool remembers.*/
+# define OP_SSL_SESSION_CACHE_SIZE (16)
+
+/*The name of the index file in an OpusHTTPCache directory, and the first line
+   it must start with.
+  Bump the version if the format changes, so old indices get ignored.*/
+# define OP_CACHE_INDEX_NAME  "index"
+# define OP_CACHE_INDEX_MAGIC "opusfile-http-cache 1\n"
+
 /*The number of redirections at which we give up.
   The value here is the current default in Firefox.
   RFC 2068 mandated a maximum of 5, but RFC 2616 relaxed that to "a client
@@ -419,13 +435,23 @@ typedef struct timeb op_time;
    opening a new connection.*/
 # define OP_READAHEAD_THRESH_MIN (32*(opus_int32)1024)
 
-/*The amount of data to request after a seek.
+/*The least amount of data to request after a seek.
   This is a trade-off between read throughput after a seek vs. the the ability
-   to quickly perform another seek with the same connection.*/
+   to quickly perform another seek with the same connection.
+  We ask for more when one bandwidth-delay product is larger than this.*/
 # define OP_PIPELINE_CHUNK_SIZE     (32*(opus_int32)1024)
 /*Subsequent chunks are requested with larger and larger sizes until they pass
    this threshold, after which we just ask for the rest of the resource.*/
 # define OP_PIPELINE_CHUNK_SIZE_MAX (1024*(opus_int32)1024)
+/*During linear playback, each request asks for at least this many
+   bandwidth-delay products worth of data, so that waiting for the start of
+   each response is only a small part of the time spent on it.*/
+# define OP_PIPELINE_BDP_MULT       (4)
+
+/*The amount of data at the end of the resource to request along with the
+   initial request, when asked to.
+  This matches the chunk size opusfile reads when looking for the last page.*/
+# define OP_HTTP_TAIL_SIZE (64*(opus_int32)1024)
 /*This is the maximum number of requests we'll make with a single connection.
   Many servers will simply disconnect after we attempt some number of requests,
    possibly without sending a Connection: close header, meaning we won't
@@ -436,7 +462,8 @@ typedef struct timeb op_time;
 # define OP_PIPELINE_MAX_REQUESTS   (100)
 /*This should be the number of requests, starting from a chunk size of
    OP_PIPELINE_CHUNK_SIZE and doubling each time, until we exceed
-   OP_PIPELINE_CHUNK_SIZE_MAX and just request the rest of the file.
+   OP_PIPELINE_CHUNK_SIZE_MAX and just request the rest of the file (on a
+   path with a large bandwidth-delay product, we get there sooner).
   We won't reuse a connection when seeking unless it has at least this many
    requests left, to reduce the chances we'll have to open a new connection
    while reading forward afterwards.*/
@@ -810,6 +837,11 @@ struct OpusHTTPConn{
   /*The end of the next request or -1 if we requested the rest of the resource.
     This is only set to a meaningful value if next_pos is not -1.*/
   opus_int64    next_end;
+  /*The number of bytes left in the current chunk of a chunked response body,
+     0 if we need to read the next chunk header, -2 once we've read the last
+     chunk, or -1 if the body isn't chunked.
+    Chunked bodies are only supported when reading until EOF (end_pos<0).*/
+  opus_int64    chunk_left;
   /*The SSL connection, if this is https.*/
   SSL          *ssl_conn;
   /*The next connection in either the LRU or free list.*/
@@ -830,6 +862,7 @@ struct OpusHTTPConn{
 
 static void op_http_conn_init(OpusHTTPConn *_conn){
   _conn->next_pos=-1;
+  _conn->chunk_left=-1;
   _conn->ssl_conn=NULL;
   _conn->next=NULL;
   _conn->fd=OP_INVALID_SOCKET;
@@ -841,10 +874,152 @@ static void op_http_conn_clear(OpusHTTPConn *_conn){
   if(_conn->fd!=OP_INVALID_SOCKET)close(_conn->fd);
 }
 
+/*An idle persistent connection waiting in an OpusHTTPConnPool.
+  Besides the connection itself, this remembers everything a stream needs to
+   decide whether it may re-use it, and the address it was connected to, so
+   that a stream which never resolved the host can still open more connections
+   to the same place.*/
+struct OpusHTTPIdleConn{
+  /*The next connection in the pool, ordered from MRU to LRU.*/
+  OpusHTTPIdleConn *next;
+  /*The host from the URL.*/
+  char             *host;
+  /*The host we actually connected to (different if we're proxying).*/
+  char             *connect_host;
+  /*The CONNECT request used to tunnel through a proxy, or NULL.*/
+  char             *proxy_connect;
+  /*The length of the CONNECT request.*/
+  int               proxy_connect_len;
+  /*The port from the URL.*/
+  unsigned          port;
+  /*The port we actually connected to.*/
+  unsigned          connect_port;
+  /*Whether or not this is an https connection.*/
+  int               is_ssl;
+  /*Whether or not certificate checks were skipped on this connection.*/
+  int               skip_certificate_check;
+  /*The SSL connection, if this is https.*/
+  SSL              *ssl_conn;
+  /*The socket.*/
+  op_sock           fd;
+  /*The number of remaining requests we are allowed on this connection.*/
+  int               nrequests_left;
+  /*The time this connection became idle.*/
+  op_time           idle_time;
+  /*Information about the address we connected to.*/
+  struct addrinfo   addr_info;
+  /*The address we connected to.*/
+  union{
+    struct sockaddr     s;
+    struct sockaddr_in  v4;
+    struct sockaddr_in6 v6;
+  }                 addr;
+  /*The last time the host was resolved.*/
+  op_time           resolve_time;
+};
+
+/*The addresses a host resolved to, cached in an OpusHTTPConnPool.*/
+struct OpusHTTPResolved{
+  /*The next cached host, ordered from MRU to LRU.*/
+  OpusHTTPResolved *next;
+  /*The host that was resolved.*/
+  char             *host;
+  /*The port that was resolved.*/
+  unsigned          port;
+  /*The list of addresses returned by getaddrinfo().*/
+  struct addrinfo  *addrs;
+  /*The time the host was resolved.*/
+  op_time           resolve_time;
+};
+
+/*A TLS session that can be resumed, cached in an OpusHTTPConnPool.*/
+struct OpusHTTPSession{
+  /*The next cached session, ordered from MRU to LRU.*/
+  OpusHTTPSession  *next;
+  /*The host the session was established with.*/
+  char             *host;
+  /*The port the session was established with.*/
+  unsigned          port;
+  /*Whether or not certificate checks were skipped when it was established.
+    A resumed session is never checked again, so one that was never checked
+     can't be given to a stream that wants the checks.*/
+  int               skip_certificate_check;
+  /*The session itself.*/
+  SSL_SESSION      *ssl_session;
+};
+
+/*A resource stored in an OpusHTTPCache.
+  The data lives in its own file, at the same offsets as in the resource, so
+   the ranges we don't have are just holes.*/
+struct OpusHTTPCacheEntry{
+  /*The next entry in the cache, ordered from MRU to LRU.*/
+  OpusHTTPCacheEntry *next;
+  /*The URL the resource was requested with.*/
+  char               *url;
+  /*The ETag or Last-Modified value the stored data belongs to.*/
+  char               *validator;
+  /*The ranges stored, as a sorted list of disjoint [start,end) pairs.*/
+  opus_int64         *ranges;
+  /*The length of the resource.*/
+  opus_int64          content_length;
+  /*The total number of bytes stored.*/
+  opus_int64          size;
+  /*The number of ranges stored.*/
+  int                 nranges;
+  /*The number of ranges there is room for.*/
+  int                 cranges;
+  /*The number of streams currently reading this entry.
+    Entries in use are never evicted or reset.*/
+  int                 nrefs;
+  /*The number the data file is named after.*/
+  opus_uint32         id;
+};
+
+/*A persistent cache of byte ranges fetched from http/https servers.*/
+struct OpusHTTPCache{
+  /*The directory the cache lives in.*/
+  char               *dir;
+  /*The entries, ordered from MRU to LRU.*/
+  OpusHTTPCacheEntry *head;
+  /*The maximum total number of bytes to store.*/
+  opus_int64          max_size;
+  /*The total number of bytes stored.*/
+  opus_int64          size;
+  /*The number to name the next data file after.*/
+  opus_uint32         next_id;
+  /*Whether or not the index needs to be written out.*/
+  int                 dirty;
+};
+
+/*A pool of idle connections, resolved addresses, and TLS state shared between
+   streams.*/
+struct OpusHTTPConnPool{
+  /*The idle connections, ordered from MRU to LRU.*/
+  OpusHTTPIdleConn *idle_head;
+  /*The cached host addresses, ordered from MRU to LRU.*/
+  OpusHTTPResolved *resolved_head;
+  /*The cached TLS sessions, ordered from MRU to LRU.*/
+  OpusHTTPSession  *session_head;
+  /*The shared TLS contexts, indexed by whether or not they skip certificate
+     checks.
+    These are created the first time a stream needs them.*/
+  SSL_CTX          *ssl_ctx[2];
+  /*The number of idle connections.*/
+  int               nidle;
+  /*The maximum number of idle connections to keep.*/
+  int               max_idle;
+  /*The number of cached host addresses.*/
+  int               nresolved;
+  /*The number of cached TLS sessions.*/
+  int               nsessions;
+};
+
 /*The global stream state.*/
 struct OpusHTTPStream{
   /*The list of connections.*/
   OpusHTTPConn     conns[OP_NCONNS_MAX];
+  /*The pool to share idle connections with, or NULL.*/
+  OpusHTTPConnPool *pool;
   /*The context object used as a framework for TLS/SSL functions.*/
   SSL_CTX         *ssl_ctx;
   /*The cached session to reuse for future connections.*/
@@ -890,12 +1065,64 @@ struct OpusHTTPStream{
   int              pipeline;
   /*Whether or not we should skip certificate checks.*/
   int              skip_certificate_check;
+  /*Whether or not reads should return OP_EAGAIN instead of waiting for the
+     server.*/
+  int              nonblocking;
   /*The offset of the tail of the request.
     Only the offset in the Range: header appears after this, allowing us to
      quickly edit the request to ask for a new range.*/
   int              request_tail;
   /*The estimated time required to open a new connection, in milliseconds.*/
   opus_int32       connect_rate;
+  /*The estimated time from sending a request on an open connection to
+     receiving the response headers, in milliseconds, or 0 if unknown.*/
+  opus_int32       latency;
+  /*The most recent throughput estimate from any connection, in bytes/s.
+    New connections start without one, so this lets them size their requests
+     from what we've seen before.*/
+  opus_int64       read_rate;
+  /*The number of range requests made with op_http_conn_send_request().*/
+  opus_int64       nrequests;
+  /*The number of bytes asked for by the most recent of those, or -1 if it
+     asked for the rest of the resource.*/
+  opus_int64       last_request_size;
+  /*The ring buffer holding data received ahead of the read position, or NULL
+     if prefetching is disabled.
+    The buffered data always ends at the position of the current connection
+     (or at pos, if no connection is active).*/
+  unsigned char   *prefetch_buf;
+  /*The size of the prefetch buffer.*/
+  int              prefetch_cbuf;
+  /*The index of the first buffered byte in the prefetch buffer.*/
+  int              prefetch_start;
+  /*The number of bytes currently buffered.*/
+  int              prefetch_nbuf;
+  /*The on-disk cache to use, or NULL.*/
+  OpusHTTPCache      *cache;
+  /*The entry for this resource in the cache, or NULL if we aren't caching
+     it.*/
+  OpusHTTPCacheEntry *cache_entry;
+  /*The file holding the entry's data.*/
+  void               *cache_fp;
+  /*The callbacks used to access cache_fp.*/
+  OpusFileCallbacks   cache_cb;
+  /*The position we're reading from the cache, or -1 if we're reading from the
+     network.*/
+  opus_int64          cache_pos;
+  /*The ETag or Last-Modified value from the initial response, or NULL.
+    This is only collected if we have a cache.*/
+  char               *validator;
+  /*The connection fetching the end of the resource, or NULL.
+    This is kept out of the LRU list until we read its response, so that
+     nothing else tries to use it.*/
+  OpusHTTPConn       *tail_conn;
+  /*The end of the resource, once it has been read from tail_conn.*/
+  unsigned char      *tail_buf;
+  /*The offset of the first byte of tail_buf, or -1 if we aren't fetching the
+     end of the resource.*/
+  opus_int64          tail_start;
+  /*The position we're reading from tail_buf, or -1 if we aren't.*/
+  opus_int64          tail_pos;
 };
 
 static void op_http_stream_init(OpusHTTPStream *_stream){
@@ -907,6 +1134,7 @@ static void op_http_stream_init(OpusHTTPStream *_stream){
     *pnext=_stream->conns+ci;
     pnext=&_stream->conns[ci].next;
   }
+  _stream->pool=NULL;
   _stream->ssl_ctx=NULL;
   _stream->ssl_session=NULL;
   _stream->lru_head=NULL;
@@ -916,6 +1144,24 @@ static void op_http_stream_init(OpusHTTPStream *_stream){
   op_sb_init(&_stream->response);
   _stream->connect_host=NULL;
   _stream->seekable=0;
+  _stream->nonblocking=0;
+  _stream->latency=0;
+  _stream->read_rate=0;
+  _stream->nrequests=0;
+  _stream->last_request_size=-1;
+  _stream->prefetch_buf=NULL;
+  _stream->prefetch_cbuf=0;
+  _stream->prefetch_start=0;
+  _stream->prefetch_nbuf=0;
+  _stream->cache=NULL;
+  _stream->cache_entry=NULL;
+  _stream->cache_fp=NULL;
+  _stream->cache_pos=-1;
+  _stream->validator=NULL;
+  _stream->tail_conn=NULL;
+  _stream->tail_buf=NULL;
+  _stream->tail_start=-1;
+  _stream->tail_pos=-1;
 }
 
 /*Close the connection and move it to the free list.
@@ -937,6 +1183,7 @@ static void op_http_conn_close(OpusHTTPStream *_stream,OpusHTTPConn *_conn,
   if(_gracefully&&_conn->ssl_conn!=NULL)SSL_shutdown(_conn->ssl_conn);
   op_http_conn_clear(_conn);
   _conn->next_pos=-1;
+  _conn->chunk_left=-1;
   _conn->ssl_conn=NULL;
   _conn->fd=OP_INVALID_SOCKET;
   OP_ASSERT(*_pnext==_conn);
@@ -945,7 +1192,244 @@ static void op_http_conn_close(OpusHTTPStream *_stream,OpusHTTPConn *_conn,
   _stream->free_head=_conn;
 }
 
+static void op_http_cache_entry_free(OpusHTTPCacheEntry *_entry){
+  _ogg_free(_entry->ranges);
+  _ogg_free(_entry->validator);
+  _ogg_free(_entry->url);
+  _ogg_free(_entry);
+}
+
+/*Build the path of a file in the cache directory.
+  _name: The name of the file, or NULL for the data file of entry _id.*/
+static int op_http_cache_path(OpusStringBuf *_sb,const OpusHTTPCache *_cache,
+ const char *_name,opus_uint32 _id){
+  char id_buf[16];
+  int  ret;
+  _sb->nbuf=0;
+  ret=op_sb_append_string(_sb,_cache->dir);
+  ret|=op_sb_append(_sb,"/",1);
+  if(_name==NULL){
+    sprintf(id_buf,"%08lx.opc",(unsigned long)_id);
+    _name=id_buf;
+  }
+  ret|=op_sb_append_string(_sb,_name);
+  return ret;
+}
+
+/*Remove an entry and its data file from the cache.
+  _pnext: The linked-list pointer currently pointing to the entry.*/
+static void op_http_cache_remove(OpusHTTPCache *_cache,
+ OpusHTTPCacheEntry **_pnext){
+  OpusHTTPCacheEntry *entry;
+  OpusStringBuf       path;
+  entry=*_pnext;
+  OP_ASSERT(entry->nrefs<=0);
+  op_sb_init(&path);
+  if(OP_LIKELY(op_http_cache_path(&path,_cache,NULL,entry->id)>=0)){
+    op_remove(path.buf);
+  }
+  op_sb_clear(&path);
+  *_pnext=entry->next;
+  _cache->size-=entry->size;
+  _cache->dirty=1;
+  op_http_cache_entry_free(entry);
+}
+
+/*Evict the least recently used entries that are not in use until there is
+   room for _nbytes more bytes.
+  Return: 1 if there is room, or 0 if there is not.*/
+static int op_http_cache_make_room(OpusHTTPCache *_cache,opus_int64 _nbytes){
+  while(_cache->size>_cache->max_size-_nbytes){
+    OpusHTTPCacheEntry **pnext;
+    OpusHTTPCacheEntry **pvictim;
+    pvictim=NULL;
+    for(pnext=&_cache->head;*pnext!=NULL;pnext=&(*pnext)->next){
+      if((*pnext)->nrefs<=0)pvictim=pnext;
+    }
+    if(pvictim==NULL)return 0;
+    op_http_cache_remove(_cache,pvictim);
+  }
+  return 1;
+}
+
+/*Find the end of the stored range containing _pos.
+  Return: The end of the range, or _pos if _pos is not stored.*/
+static opus_int64 op_http_cache_entry_find(const OpusHTTPCacheEntry *_entry,
+ opus_int64 _pos){
+  const opus_int64 *ranges;
+  int               lo;
+  int               hi;
+  ranges=_entry->ranges;
+  /*Find the first range that starts after _pos.*/
+  lo=0;
+  hi=_entry->nranges;
+  while(lo<hi){
+    int mid;
+    mid=lo+hi>>1;
+    if(ranges[2*mid]<=_pos)lo=mid+1;
+    else hi=mid;
+  }
+  /*The one before it is the only one that can contain _pos.*/
+  if(lo>0&&_pos<ranges[2*lo-1])return ranges[2*lo-1];
+  return _pos;
+}
+
+/*Count the bytes in [_start,_end) that are not stored yet.*/
+static opus_int64 op_http_cache_entry_count_new(
+ const OpusHTTPCacheEntry *_entry,opus_int64 _start,opus_int64 _end){
+  const opus_int64 *ranges;
+  opus_int64        nnew;
+  int               nranges;
+  int               i;
+  ranges=_entry->ranges;
+  nranges=_entry->nranges;
+  nnew=_end-_start;
+  for(i=0;i<nranges&&ranges[2*i]<_end;i++){
+    if(ranges[2*i+1]>_start){
+      nnew-=OP_MIN(ranges[2*i+1],_end)-OP_MAX(ranges[2*i],_start);
+    }
+  }
+  return nnew;
+}
+
+/*Record that the bytes in [_start,_end) are now stored.
+  Return: The number of those bytes that were not stored before, or a negative
+           value on error.*/
+static opus_int64 op_http_cache_entry_add(OpusHTTPCacheEntry *_entry,
+ opus_int64 _start,opus_int64 _end){
+  opus_int64 *ranges;
+  opus_int64  nadded;
+  int         nranges;
+  int         i;
+  int         j;
+  int         k;
+  OP_ASSERT(_start<_end);
+  ranges=_entry->ranges;
+  nranges=_entry->nranges;
+  /*Find the ranges this one overlaps or touches.*/
+  for(i=0;i<nranges&&ranges[2*i+1]<_start;i++);
+  for(j=i;j<nranges&&ranges[2*j]<=_end;j++);
+  if(i>=j){
+    /*It doesn't touch any of them, so insert a new one.*/
+    if(nranges>=_entry->cranges){
+      int cranges;
+      if(OP_UNLIKELY(_entry->cranges>INT_MAX>>2))return OP_EFAULT;
+      cranges=OP_MAX(2*_entry->cranges,4);
+      ranges=(opus_int64 *)_ogg_realloc(ranges,sizeof(*ranges)*2*cranges);
+      if(OP_UNLIKELY(ranges==NULL))return OP_EFAULT;
+      _entry->ranges=ranges;
+      _entry->cranges=cranges;
+    }
+    memmove(ranges+2*i+2,ranges+2*i,sizeof(*ranges)*2*(nranges-i));
+    ranges[2*i]=_start;
+    ranges[2*i+1]=_end;
+    _entry->nranges=nranges+1;
+    return _end-_start;
+  }
+  /*Merge them all into the first one.*/
+  _start=OP_MIN(_start,ranges[2*i]);
+  _end=OP_MAX(_end,ranges[2*j-1]);
+  nadded=_end-_start;
+  for(k=i;k<j;k++)nadded-=ranges[2*k+1]-ranges[2*k];
+  ranges[2*i]=_start;
+  ranges[2*i+1]=_end;
+  memmove(ranges+2*i+2,ranges+2*j,sizeof(*ranges)*2*(nranges-j));
+  _entry->nranges=nranges-(j-i-1);
+  return nadded;
+}
+
+/*Append a string to a cache index.
+  Strings are length-prefixed, so they may contain anything but NULs.*/
+static int op_http_cache_append_string(OpusStringBuf *_sb,const char *_s){
+  int ret;
+  ret=op_sb_append(_sb," ",1);
+  ret|=op_sb_append_nonnegative_int64(_sb,(opus_int64)strlen(_s));
+  ret|=op_sb_append(_sb,":",1);
+  ret|=op_sb_append_string(_sb,_s);
+  return ret;
+}
+
+/*Write out the index of the cache, if it has changed.
+  Each line describes one entry, from MRU to LRU:
+   "<id> <content length> <nranges> <start> <end> ... <url> <validator>".
+  The new index is written to a temporary file first, so that a crash can't
+   leave a truncated one behind.*/
+static void op_http_cache_save(OpusHTTPCache *_cache){
+  OpusFileCallbacks   cb;
+  OpusHTTPCacheEntry *entry;
+  OpusStringBuf       index;
+  OpusStringBuf       path;
+  OpusStringBuf       tmp_path;
+  void               *fp;
+  int                 ret;
+  if(!_cache->dirty)return;
+  op_sb_init(&index);
+  op_sb_init(&path);
+  op_sb_init(&tmp_path);
+  ret=op_sb_append_string(&index,OP_CACHE_INDEX_MAGIC);
+  for(entry=_cache->head;entry!=NULL;entry=entry->next){
+    int ri;
+    ret|=op_sb_append_nonnegative_int64(&index,entry->id);
+    ret|=op_sb_append(&index," ",1);
+    ret|=op_sb_append_nonnegative_int64(&index,entry->content_length);
+    ret|=op_sb_append(&index," ",1);
+    ret|=op_sb_append_nonnegative_int64(&index,entry->nranges);
+    for(ri=0;ri<2*entry->nranges;ri++){
+      ret|=op_sb_append(&index," ",1);
+      ret|=op_sb_append_nonnegative_int64(&index,entry->ranges[ri]);
+    }
+    ret|=op_http_cache_append_string(&index,entry->url);
+    ret|=op_http_cache_append_string(&index,entry->validator);
+    ret|=op_sb_append(&index,"\n",1);
+  }
+  ret|=op_http_cache_path(&path,_cache,OP_CACHE_INDEX_NAME,0);
+  ret|=op_http_cache_path(&tmp_path,_cache,OP_CACHE_INDEX_NAME ".tmp",0);
+  if(OP_LIKELY(ret>=0)){
+    fp=op_fopen(&cb,tmp_path.buf,"wb");
+    if(OP_LIKELY(fp!=NULL)){
+      size_t nwritten;
+      nwritten=fwrite(index.buf,1,index.nbuf,(FILE *)fp);
+      if((*cb.close)(fp)==0&&nwritten==(size_t)index.nbuf){
+#if defined(_WIN32)
+        /*rename() won't replace an existing file on Windows.*/
+        op_remove(path.buf);
+#endif
+        if(op_rename(tmp_path.buf,path.buf)==0)_cache->dirty=0;
+      }
+    }
+  }
+  op_sb_clear(&tmp_path);
+  op_sb_clear(&path);
+  op_sb_clear(&index);
+}
+
+/*Stop using the cache for this stream.*/
+static void op_http_stream_cache_close(OpusHTTPStream *_stream){
+  if(_stream->cache_entry!=NULL){
+    (*_stream->cache_cb.close)(_stream->cache_fp);
+    _stream->cache_fp=NULL;
+    _stream->cache_entry->nrefs--;
+    _stream->cache_entry=NULL;
+    op_http_cache_save(_stream->cache);
+  }
+}
+
+/*Close the connection fetching the end of the resource, if it's open.*/
+static void op_http_stream_tail_close(OpusHTTPStream *_stream){
+  OpusHTTPConn *conn;
+  conn=_stream->tail_conn;
+  if(conn!=NULL){
+    OpusHTTPConn *head;
+    /*It isn't in the LRU list, so give op_http_conn_close() a list of one.*/
+    head=conn;
+    op_http_conn_close(_stream,conn,&head,0);
+    _stream->tail_conn=NULL;
+  }
+}
+
 static void op_http_stream_clear(OpusHTTPStream *_stream){
+  op_http_stream_cache_close(_stream);
+  op_http_stream_tail_close(_stream);
   while(_stream->lru_head!=NULL){
     op_http_conn_close(_stream,_stream->lru_head,&_stream->lru_head,0);
   }
@@ -956,6 +1440,9 @@ static void op_http_stream_clear(OpusHTTPStream *_stream){
   op_sb_clear(&_stream->request);
   if(_stream->connect_host!=_stream->url.host)_ogg_free(_stream->connect_host);
   op_parsed_url_clear(&_stream->url);
+  _ogg_free(_stream->prefetch_buf);
+  _ogg_free(_stream->validator);
+  _ogg_free(_stream->tail_buf);
 }
 
 static int op_http_conn_write_fully(OpusHTTPConn *_conn,
@@ -1055,6 +1542,261 @@ static opus_int32 op_time_diff_ms(const op_time *_end, const op_time *_start){
 # endif
 }
 
+static void op_http_idle_conn_free(OpusHTTPIdleConn *_idle){
+  if(_idle->ssl_conn!=NULL){
+    /*See op_http_conn_close() for why we try to shut down gracefully.*/
+    SSL_shutdown(_idle->ssl_conn);
+    SSL_free(_idle->ssl_conn);
+  }
+  if(_idle->fd!=OP_INVALID_SOCKET)close(_idle->fd);
+  _ogg_free(_idle->proxy_connect);
+  _ogg_free(_idle->connect_host);
+  _ogg_free(_idle->host);
+  _ogg_free(_idle);
+}
+
+/*Check whether a pooled connection is still usable.
+  The server has no business sending anything on an idle connection, so if
+   there is anything to read, it is either closing the connection or confused,
+   and either way we don't want it.*/
+static int op_http_idle_conn_alive(const OpusHTTPIdleConn *_idle){
+  struct pollfd fd;
+  fd.fd=_idle->fd;
+  fd.events=POLLIN;
+  if(_idle->ssl_conn!=NULL&&SSL_pending(_idle->ssl_conn)>0)return 0;
+  return poll(&fd,1,0)==0;
+}
+
+/*Check whether there is anything to read on a connection without waiting for
+   the server.*/
+static int op_http_conn_readable(OpusHTTPConn *_conn){
+  struct pollfd  fd;
+  SSL           *ssl_conn;
+  char           c;
+  int            ret;
+  ssl_conn=_conn->ssl_conn;
+  if(ssl_conn!=NULL&&SSL_pending(ssl_conn)>0)return 1;
+  fd.fd=_conn->fd;
+  fd.events=POLLIN;
+  if(poll(&fd,1,0)<=0)return 0;
+  if(ssl_conn==NULL)return 1;
+  /*A readable socket might only hold part of a TLS record, in which case
+     SSL_read() would have to wait for the rest.
+    The socket is non-blocking, so we can ask OpenSSL to process whatever has
+     arrived without waiting for more.*/
+  ret=SSL_peek(ssl_conn,&c,1);
+  if(ret>0)return 1;
+  /*Let an actual read report a closed connection or an error.
+    A renegotiation that needs to write is left to the read as well, as we
+     can only wait for the socket to become readable.*/
+  return SSL_get_error(ssl_conn,ret)!=SSL_ERROR_WANT_READ;
+}
+
+/*Whether the given pooled connection can be used by this stream.*/
+static int op_http_idle_conn_matches(const OpusHTTPStream *_stream,
+ const OpusHTTPIdleConn *_idle){
+  return _idle->is_ssl==OP_URL_IS_SSL(&_stream->url)
+   &&_idle->port==_stream->url.port
+   &&_idle->connect_port==_stream->connect_port
+   &&(!_idle->is_ssl
+   ||_idle->skip_certificate_check==_stream->skip_certificate_check)
+   &&_idle->proxy_connect_len==_stream->proxy_connect.nbuf
+   &&strcmp(_idle->host,_stream->url.host)==0
+   &&strcmp(_idle->connect_host,_stream->connect_host)==0
+   &&(_idle->proxy_connect_len<=0||memcmp(_idle->proxy_connect,
+   _stream->proxy_connect.buf,_idle->proxy_connect_len)==0);
+}
+
+/*Try to take a connection for this stream out of its pool.
+  Stale connections are closed along the way.
+  _conn:             The free connection to set up.
+  [out] _start_time: Returns the time the connection was taken.
+  Return: 1 if a connection was found, or 0 otherwise.*/
+static int op_http_conn_pool_take(OpusHTTPStream *_stream,
+ OpusHTTPConn *_conn,op_time *_start_time){
+  OpusHTTPConnPool  *pool;
+  OpusHTTPIdleConn **pnext;
+  OpusHTTPIdleConn  *idle;
+  pool=_stream->pool;
+  op_time_get(_start_time);
+  pnext=&pool->idle_head;
+  while((idle=*pnext)!=NULL){
+    if(op_time_diff_ms(_start_time,&idle->idle_time)>
+     OP_CONNECTION_IDLE_TIMEOUT_MS||!op_http_idle_conn_alive(idle)){
+      *pnext=idle->next;
+      pool->nidle--;
+      op_http_idle_conn_free(idle);
+      continue;
+    }
+    if(op_http_idle_conn_matches(_stream,idle))break;
+    pnext=&idle->next;
+  }
+  if(idle==NULL)return 0;
+  *pnext=idle->next;
+  pool->nidle--;
+  /*Pop the connection off the free list and put it on the LRU list, just like
+     op_http_connect_impl() does.*/
+  OP_ASSERT(_stream->free_head==_conn);
+  _stream->free_head=_conn->next;
+  _conn->next=_stream->lru_head;
+  _stream->lru_head=_conn;
+  *&_conn->read_time=*_start_time;
+  _conn->read_bytes=0;
+  _conn->read_rate=0;
+  _conn->ssl_conn=idle->ssl_conn;
+  _conn->fd=idle->fd;
+  _conn->nrequests_left=idle->nrequests_left;
+  /*Future connections can go to the same address without resolving it.*/
+  memcpy(&_stream->addr_info,&idle->addr_info,sizeof(_stream->addr_info));
+  _stream->addr_info.ai_addr=&_stream->addr.s;
+  memcpy(&_stream->addr,&idle->addr,sizeof(_stream->addr));
+  *&_stream->resolve_time=*&idle->resolve_time;
+  idle->ssl_conn=NULL;
+  idle->fd=OP_INVALID_SOCKET;
+  op_http_idle_conn_free(idle);
+  return 1;
+}
+
+/*Give a connection to the stream's pool if it can be re-used, or close it
+   otherwise.
+  Either way, it ends up on the free list.
+  _conn:  The connection to give away.
+  _pnext: The linked-list pointer currently pointing to this connection.*/
+static void op_http_conn_pool_put(OpusHTTPStream *_stream,OpusHTTPConn *_conn,
+ OpusHTTPConn **_pnext){
+  OpusHTTPConnPool *pool;
+  OpusHTTPIdleConn *idle;
+  pool=_stream->pool;
+  /*Only keep connections that are sitting between two responses of a
+     persistent connection, with enough requests left to be worth the trouble
+     (the same limit op_http_stream_seek() uses).*/
+  if(!_stream->pipeline||_conn->next_pos>=0
+   ||_conn->end_pos<0||_conn->pos<_conn->end_pos
+   ||_conn->nrequests_left<OP_PIPELINE_MIN_REQUESTS){
+    op_http_conn_close(_stream,_conn,_pnext,1);
+    return;
+  }
+  idle=(OpusHTTPIdleConn *)_ogg_malloc(sizeof(*idle));
+  if(OP_UNLIKELY(idle==NULL)){
+    op_http_conn_close(_stream,_conn,_pnext,1);
+    return;
+  }
+  idle->host=op_string_dup(_stream->url.host);
+  idle->connect_host=op_string_dup(_stream->connect_host);
+  idle->proxy_connect_len=_stream->proxy_connect.nbuf;
+  idle->proxy_connect=NULL;
+  if(idle->proxy_connect_len>0){
+    idle->proxy_connect=op_string_range_dup(_stream->proxy_connect.buf,
+     _stream->proxy_connect.buf+idle->proxy_connect_len);
+  }
+  idle->ssl_conn=NULL;
+  idle->fd=OP_INVALID_SOCKET;
+  if(OP_UNLIKELY(idle->host==NULL)||OP_UNLIKELY(idle->connect_host==NULL)
+   ||OP_UNLIKELY(idle->proxy_connect_len>0&&idle->proxy_connect==NULL)){
+    op_http_idle_conn_free(idle);
+    op_http_conn_close(_stream,_conn,_pnext,1);
+    return;
+  }
+  idle->port=_stream->url.port;
+  idle->connect_port=_stream->connect_port;
+  idle->is_ssl=OP_URL_IS_SSL(&_stream->url);
+  /*This is only set for https streams.*/
+  idle->skip_certificate_check=idle->is_ssl&&_stream->skip_certificate_check;
+  idle->nrequests_left=_conn->nrequests_left;
+  op_time_get(&idle->idle_time);
+  memcpy(&idle->addr_info,&_stream->addr_info,sizeof(idle->addr_info));
+  idle->addr_info.ai_addr=&idle->addr.s;
+  memcpy(&idle->addr,&_stream->addr,sizeof(idle->addr));
+  *&idle->resolve_time=*&_stream->resolve_time;
+  /*Hand the socket over to the pool before putting the connection on the free
+     list, so it doesn't get closed.*/
+  idle->ssl_conn=_conn->ssl_conn;
+  idle->fd=_conn->fd;
+  _conn->ssl_conn=NULL;
+  _conn->fd=OP_INVALID_SOCKET;
+  op_http_conn_close(_stream,_conn,_pnext,0);
+  idle->next=pool->idle_head;
+  pool->idle_head=idle;
+  if(++pool->nidle>pool->max_idle){
+    OpusHTTPIdleConn **pnext;
+    /*Drop the least recently used connection.*/
+    for(pnext=&pool->idle_head;(*pnext)->next!=NULL;pnext=&(*pnext)->next);
+    op_http_idle_conn_free(*pnext);
+    *pnext=NULL;
+    pool->nidle--;
+  }
+}
+
+static void op_http_resolved_free(OpusHTTPResolved *_resolved){
+  freeaddrinfo(_resolved->addrs);
+  _ogg_free(_resolved->host);
+  _ogg_free(_resolved);
+}
+
+/*Look up a host in the pool's address cache, resolving it if it's missing or
+   has expired.
+  The addresses remain owned by the pool, and are only valid until the next
+   call that might resolve another host.
+  _host:              The host to resolve.
+  _port:              The port to connect to.
+  [out] _resolve_time: Returns the time the host was actually resolved.
+  Return: The list of addresses, or NULL if the host could not be resolved.*/
+static struct addrinfo *op_http_conn_pool_resolve(OpusHTTPConnPool *_pool,
+ const char *_host,unsigned _port,op_time *_resolve_time){
+  OpusHTTPResolved **pnext;
+  OpusHTTPResolved  *resolved;
+  struct addrinfo   *addrs;
+  op_time            now;
+  op_time_get(&now);
+  for(pnext=&_pool->resolved_head;(resolved=*pnext)!=NULL;
+   pnext=&resolved->next){
+    if(resolved->port==_port&&strcmp(resolved->host,_host)==0)break;
+  }
+  if(resolved!=NULL){
+    *pnext=resolved->next;
+    if(op_time_diff_ms(&now,&resolved->resolve_time)
+     <OP_RESOLVE_CACHE_TIMEOUT_MS){
+      /*Move it to the front of the list.*/
+      resolved->next=_pool->resolved_head;
+      _pool->resolved_head=resolved;
+      *_resolve_time=*&resolved->resolve_time;
+      return resolved->addrs;
+    }
+    /*It expired: resolve it again.*/
+    op_http_resolved_free(resolved);
+    _pool->nresolved--;
+  }
+  addrs=op_resolve(_host,_port);
+  if(OP_UNLIKELY(addrs==NULL))return NULL;
+  resolved=(OpusHTTPResolved *)_ogg_malloc(sizeof(*resolved));
+  if(OP_LIKELY(resolved!=NULL)){
+    resolved->host=op_string_dup(_host);
+    if(OP_UNLIKELY(resolved->host==NULL)){
+      _ogg_free(resolved);
+      resolved=NULL;
+    }
+  }
+  if(OP_UNLIKELY(resolved==NULL)){
+    freeaddrinfo(addrs);
+    return NULL;
+  }
+  resolved->port=_port;
+  resolved->addrs=addrs;
+  *&resolved->resolve_time=*&now;
+  resolved->next=_pool->resolved_head;
+  _pool->resolved_head=resolved;
+  if(++_pool->nresolved>OP_RESOLVE_CACHE_SIZE){
+    /*Forget the least recently used host.*/
+    for(pnext=&_pool->resolved_head;(*pnext)->next!=NULL;
+     pnext=&(*pnext)->next);
+    op_http_resolved_free(*pnext);
+    *pnext=NULL;
+    _pool->nresolved--;
+  }
+  *_resolve_time=*&now;
+  return addrs;
+}
+
 /*Update the read rate estimate for this connection.*/
 static void op_http_conn_read_rate_update(OpusHTTPConn *_conn){
   op_time      read_time;
@@ -1501,6 +2243,30 @@ static int op_http_parse_connection(char *_cdr){
   return OP_UNLIKELY(*_cdr!='\0')?OP_FALSE:ret;
 }
 
+/*Parse a Transfer-Encoding header.
+  Return: 1 if the body is chunked, 0 if no transfer coding was applied, or a
+           negative value if we don't support the codings used.*/
+static int op_http_parse_transfer_encoding(char *_cdr){
+  size_t d;
+  int    ret;
+  ret=0;
+  for(;;){
+    d=strcspn(_cdr,OP_HTTP_CTOKEN);
+    if(OP_UNLIKELY(d<=0))return OP_FALSE;
+    /*"chunked" must be the last coding applied, and we don't support any of
+       the compression codings.*/
+    if(OP_UNLIKELY(ret))return OP_FALSE;
+    if(d==7&&op_strncasecmp(_cdr,"chunked",7)==0)ret=1;
+    else if(d!=8||op_strncasecmp(_cdr,"identity",8)!=0)return OP_EIMPL;
+    _cdr+=d;
+    _cdr+=op_http_lwsspn(_cdr);
+    if(*_cdr!=',')break;
+    _cdr++;
+    _cdr+=op_http_lwsspn(_cdr);
+  }
+  return OP_UNLIKELY(*_cdr!='\0')?OP_FALSE:ret;
+}
+
 typedef int (*op_ssl_step_func)(SSL *_ssl_conn);
 
 /*Try to run an SSL function to completion (blocking if necessary).*/
@@ -1574,6 +2340,10 @@ static long op_bio_retry_ctrl(BIO *_b,int _cmd,long _num,void *_ptr){
 #  define BIO_set_data(_b,_ptr) ((_b)->ptr=(_ptr))
 #  define BIO_set_init(_b,_init) ((_b)->init=(_init))
 #  define ASN1_STRING_get0_data ASN1_STRING_data
+#  define SSL_CTX_up_ref(_ctx) \
+ (CRYPTO_add(&(_ctx)->references,1,CRYPTO_LOCK_SSL_CTX))
+#  define SSL_SESSION_up_ref(_session) \
+ (CRYPTO_add(&(_session)->references,1,CRYPTO_LOCK_SSL_SESSION))
 # endif
 
 static int op_bio_retry_new(BIO *_b){
@@ -1918,6 +2688,128 @@ static int op_http_verify_hostname(OpusHTTPStream *_stream,SSL *_ssl_conn){
 }
 # endif
 
+/*Create a new TLS context, initializing the SSL library if necessary.
+  Return: The new context, or NULL on failure.*/
+static SSL_CTX *op_ssl_ctx_create(int _skip_certificate_check){
+  SSL_CTX *ssl_ctx;
+# if (OPENSSL_VERSION_NUMBER<0x10100000L&&LIBRESSL_VERSION_NUMBER<0x2070000fL)
+#  if !defined(OPENSSL_NO_LOCKING)
+  /*The documentation says SSL_library_init() is not reentrant.
+    We don't want to add our own depenencies on a threading library, and it
+     appears that it's safe to call OpenSSL's locking functions before the
+     library is initialized, so that's what we'll do (really OpenSSL should
+     do this for us).
+    This doesn't guarantee that _other_ threads in the application aren't
+     calling SSL_library_init() at the same time, but there's not much we
+     can do about that.*/
+  CRYPTO_w_lock(CRYPTO_LOCK_SSL);
+#  endif
+  SSL_library_init();
+  /*Needed to get SHA2 algorithms with old OpenSSL versions.*/
+  OpenSSL_add_ssl_algorithms();
+#  if !defined(OPENSSL_NO_LOCKING)
+  CRYPTO_w_unlock(CRYPTO_LOCK_SSL);
+#  endif
+# else
+  /*Finally, OpenSSL does this for us, but as penance, it can now fail.*/
+  if(!OPENSSL_init_ssl(0,NULL))return NULL;
+# endif
+  ssl_ctx=SSL_CTX_new(SSLv23_client_method());
+  if(ssl_ctx==NULL)return NULL;
+  if(!_skip_certificate_check){
+    /*We don't do anything if this fails, since it just means we won't load
+       any certificates (and thus all checks will fail).
+      However, as that is probably the result of a system
+       mis-configuration, assert here to make it easier to identify.*/
+    OP_ALWAYS_TRUE(SSL_CTX_set_default_verify_paths(ssl_ctx));
+    SSL_CTX_set_verify(ssl_ctx,SSL_VERIFY_PEER,NULL);
+  }
+  return ssl_ctx;
+}
+
+/*Get a reference to the pool's TLS context, creating it if necessary.
+  Loading the trust store is the expensive part of creating one, so sharing it
+   saves that for every stream after the first.
+  Return: A new reference to the context, or NULL on failure.*/
+static SSL_CTX *op_http_conn_pool_get_ssl_ctx(OpusHTTPConnPool *_pool,
+ int _skip_certificate_check){
+  SSL_CTX *ssl_ctx;
+  ssl_ctx=_pool->ssl_ctx[_skip_certificate_check];
+  if(ssl_ctx==NULL){
+    ssl_ctx=op_ssl_ctx_create(_skip_certificate_check);
+    if(OP_UNLIKELY(ssl_ctx==NULL))return NULL;
+    _pool->ssl_ctx[_skip_certificate_check]=ssl_ctx;
+  }
+  SSL_CTX_up_ref(ssl_ctx);
+  return ssl_ctx;
+}
+
+static void op_http_session_free(OpusHTTPSession *_session){
+  SSL_SESSION_free(_session->ssl_session);
+  _ogg_free(_session->host);
+  _ogg_free(_session);
+}
+
+/*Find a TLS session for the stream's host in the pool.
+  Return: A new reference to the session, or NULL if there is none.*/
+static SSL_SESSION *op_http_conn_pool_get_session(OpusHTTPConnPool *_pool,
+ const OpusHTTPStream *_stream){
+  OpusHTTPSession **pnext;
+  OpusHTTPSession  *session;
+  for(pnext=&_pool->session_head;(session=*pnext)!=NULL;pnext=&session->next){
+    if(session->port==_stream->url.port
+     &&session->skip_certificate_check==_stream->skip_certificate_check
+     &&strcmp(session->host,_stream->url.host)==0){
+      /*Move it to the front of the list.*/
+      *pnext=session->next;
+      session->next=_pool->session_head;
+      _pool->session_head=session;
+      SSL_SESSION_up_ref(session->ssl_session);
+      return session->ssl_session;
+    }
+  }
+  return NULL;
+}
+
+/*Remember a TLS session for the stream's host in the pool, replacing any
+   older one.*/
+static void op_http_conn_pool_put_session(OpusHTTPConnPool *_pool,
+ const OpusHTTPStream *_stream,SSL_SESSION *_ssl_session){
+  OpusHTTPSession **pnext;
+  OpusHTTPSession  *session;
+  for(pnext=&_pool->session_head;(session=*pnext)!=NULL;pnext=&session->next){
+    if(session->port==_stream->url.port
+     &&session->skip_certificate_check==_stream->skip_certificate_check
+     &&strcmp(session->host,_stream->url.host)==0){
+      *pnext=session->next;
+      op_http_session_free(session);
+      _pool->nsessions--;
+      break;
+    }
+  }
+  session=(OpusHTTPSession *)_ogg_malloc(sizeof(*session));
+  if(OP_UNLIKELY(session==NULL))return;
+  session->host=op_string_dup(_stream->url.host);
+  if(OP_UNLIKELY(session->host==NULL)){
+    _ogg_free(session);
+    return;
+  }
+  session->port=_stream->url.port;
+  session->skip_certificate_check=_stream->skip_certificate_check;
+  SSL_SESSION_up_ref(_ssl_session);
+  session->ssl_session=_ssl_session;
+  session->next=_pool->session_head;
+  _pool->session_head=session;
+  if(++_pool->nsessions>OP_SSL_SESSION_CACHE_SIZE){
+    /*Forget the least recently used session.*/
+    for(pnext=&_pool->session_head;(*pnext)->next!=NULL;
+     pnext=&(*pnext)->next);
+    op_http_session_free(*pnext);
+    *pnext=NULL;
+    _pool->nsessions--;
+  }
+}
+
 /*Perform the TLS handshake on a new connection.*/
 static int op_http_conn_start_tls(OpusHTTPStream *_stream,OpusHTTPConn *_conn,
  op_sock _fd,SSL *_ssl_conn){
@@ -1976,7 +2868,12 @@ static int op_http_conn_start_tls(OpusHTTPStream *_stream,OpusHTTPConn *_conn,
     if(addr!=NULL)freeaddrinfo(addr);
   }
 # endif
-  /*Resume a previous session if available.*/
+  /*Resume a previous session if available.
+    If this stream doesn't have one yet, another stream to the same host may
+     have left one in the pool.*/
+  if(_stream->ssl_session==NULL&&_stream->pool!=NULL){
+    _stream->ssl_session=op_http_conn_pool_get_session(_stream->pool,_stream);
+  }
   if(_stream->ssl_session!=NULL){
     SSL_set_session(_ssl_conn,_stream->ssl_session);
   }
@@ -2014,6 +2911,10 @@ static int op_http_conn_start_tls(OpusHTTPStream *_stream,OpusHTTPConn *_conn,
     if(ssl_session==NULL){
       /*Save the session for later resumption.*/
       _stream->ssl_session=SSL_get1_session(_ssl_conn);
+      if(_stream->pool!=NULL&&_stream->ssl_session!=NULL){
+        op_http_conn_pool_put_session(_stream->pool,_stream,
+         _stream->ssl_session);
+      }
     }
   }
   _conn->ssl_conn=_ssl_conn;
@@ -2186,20 +3087,37 @@ static int op_http_connect_impl(OpusHTTPStream *_stream,OpusHTTPConn *_conn,
   return 0;
 }
 
+/*Connect to the stream's host.
+  Return: 0 if we opened a new connection, 1 if we took one from the pool, or a
+           negative value on error.*/
 static int op_http_connect(OpusHTTPStream *_stream,OpusHTTPConn *_conn,
  struct addrinfo *_addrs,op_time *_start_time){
   op_time          resolve_time;
   struct addrinfo *new_addrs;
   int              ret;
+  /*Use an idle connection to the same server if we've been given one.*/
+  if(_stream->pool!=NULL
+   &&op_http_conn_pool_take(_stream,_conn,_start_time)){
+    return 1;
+  }
   /*Re-resolve the host if we need to (RFC 6555 says we MUST do so
      occasionally).*/
   new_addrs=NULL;
   op_time_get(&resolve_time);
   if(_addrs!=&_stream->addr_info||op_time_diff_ms(&resolve_time,
    &_stream->resolve_time)>=OP_RESOLVE_CACHE_TIMEOUT_MS){
-    new_addrs=op_resolve(_stream->connect_host,_stream->connect_port);
-    if(OP_LIKELY(new_addrs!=NULL)){
-      _addrs=new_addrs;
+    struct addrinfo *resolved_addrs;
+    /*The pool's cache owns the addresses it returns, so we don't free them.*/
+    if(_stream->pool!=NULL){
+      resolved_addrs=op_http_conn_pool_resolve(_stream->pool,
+       _stream->connect_host,_stream->connect_port,&resolve_time);
+    }
+    else{
+      resolved_addrs=new_addrs=op_resolve(_stream->connect_host,
+       _stream->connect_port);
+    }
+    if(OP_LIKELY(resolved_addrs!=NULL)){
+      _addrs=resolved_addrs;
       *&_stream->resolve_time=*&resolve_time;
     }
     else if(OP_LIKELY(_addrs==NULL))return OP_FALSE;
@@ -2322,9 +3240,51 @@ static int op_http_allow_pipelining(const char *_server){
 # undef NBAD_SERVERS
 }
 
+/*Ask for the end of the resource on a second connection, without waiting for
+   the response.
+  This is done once the response to the initial request has arrived, so that
+   setting up the second connection does not count against the connection
+   time and latency measured for the first.
+  The tail request's round trip then overlaps reading the headers.
+  Failure isn't fatal: we just won't have the tail.*/
+static void op_http_stream_tail_start(OpusHTTPStream *_stream){
+  op_time       start_time;
+  OpusHTTPConn *conn;
+  int           ret;
+  conn=_stream->free_head;
+  if(conn==NULL)return;
+  ret=op_http_connect(_stream,conn,&_stream->addr_info,&start_time);
+  if(OP_UNLIKELY(ret<0)){
+    if(_stream->lru_head==conn){
+      op_http_conn_close(_stream,conn,&_stream->lru_head,0);
+    }
+    return;
+  }
+  /*Take it back out of the LRU list, so the connection for the initial request
+     stays at the head.*/
+  OP_ASSERT(_stream->lru_head==conn);
+  _stream->lru_head=conn->next;
+  conn->next=NULL;
+  _stream->tail_conn=conn;
+  /*Swap the range in the initial request for a suffix range, and then put it
+     back.*/
+  _stream->request.nbuf=_stream->request_tail;
+  ret=op_sb_append(&_stream->request,"-",1);
+  ret|=op_sb_append_nonnegative_int64(&_stream->request,OP_HTTP_TAIL_SIZE);
+  ret|=op_sb_append(&_stream->request,"\r\n\r\n",4);
+  if(OP_LIKELY(ret>=0)){
+    ret=op_http_conn_write_fully(conn,
+     _stream->request.buf,_stream->request.nbuf);
+  }
+  _stream->request.nbuf=_stream->request_tail;
+  ret|=op_sb_append(&_stream->request,"0-\r\n\r\n",6);
+  if(OP_UNLIKELY(ret<0))op_http_stream_tail_close(_stream);
+}
+
 static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
  int _skip_certificate_check,const char *_proxy_host,unsigned _proxy_port,
- const char *_proxy_user,const char *_proxy_pass,OpusServerInfo *_info){
+ const char *_proxy_user,const char *_proxy_pass,int _fetch_tail,
+ OpusServerInfo *_info){
   struct addrinfo *addrs;
   int              nredirs;
   int              ret;
@@ -2346,6 +3306,7 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
   for(nredirs=0;nredirs<OP_REDIRECT_LIMIT;nredirs++){
     OpusParsedURL  next_url;
     op_time        start_time;
+    op_time        request_time;
     op_time        end_time;
     char          *next;
     char          *status_code;
@@ -2354,38 +3315,12 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
     /*Initialize the SSL library if necessary.*/
     if(OP_URL_IS_SSL(&_stream->url)&&_stream->ssl_ctx==NULL){
       SSL_CTX *ssl_ctx;
-# if (OPENSSL_VERSION_NUMBER<0x10100000L&&LIBRESSL_VERSION_NUMBER<0x2070000fL)
-#  if !defined(OPENSSL_NO_LOCKING)
-      /*The documentation says SSL_library_init() is not reentrant.
-        We don't want to add our own depenencies on a threading library, and it
-         appears that it's safe to call OpenSSL's locking functions before the
-         library is initialized, so that's what we'll do (really OpenSSL should
-         do this for us).
-        This doesn't guarantee that _other_ threads in the application aren't
-         calling SSL_library_init() at the same time, but there's not much we
-         can do about that.*/
-      CRYPTO_w_lock(CRYPTO_LOCK_SSL);
-#  endif
-      SSL_library_init();
-      /*Needed to get SHA2 algorithms with old OpenSSL versions.*/
-      OpenSSL_add_ssl_algorithms();
-#  if !defined(OPENSSL_NO_LOCKING)
-      CRYPTO_w_unlock(CRYPTO_LOCK_SSL);
-#  endif
-# else
-      /*Finally, OpenSSL does this for us, but as penance, it can now fail.*/
-      if(!OPENSSL_init_ssl(0,NULL))return OP_EFAULT;
-# endif
-      ssl_ctx=SSL_CTX_new(SSLv23_client_method());
-      if(ssl_ctx==NULL)return OP_EFAULT;
-      if(!_skip_certificate_check){
-        /*We don't do anything if this fails, since it just means we won't load
-           any certificates (and thus all checks will fail).
-          However, as that is probably the result of a system
-           mis-configuration, assert here to make it easier to identify.*/
-        OP_ALWAYS_TRUE(SSL_CTX_set_default_verify_paths(ssl_ctx));
-        SSL_CTX_set_verify(ssl_ctx,SSL_VERIFY_PEER,NULL);
+      if(_stream->pool!=NULL){
+        ssl_ctx=op_http_conn_pool_get_ssl_ctx(_stream->pool,
+         _skip_certificate_check);
       }
+      else ssl_ctx=op_ssl_ctx_create(_skip_certificate_check);
+      if(ssl_ctx==NULL)return OP_EFAULT;
       _stream->ssl_ctx=ssl_ctx;
       _stream->skip_certificate_check=_skip_certificate_check;
       if(_proxy_host!=NULL){
@@ -2418,9 +3353,6 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
         if(OP_UNLIKELY(ret<0))return ret;
       }
     }
-    /*Actually make the connection.*/
-    ret=op_http_connect(_stream,_stream->conns+0,addrs,&start_time);
-    if(OP_UNLIKELY(ret<0))return ret;
     /*Build the request to send.*/
     _stream->request.nbuf=0;
     ret=op_sb_append(&_stream->request,"GET ",4);
@@ -2475,11 +3407,25 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
     _stream->request_tail=_stream->request.nbuf-4;
     ret|=op_sb_append(&_stream->request,"\r\n",2);
     if(OP_UNLIKELY(ret<0))return ret;
-    ret=op_http_conn_write_fully(_stream->conns+0,
-     _stream->request.buf,_stream->request.nbuf);
-    if(OP_UNLIKELY(ret<0))return ret;
-    ret=op_http_conn_read_response(_stream->conns+0,&_stream->response);
-    if(OP_UNLIKELY(ret<0))return ret;
+    for(;;){
+      int pooled;
+      /*Actually make the connection.*/
+      ret=op_http_connect(_stream,_stream->conns+0,addrs,&start_time);
+      if(OP_UNLIKELY(ret<0))return ret;
+      pooled=ret;
+      op_time_get(&request_time);
+      ret=op_http_conn_write_fully(_stream->conns+0,
+       _stream->request.buf,_stream->request.nbuf);
+      if(OP_LIKELY(ret>=0)){
+        ret=op_http_conn_read_response(_stream->conns+0,&_stream->response);
+      }
+      if(OP_LIKELY(ret>=0))break;
+      if(!pooled)return ret;
+      /*The server may have given up on a connection from the pool while it
+         sat idle.
+        Try again with another one.*/
+      op_http_conn_close(_stream,_stream->conns+0,&_stream->lru_head,0);
+    }
     op_time_get(&end_time);
     next=op_http_parse_status_line(&v1_1_compat,&status_code,
      _stream->response.buf);
@@ -2487,12 +3433,17 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
     if(status_code[0]=='2'){
       opus_int64 content_length;
       opus_int64 range_length;
+      char      *etag;
+      char      *last_modified;
       int        pipeline_supported;
       int        pipeline_disabled;
+      int        chunked;
       /*We only understand 20x codes.*/
       if(status_code[1]!='0')return OP_FALSE;
       content_length=-1;
       range_length=-1;
+      etag=last_modified=NULL;
+      chunked=0;
       /*Pipelining must be explicitly enabled.*/
       pipeline_supported=0;
       pipeline_disabled=0;
@@ -2555,6 +3506,13 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
           if(OP_UNLIKELY(ret<0))return ret;
           pipeline_disabled|=ret;
         }
+        else if(strcmp(header,"transfer-encoding")==0){
+          /*Two Transfer-Encoding headers?*/
+          if(OP_UNLIKELY(chunked))return OP_FALSE;
+          ret=op_http_parse_transfer_encoding(cdr);
+          if(OP_UNLIKELY(ret<0))return ret;
+          chunked=ret;
+        }
         else if(strcmp(header,"server")==0){
           /*If we got a Server response header, and it wasn't from a known-bad
              server, enable pipelining, as long as it's at least HTTP/1.1.
@@ -2567,6 +3525,15 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
           if(v1_1_compat)pipeline_disabled|=!op_http_allow_pipelining(cdr);
           if(_info!=NULL&&_info->server==NULL)_info->server=op_string_dup(cdr);
         }
+        /*Collect the validators needed to use the cache.*/
+        else if(_stream->cache!=NULL&&strcmp(header,"etag")==0){
+          /*A weak ETag doesn't promise the bytes are identical, so it can't
+             be used to combine ranges from different requests.*/
+          if(etag==NULL&&strncmp(cdr,"W/",2)!=0)etag=cdr;
+        }
+        else if(_stream->cache!=NULL&&strcmp(header,"last-modified")==0){
+          if(last_modified==NULL)last_modified=cdr;
+        }
         /*Collect station information headers if the caller requested it.
           If there's more than one copy of a header, the first one wins.*/
         else if(_info!=NULL){
@@ -2641,16 +3608,44 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
           207...209 are not yet defined, so we don't know how to handle them.*/
         default:return OP_FALSE;
       }
+      if(chunked){
+        /*A Content-Length must be ignored when the body is chunked, and we
+           only support chunked bodies when reading until EOF, so treat the
+           stream as unseekable.*/
+        content_length=-1;
+        _stream->seekable=0;
+      }
       _stream->content_length=content_length;
+      if(_stream->seekable&&(etag!=NULL||last_modified!=NULL)){
+        _stream->validator=op_string_dup(etag!=NULL?etag:last_modified);
+      }
+      /*Only ask for the end if the initial request won't give it to us anyway.
+        This has to be done before we upgrade the request to HTTP/1.1 below.*/
+      if(_fetch_tail&&_stream->seekable&&content_length>OP_HTTP_TAIL_SIZE){
+        op_http_stream_tail_start(_stream);
+      }
       _stream->pipeline=pipeline_supported&&!pipeline_disabled;
       /*Pipelining requires HTTP/1.1 persistent connections.*/
       if(_stream->pipeline)_stream->request.buf[minor_version_pos]='1';
       _stream->conns[0].pos=0;
       _stream->conns[0].end_pos=_stream->seekable?content_length:-1;
       _stream->conns[0].chunk_size=-1;
+      _stream->conns[0].chunk_left=chunked?0:-1;
       _stream->cur_conni=0;
+      if(_stream->tail_conn!=NULL){
+        OpusHTTPConn *tail_conn;
+        tail_conn=_stream->tail_conn;
+        _stream->tail_start=content_length-OP_HTTP_TAIL_SIZE;
+        tail_conn->pos=tail_conn->end_pos=-1;
+        tail_conn->next_pos=_stream->tail_start;
+        tail_conn->next_end=content_length;
+        /*We sent an HTTP/1.0 request, so we won't re-use the connection.*/
+        tail_conn->nrequests_left=0;
+      }
       _stream->connect_rate=op_time_diff_ms(&end_time,&start_time);
       _stream->connect_rate=OP_MAX(_stream->connect_rate,1);
+      _stream->latency=op_time_diff_ms(&end_time,&request_time);
+      _stream->latency=OP_MAX(_stream->latency,1);
       if(_info!=NULL)_info->is_ssl=OP_URL_IS_SSL(&_stream->url);
       /*The URL has been successfully opened.*/
       return 0;
@@ -2727,6 +3722,48 @@ static int op_http_stream_open(OpusHTTPStream *_stream,const char *_url,
   return OP_FALSE;
 }
 
+/*Estimate the bandwidth-delay product of the path to the server, in bytes.
+  This is how much data arrives in the time it takes to get a response to a
+   new request, and so the least a request should ask for to avoid leaving the
+   connection idle.
+  _conn: The connection to take the throughput estimate from, or NULL to use
+          the last one we had.*/
+static opus_int64 op_http_stream_bdp(OpusHTTPStream *_stream,
+ const OpusHTTPConn *_conn){
+  opus_int64 read_rate;
+  opus_int32 latency;
+  read_rate=_conn!=NULL?_conn->read_rate:0;
+  if(read_rate>0)_stream->read_rate=read_rate;
+  else read_rate=_stream->read_rate;
+  latency=_stream->latency>0?_stream->latency:_stream->connect_rate;
+  return read_rate*latency/1000;
+}
+
+/*Pick the size of the first request after a seek.
+  There's a good chance we'll seek again soon, so we don't want to commit to
+   much more than one bandwidth-delay product.
+  Return: The chunk size to use, or -1 if we aren't pipelining.*/
+static opus_int32 op_http_stream_seek_chunk_size(OpusHTTPStream *_stream,
+ const OpusHTTPConn *_conn){
+  opus_int64 bdp;
+  if(!_stream->pipeline)return -1;
+  bdp=OP_MIN(op_http_stream_bdp(_stream,_conn),OP_PIPELINE_CHUNK_SIZE_MAX);
+  return (opus_int32)OP_MAX(bdp,OP_PIPELINE_CHUNK_SIZE);
+}
+
+/*Pick the size of the next request while reading linearly.
+  This at least doubles each time, and asks for several bandwidth-delay
+   products at once if the path can carry that much.
+  Return: The chunk size to use, or -1 to ask for the rest of the resource.*/
+static opus_int32 op_http_stream_next_chunk_size(OpusHTTPStream *_stream,
+ const OpusHTTPConn *_conn,opus_int32 _chunk_size){
+  opus_int64 next_size;
+  next_size=OP_MAX(2*(opus_int64)_chunk_size,
+   OP_PIPELINE_BDP_MULT*op_http_stream_bdp(_stream,_conn));
+  /*But after a while, just request the rest of the resource.*/
+  return next_size>OP_PIPELINE_CHUNK_SIZE_MAX?-1:(opus_int32)next_size;
+}
+
 static int op_http_conn_send_request(OpusHTTPStream *_stream,
  OpusHTTPConn *_conn,opus_int64 _pos,opus_int32 _chunk_size,
  int _try_not_to_block){
@@ -2745,9 +3782,7 @@ static int op_http_conn_send_request(OpusHTTPStream *_stream,
     next_end=_pos+_chunk_size;
     ret|=op_sb_append_nonnegative_int64(&_stream->request,next_end-1);
     /*Use a larger chunk size for our next request.*/
-    _chunk_size<<=1;
-    /*But after a while, just request the rest of the resource.*/
-    if(_chunk_size>OP_PIPELINE_CHUNK_SIZE_MAX)_chunk_size=-1;
+    _chunk_size=op_http_stream_next_chunk_size(_stream,_conn,_chunk_size);
   }
   else{
     /*Either this was a non-pipelined request or we were close enough to the
@@ -2779,6 +3814,8 @@ static int op_http_conn_send_request(OpusHTTPStream *_stream,
   /*Save the chunk size to use for the next request.*/
   _conn->chunk_size=_chunk_size;
   _conn->nrequests_left--;
+  _stream->nrequests++;
+  _stream->last_request_size=next_end<0?-1:next_end-_pos;
   return ret;
 }
 
@@ -2873,6 +3910,11 @@ static int op_http_conn_handle_response(OpusHTTPStream *_stream,
          any more requests.*/
       if(OP_UNLIKELY(ret>0))_conn->nrequests_left=0;
     }
+    else if(strcmp(header,"transfer-encoding")==0){
+      /*Chunked bodies are only supported when reading until EOF, which range
+         requests never do.*/
+      if(OP_UNLIKELY(op_http_parse_transfer_encoding(cdr)!=0))return OP_FALSE;
+    }
   }
   /*No Content-Range header.*/
   if(OP_UNLIKELY(range_length<0))return OP_FALSE;
@@ -2884,6 +3926,42 @@ static int op_http_conn_handle_response(OpusHTTPStream *_stream,
   return 0;
 }
 
+/*Read the response to the request for the end of the resource into memory.
+  Return: 0 on success, or a negative value on error, in which case we give up
+           on the tail and go back to reading it from the network.*/
+static int op_http_stream_tail_load(OpusHTTPStream *_stream){
+  OpusHTTPConn  *conn;
+  unsigned char *tail_buf;
+  opus_int64     tail_end;
+  int            tail_size;
+  int            nbuf;
+  int            ret;
+  conn=_stream->tail_conn;
+  OP_ASSERT(conn!=NULL);
+  tail_end=conn->next_end;
+  tail_size=(int)(tail_end-_stream->tail_start);
+  nbuf=0;
+  tail_buf=(unsigned char *)_ogg_malloc(tail_size);
+  if(OP_LIKELY(tail_buf!=NULL)){
+    ret=op_http_conn_handle_response(_stream,conn);
+    if(OP_LIKELY(ret==0)&&OP_LIKELY(_stream->content_length==tail_end)){
+      while(nbuf<tail_size){
+        ret=op_http_conn_read(conn,(char *)tail_buf+nbuf,tail_size-nbuf,1);
+        if(OP_UNLIKELY(ret<=0))break;
+        nbuf+=ret;
+      }
+    }
+  }
+  op_http_stream_tail_close(_stream);
+  if(OP_UNLIKELY(nbuf<tail_size)){
+    _ogg_free(tail_buf);
+    _stream->tail_start=-1;
+    return OP_FALSE;
+  }
+  _stream->tail_buf=tail_buf;
+  return 0;
+}
+
 /*Open a new connection that will start reading at byte offset _pos.
   _pos:        The byte offset to start reading from.
   _chunk_size: The number of bytes to ask for in the initial request, or -1 to
@@ -2893,16 +3971,29 @@ static int op_http_conn_handle_response(OpusHTTPStream *_stream,
 static int op_http_conn_open_pos(OpusHTTPStream *_stream,
  OpusHTTPConn *_conn,opus_int64 _pos,opus_int32 _chunk_size){
   op_time       start_time;
+  op_time       request_time;
   op_time       end_time;
   opus_int32    connect_rate;
   opus_int32    connect_time;
+  opus_int32    latency;
   int           ret;
-  ret=op_http_connect(_stream,_conn,&_stream->addr_info,&start_time);
-  if(OP_UNLIKELY(ret<0))return ret;
-  ret=op_http_conn_send_request(_stream,_conn,_pos,_chunk_size,0);
-  if(OP_UNLIKELY(ret<0))return ret;
-  ret=op_http_conn_handle_response(_stream,_conn);
-  if(OP_UNLIKELY(ret!=0))return OP_FALSE;
+  for(;;){
+    int pooled;
+    ret=op_http_connect(_stream,_conn,&_stream->addr_info,&start_time);
+    if(OP_UNLIKELY(ret<0))return ret;
+    pooled=ret;
+    op_time_get(&request_time);
+    ret=op_http_conn_send_request(_stream,_conn,_pos,_chunk_size,0);
+    if(OP_LIKELY(ret>=0)){
+      ret=op_http_conn_handle_response(_stream,_conn);
+      if(OP_LIKELY(ret==0))break;
+      ret=OP_FALSE;
+    }
+    if(!pooled)return ret;
+    /*As in op_http_stream_open(), a connection from the pool may have gone
+       stale, so try again.*/
+    op_http_conn_close(_stream,_conn,&_stream->lru_head,0);
+  }
   op_time_get(&end_time);
   _stream->cur_conni=(int)(_conn-_stream->conns);
   OP_ASSERT(_stream->cur_conni>=0&&_stream->cur_conni<OP_NCONNS_MAX);
@@ -2912,38 +4003,180 @@ static int op_http_conn_open_pos(OpusHTTPStream *_stream,
   connect_rate=_stream->connect_rate;
   connect_rate+=OP_MAX(connect_time,1)-connect_rate+8>>4;
   _stream->connect_rate=connect_rate;
+  /*The request itself gives us a latency sample without the time spent
+     connecting.
+    This adapts faster than the connection time, since we size requests with
+     it.*/
+  latency=OP_MAX(op_time_diff_ms(&end_time,&request_time),1);
+  if(_stream->latency>0){
+    latency=_stream->latency+(latency-_stream->latency+2>>2);
+  }
+  _stream->latency=latency;
   return 0;
 }
 
-/*Read data from the current response body.
-  If we're pipelining and we get close to the end of this response, queue
-   another request.
-  If we've reached the end of this response body, parse the next response and
-   keep going.
-  [out] _buf: Returns the data read.
-  _buf_size:  The size of the buffer.
-  Return: A positive number of bytes read on success.
-          0:        The connection was closed.
-          OP_EREAD: There was a fatal read error.*/
-static int op_http_conn_read_body(OpusHTTPStream *_stream,
- OpusHTTPConn *_conn,unsigned char *_buf,int _buf_size){
+/*If we're pipelining and we get close to the end of the current response body,
+   queue a request for the next chunk.
+  Return: 0 on success, or a negative value on error.*/
+static int op_http_conn_request_next(OpusHTTPStream *_stream,
+ OpusHTTPConn *_conn){
   opus_int64 pos;
   opus_int64 end_pos;
-  opus_int64 next_pos;
-  opus_int64 content_length;
-  int        nread;
-  int        pipeline;
-  int        ret;
-  /*Currently this function can only be called on the LRU head.
-    Otherwise, we'd need a _pnext pointer if we needed to close the connection,
-     and re-opening it would re-organize the lists.*/
-  OP_ASSERT(_stream->lru_head==_conn);
-  /*We should have filtered out empty reads by this point.*/
-  OP_ASSERT(_buf_size>0);
   pos=_conn->pos;
   end_pos=_conn->end_pos;
-  next_pos=_conn->next_pos;
-  pipeline=_stream->pipeline;
+  /*TODO: If nrequests_left<=0, we can't make a new request, and there will be
+     a big pause after we hit the end of the chunk while we open a new
+     connection.
+    It would be nice to be able to start that process now, but we have no way
+     to do it in the background without blocking (even if we could start it, we
+     have no guarantee the application will return control to us in a
+     sufficiently timely manner to allow us to complete it, and this is
+     uncommon enough that it's not worth using threads just for this).*/
+  if(end_pos>=0&&end_pos<_stream->content_length&&_conn->next_pos<0
+   &&_stream->pipeline&&OP_LIKELY(_conn->nrequests_left>0)){
+    opus_int64 request_thresh;
+    opus_int32 chunk_size;
+    /*Are we getting close to the end of the current response body?
+      If so, we should request more data.*/
+    request_thresh=_stream->connect_rate*_conn->read_rate>>12;
+    /*Leave at least one bandwidth-delay product, so the next response can
+       start arriving before this one runs out.*/
+    request_thresh=OP_MAX(request_thresh,op_http_stream_bdp(_stream,_conn));
+    /*But don't commit ourselves too quickly.*/
+    chunk_size=_conn->chunk_size;
+    if(chunk_size>=0)request_thresh=OP_MIN(chunk_size>>2,request_thresh);
+    if(end_pos-pos<request_thresh){
+      int ret;
+      ret=op_http_conn_send_request(_stream,_conn,end_pos,_conn->chunk_size,1);
+      if(OP_UNLIKELY(ret<0))return ret;
+    }
+  }
+  return 0;
+}
+
+/*Reads a single line, without its line ending, into a buffer.
+  This is used for the framing of chunked response bodies.
+  Return: 0 on success, or a negative value on error.*/
+static int op_http_conn_read_line(OpusHTTPConn *_conn,OpusStringBuf *_sb){
+  int ret;
+  _sb->nbuf=0;
+  ret=op_sb_ensure_capacity(_sb,OP_RESPONSE_SIZE_MIN);
+  if(OP_UNLIKELY(ret<0))return ret;
+  for(;;){
+    char *buf;
+    char *eol;
+    int   size;
+    int   capacity;
+    int   read_limit;
+    size=_sb->nbuf;
+    capacity=_sb->cbuf-1;
+    if(OP_UNLIKELY(size>=capacity)){
+      ret=op_sb_grow(_sb,OP_RESPONSE_SIZE_MAX);
+      if(OP_UNLIKELY(ret<0))return ret;
+      capacity=_sb->cbuf-1;
+      /*The line was too long.*/
+      if(OP_UNLIKELY(size>=capacity))return OP_EIMPL;
+    }
+    buf=_sb->buf;
+    ret=op_http_conn_peek(_conn,buf+size,capacity-size);
+    if(OP_UNLIKELY(ret<=0))return OP_EREAD;
+    /*Only consume the data up to the end of the line.*/
+    eol=(char *)memchr(buf+size,'\n',ret);
+    read_limit=eol!=NULL?(int)(eol-buf)+1:size+ret;
+    ret=op_http_conn_read(_conn,buf+size,read_limit-size,1);
+    if(OP_UNLIKELY(ret<=0))return OP_EREAD;
+    size+=ret;
+    if(eol!=NULL&&size>=read_limit){
+      /*Strip the "\r\n" (or just "\n", for broken servers).*/
+      size--;
+      if(size>0&&buf[size-1]=='\r')size--;
+      buf[size]='\0';
+      _sb->nbuf=size;
+      return 0;
+    }
+    _sb->nbuf=size;
+  }
+}
+
+/*Reads the header of the next chunk of a chunked response body (along with
+   the line ending after the previous chunk's data) and sets chunk_left.
+  If this was the last chunk, this also skips over the trailer.
+  This destroys the contents of _stream->response.buf.
+  Return: 0 on success, or a negative value on error.*/
+static int op_http_conn_read_chunk_header(OpusHTTPStream *_stream,
+ OpusHTTPConn *_conn){
+  OpusStringBuf *line;
+  const char    *next;
+  opus_int64     chunk_size;
+  int            ret;
+  line=&_stream->response;
+  ret=op_http_conn_read_line(_conn,line);
+  /*Every chunk but the first is preceded by the line ending of the last
+     one's data.*/
+  if(OP_LIKELY(ret>=0)&&line->nbuf<=0)ret=op_http_conn_read_line(_conn,line);
+  if(OP_UNLIKELY(ret<0))return ret;
+  next=line->buf;
+  chunk_size=0;
+  do{
+    int c;
+    int digit;
+    c=*next;
+    if(c>='0'&&c<='9')digit=c-'0';
+    else if(c>='a'&&c<='f')digit=c-'a'+10;
+    else if(c>='A'&&c<='F')digit=c-'A'+10;
+    else return OP_FALSE;
+    /*Check for overflow.*/
+    if(OP_UNLIKELY(chunk_size>OP_INT64_MAX>>4))return OP_EIMPL;
+    chunk_size=chunk_size<<4|digit;
+    next++;
+  }
+  while(isxdigit((unsigned char)*next));
+  /*We ignore any chunk extensions.*/
+  next+=op_http_lwsspn(next);
+  if(OP_UNLIKELY(*next!='\0'&&*next!=';'))return OP_FALSE;
+  if(chunk_size<=0){
+    /*That was the last chunk.
+      Skip the trailer, which ends with an empty line.*/
+    do{
+      ret=op_http_conn_read_line(_conn,line);
+      if(OP_UNLIKELY(ret<0))return ret;
+    }
+    while(line->nbuf>0);
+    chunk_size=-2;
+  }
+  _conn->chunk_left=chunk_size;
+  return 0;
+}
+
+/*Read data from the current response body.
+  If we're pipelining and we get close to the end of this response, queue
+   another request.
+  If we've reached the end of this response body, parse the next response and
+   keep going.
+  [out] _buf: Returns the data read.
+  _buf_size:  The size of the buffer.
+  Return: A positive number of bytes read on success.
+          0:        The connection was closed.
+          OP_EREAD: There was a fatal read error.*/
+static int op_http_conn_read_body(OpusHTTPStream *_stream,
+ OpusHTTPConn *_conn,unsigned char *_buf,int _buf_size){
+  opus_int64 pos;
+  opus_int64 end_pos;
+  opus_int64 next_pos;
+  opus_int64 content_length;
+  int        nread;
+  int        pipeline;
+  int        ret;
+  /*Currently this function can only be called on the LRU head.
+    Otherwise, we'd need a _pnext pointer if we needed to close the connection,
+     and re-opening it would re-organize the lists.*/
+  OP_ASSERT(_stream->lru_head==_conn);
+  /*We should have filtered out empty reads by this point.*/
+  OP_ASSERT(_buf_size>0);
+  pos=_conn->pos;
+  end_pos=_conn->end_pos;
+  next_pos=_conn->next_pos;
+  pipeline=_stream->pipeline;
   content_length=_stream->content_length;
   if(end_pos>=0){
     /*Have we reached the end of the current response body?*/
@@ -3010,40 +4243,97 @@ static int op_http_conn_read_body(OpusHTTPStream *_stream,
     OP_ASSERT(end_pos>pos);
     _buf_size=(int)OP_MIN(_buf_size,end_pos-pos);
   }
-  nread=op_http_conn_read(_conn,(char *)_buf,_buf_size,1);
+  if(_conn->chunk_left!=-1){
+    OP_ASSERT(end_pos<0);
+    if(_conn->chunk_left==0){
+      ret=op_http_conn_read_chunk_header(_stream,_conn);
+      if(OP_UNLIKELY(ret<0))return OP_EREAD;
+    }
+    /*We've read the last chunk.*/
+    if(_conn->chunk_left<0)return 0;
+    /*Read the chunk's data straight into the caller's buffer.*/
+    _buf_size=(int)OP_MIN(_buf_size,_conn->chunk_left);
+    nread=op_http_conn_read(_conn,(char *)_buf,_buf_size,1);
+    /*The connection closed in the middle of a chunk.*/
+    if(OP_UNLIKELY(nread<=0))return OP_EREAD;
+    _conn->chunk_left-=nread;
+  }
+  else nread=op_http_conn_read(_conn,(char *)_buf,_buf_size,1);
   if(OP_UNLIKELY(nread<0))return nread;
   pos+=nread;
   _conn->pos=pos;
   OP_ASSERT(end_pos<0||content_length>=0);
-  /*TODO: If nrequests_left<=0, we can't make a new request, and there will be
-     a big pause after we hit the end of the chunk while we open a new
-     connection.
-    It would be nice to be able to start that process now, but we have no way
-     to do it in the background without blocking (even if we could start it, we
-     have no guarantee the application will return control to us in a
-     sufficiently timely manner to allow us to complete it, and this is
-     uncommon enough that it's not worth using threads just for this).*/
-  if(end_pos>=0&&end_pos<content_length&&next_pos<0
-   &&pipeline&&OP_LIKELY(_conn->nrequests_left>0)){
-    opus_int64 request_thresh;
-    opus_int32 chunk_size;
-    /*Are we getting close to the end of the current response body?
-      If so, we should request more data.*/
-    request_thresh=_stream->connect_rate*_conn->read_rate>>12;
-    /*But don't commit ourselves too quickly.*/
-    chunk_size=_conn->chunk_size;
-    if(chunk_size>=0)request_thresh=OP_MIN(chunk_size>>2,request_thresh);
-    if(end_pos-pos<request_thresh){
-      ret=op_http_conn_send_request(_stream,_conn,end_pos,_conn->chunk_size,1);
-      if(OP_UNLIKELY(ret<0))return OP_EREAD;
-    }
+  ret=op_http_conn_request_next(_stream,_conn);
+  if(OP_UNLIKELY(ret<0))return OP_EREAD;
+  return nread;
+}
+
+/*Move whatever data has already arrived on the current connection into the
+   prefetch buffer, without blocking.
+  This never reads past the end of the current response body, since parsing
+   the next response might block.
+  Errors are not reported here: they will be seen again by the next blocking
+   read.*/
+static void op_http_stream_prefetch(OpusHTTPStream *_stream){
+  OpusHTTPConn *conn;
+  int           cbuf;
+  int           ci;
+  cbuf=_stream->prefetch_cbuf;
+  ci=_stream->cur_conni;
+  if(cbuf<=0||ci<0)return;
+  conn=_stream->conns+ci;
+  /*Reading a chunked body might block on the framing.*/
+  if(conn->chunk_left!=-1)return;
+  OP_ASSERT(_stream->lru_head==conn);
+  while(_stream->prefetch_nbuf<cbuf){
+    opus_int64 end_pos;
+    int        available;
+    int        widx;
+    int        nread;
+    end_pos=conn->end_pos;
+    if(end_pos>=0&&conn->pos>=end_pos)break;
+    available=op_http_conn_estimate_available(conn);
+    if(available<=0)break;
+    widx=_stream->prefetch_start+_stream->prefetch_nbuf;
+    if(widx>=cbuf)widx-=cbuf;
+    /*Only fill the contiguous space after widx; the loop will wrap around.*/
+    available=OP_MIN(available,OP_MIN(cbuf-widx,cbuf-_stream->prefetch_nbuf));
+    if(end_pos>=0)available=(int)OP_MIN(available,end_pos-conn->pos);
+    nread=op_http_conn_read(conn,(char *)_stream->prefetch_buf+widx,
+     available,0);
+    if(nread<=0)break;
+    conn->pos+=nread;
+    _stream->prefetch_nbuf+=nread;
+    if(OP_UNLIKELY(op_http_conn_request_next(_stream,conn)<0))break;
   }
+}
+
+/*Copy data out of the prefetch buffer.
+  Return: The number of bytes copied.*/
+static int op_http_stream_prefetch_copy(OpusHTTPStream *_stream,
+ unsigned char *_ptr,int _buf_size){
+  int cbuf;
+  int start;
+  int ncopy;
+  int nread;
+  cbuf=_stream->prefetch_cbuf;
+  start=_stream->prefetch_start;
+  nread=OP_MIN(_buf_size,_stream->prefetch_nbuf);
+  ncopy=OP_MIN(nread,cbuf-start);
+  memcpy(_ptr,_stream->prefetch_buf+start,ncopy);
+  memcpy(_ptr+ncopy,_stream->prefetch_buf,nread-ncopy);
+  start+=nread;
+  if(start>=cbuf)start-=cbuf;
+  _stream->prefetch_start=start;
+  _stream->prefetch_nbuf-=nread;
   return nread;
 }
 
-static int op_http_stream_read(void *_stream,
+/*Read from the current connection (or the prefetch buffer).*/
+static int op_http_stream_read_conn(void *_stream,
  unsigned char *_ptr,int _buf_size){
   OpusHTTPStream *stream;
+  OpusHTTPConn   *conn;
   int             nread;
   opus_int64      size;
   opus_int64      pos;
@@ -3051,6 +4341,12 @@ static int op_http_stream_read(void *_stream,
   stream=(OpusHTTPStream *)_stream;
   /*Check for an empty read.*/
   if(_buf_size<=0)return 0;
+  /*Serve the read from data we already have, if we can.*/
+  if(stream->prefetch_nbuf>0){
+    nread=op_http_stream_prefetch_copy(stream,_ptr,_buf_size);
+    op_http_stream_prefetch(stream);
+    return nread;
+  }
   ci=stream->cur_conni;
   /*No current connection => EOF.*/
   if(ci<0)return 0;
@@ -3062,14 +4358,24 @@ static int op_http_stream_read(void *_stream,
     /*Check for a short read.*/
     if(_buf_size>size-pos)_buf_size=(int)(size-pos);
   }
-  nread=op_http_conn_read_body(stream,stream->conns+ci,_ptr,_buf_size);
+  conn=stream->conns+ci;
+  /*In non-blocking mode, don't wait for data from a response we've already
+     asked for.
+    If we still have to send the next request, that blocks like before.*/
+  if(stream->nonblocking
+   &&(conn->end_pos<0||conn->pos<conn->end_pos||conn->next_pos>=0)
+   &&!op_http_conn_readable(conn)){
+    return OP_EAGAIN;
+  }
+  nread=op_http_conn_read_body(stream,conn,_ptr,_buf_size);
   if(OP_UNLIKELY(nread<=0)){
     /*We hit an error or EOF.
       Either way, we're done with this connection.*/
-    op_http_conn_close(stream,stream->conns+ci,&stream->lru_head,1);
+    op_http_conn_close(stream,conn,&stream->lru_head,1);
     stream->cur_conni=-1;
     stream->pos=pos;
   }
+  else op_http_stream_prefetch(stream);
   return nread;
 }
 
@@ -3102,7 +4408,7 @@ static int op_http_conn_read_ahead(OpusHTTPStream *_stream,
     OP_ASSERT(_stream->pipeline);
     _conn->next_pos=-1;
     ret=op_http_conn_send_request(_stream,_conn,_target,
-     OP_PIPELINE_CHUNK_SIZE,0);
+     op_http_stream_seek_chunk_size(_stream,_conn),0);
     if(OP_UNLIKELY(ret<0))return ret;
   }
   /*We can reach the target position by reading forward in the current chunk.*/
@@ -3162,6 +4468,7 @@ static int op_http_stream_seek(void *_stream,opus_int64 _offset,int _whence){
   OpusHTTPConn    *close_conn;
   OpusHTTPConn   **close_pnext;
   opus_int64       content_length;
+  opus_int64       conn_pos;
   opus_int64       pos;
   int              pipeline;
   int              ci;
@@ -3172,7 +4479,13 @@ static int op_http_stream_seek(void *_stream,opus_int64 _offset,int _whence){
   /*If we're seekable, we should have gotten a Content-Length.*/
   OP_ASSERT(content_length>=0);
   ci=stream->cur_conni;
-  pos=ci<0?content_length:stream->conns[ci].pos;
+  conn_pos=ci<0?content_length:stream->conns[ci].pos;
+  if(stream->prefetch_nbuf>0){
+    /*The buffered data hasn't been returned yet.*/
+    conn_pos=(ci<0?stream->pos:conn_pos)-stream->prefetch_nbuf;
+  }
+  pos=stream->cache_pos>=0?stream->cache_pos:conn_pos;
+  if(stream->tail_pos>=0)pos=stream->tail_pos;
   switch(_whence){
     case SEEK_SET:{
       /*Check for overflow:*/
@@ -3193,10 +4506,47 @@ static int op_http_stream_seek(void *_stream,opus_int64 _offset,int _whence){
     }break;
     default:return -1;
   }
+  stream->tail_pos=-1;
+  if(stream->tail_start>=0&&stream->tail_start<=pos&&pos<content_length){
+    /*Read the end of the resource from memory, once it has arrived.
+      As with the cache, the connections are left where they are.*/
+    if(stream->tail_buf!=NULL||op_http_stream_tail_load(stream)>=0){
+      stream->tail_pos=pos;
+      return 0;
+    }
+  }
+  if(stream->cache_entry!=NULL){
+    /*If we have the target in the cache, read it from there.
+      The connections are left where they are, for when we run out.*/
+    if(op_http_cache_entry_find(stream->cache_entry,pos)>pos){
+      stream->cache_pos=pos;
+      return 0;
+    }
+    stream->cache_pos=-1;
+  }
+  if(stream->prefetch_nbuf>0){
+    /*If the target is inside the prefetch buffer, just skip to it.*/
+    if(pos>=conn_pos&&pos-conn_pos<stream->prefetch_nbuf){
+      int nskip;
+      nskip=(int)(pos-conn_pos);
+      stream->prefetch_start+=nskip;
+      if(stream->prefetch_start>=stream->prefetch_cbuf){
+        stream->prefetch_start-=stream->prefetch_cbuf;
+      }
+      stream->prefetch_nbuf-=nskip;
+      return 0;
+    }
+    /*Otherwise, throw it away.*/
+    stream->prefetch_start=stream->prefetch_nbuf=0;
+  }
   /*Mark when we deactivated the active connection.*/
   if(ci>=0){
     op_http_conn_read_rate_update(stream->conns+ci);
     *&seek_time=*&stream->conns[ci].read_time;
+    /*Remember its throughput for sizing the request we make next.*/
+    if(stream->conns[ci].read_rate>0){
+      stream->read_rate=stream->conns[ci].read_rate;
+    }
   }
   else op_time_get(&seek_time);
   /*If we seeked past the end of the stream, just disable the active
@@ -3334,7 +4684,7 @@ static int op_http_stream_seek(void *_stream,opus_int64 _offset,int _whence){
      connection if we later seek elsewhere and start reading from a different
      connection.*/
   ret=op_http_conn_open_pos(stream,conn,pos,
-   pipeline?OP_PIPELINE_CHUNK_SIZE:-1);
+   op_http_stream_seek_chunk_size(stream,NULL));
   if(OP_UNLIKELY(ret<0)){
     op_http_conn_close(stream,conn,&stream->lru_head,1);
     return -1;
@@ -3346,14 +4696,249 @@ static opus_int64 op_http_stream_tell(void *_stream){
   OpusHTTPStream *stream;
   int             ci;
   stream=(OpusHTTPStream *)_stream;
+  if(stream->tail_pos>=0)return stream->tail_pos;
+  if(stream->cache_pos>=0)return stream->cache_pos;
+  ci=stream->cur_conni;
+  return (ci<0?stream->pos:stream->conns[ci].pos)-stream->prefetch_nbuf;
+}
+
+/*Start fetching data at a position we expect to seek to soon.
+  If no connection is already positioned to reach it cheaply, we take a free
+   connection (we never close one for this), connect it, and send a request for
+   a chunk at that position without waiting for the response.
+  That leaves the connection in the same state as one that has finished its
+   current chunk and has the next one pipelined, so op_http_stream_seek() will
+   pick it up without any special handling, and the request's round trip
+   overlaps whatever we do in the meantime.*/
+static int op_http_stream_hint(void *_stream,opus_int64 _offset,int _whence){
+  op_time          start_time;
+  OpusHTTPStream  *stream;
+  OpusHTTPConn    *conn;
+  opus_int64       content_length;
+  opus_int64       cur_pos;
+  opus_int64       pos;
+  int              ci;
+  int              ret;
+  stream=(OpusHTTPStream *)_stream;
+  if(!stream->seekable)return -1;
+  content_length=stream->content_length;
+  OP_ASSERT(content_length>=0);
+  cur_pos=op_http_stream_tell(stream);
+  switch(_whence){
+    case SEEK_SET:pos=_offset;break;
+    case SEEK_CUR:{
+      if(_offset>OP_INT64_MAX-cur_pos)return -1;
+      pos=cur_pos+_offset;
+    }break;
+    case SEEK_END:{
+      if(_offset>OP_INT64_MAX-content_length)return -1;
+      pos=content_length+_offset;
+    }break;
+    default:return -1;
+  }
+  /*Hints before the start of the stream are clamped, as the caller is usually
+     backing up a fixed distance from some other position.*/
+  pos=OP_MAX(pos,0);
+  if(pos>=content_length)return -1;
+  if(stream->tail_start>=0&&pos>=stream->tail_start)return 0;
+  if(stream->cache_entry!=NULL
+   &&op_http_cache_entry_find(stream->cache_entry,pos)>pos){
+    return 0;
+  }
+  /*Can we already get there without a new request?*/
   ci=stream->cur_conni;
-  return ci<0?stream->pos:stream->conns[ci].pos;
+  if(ci>=0&&cur_pos<=pos&&pos<=stream->conns[ci].pos)return 0;
+  for(conn=stream->lru_head;conn!=NULL;conn=conn->next){
+    opus_int64 end_pos;
+    end_pos=conn->next_pos>=0?conn->next_end:conn->end_pos;
+    if(conn->pos<=pos&&pos-conn->pos<=OP_READAHEAD_THRESH_MIN
+     &&(end_pos<0||pos<end_pos)){
+      return 0;
+    }
+  }
+  conn=stream->free_head;
+  if(conn==NULL)return -1;
+  ret=op_http_connect(stream,conn,&stream->addr_info,&start_time);
+  if(OP_LIKELY(ret>=0)){
+    ret=op_http_conn_send_request(stream,conn,pos,
+     op_http_stream_seek_chunk_size(stream,NULL),0);
+  }
+  if(OP_UNLIKELY(ret<0)){
+    if(stream->lru_head==conn){
+      op_http_conn_close(stream,conn,&stream->lru_head,0);
+    }
+    return -1;
+  }
+  conn->pos=conn->end_pos=pos;
+  /*The connection is now at the head of the LRU list, but the current
+     connection must stay there.*/
+  if(ci>=0){
+    OpusHTTPConn *cur_conn;
+    OP_ASSERT(stream->lru_head==conn);
+    cur_conn=stream->conns+ci;
+    stream->lru_head=conn->next;
+    conn->next=cur_conn->next;
+    cur_conn->next=conn;
+  }
+  return 0;
+}
+
+/*Start caching this stream, if it has a cache and the server gave us a way to
+   tell whether the data we have stored is still current.
+  _url: The URL the stream was opened with, which is used as the key.*/
+static void op_http_stream_cache_open(OpusHTTPStream *_stream,
+ const char *_url){
+  OpusHTTPCache       *cache;
+  OpusHTTPCacheEntry **pnext;
+  OpusHTTPCacheEntry  *entry;
+  OpusStringBuf        path;
+  int                  fresh;
+  cache=_stream->cache;
+  if(cache==NULL||!_stream->seekable||_stream->validator==NULL)return;
+  for(pnext=&cache->head;(entry=*pnext)!=NULL;pnext=&entry->next){
+    if(strcmp(entry->url,_url)==0)break;
+  }
+  fresh=0;
+  if(entry!=NULL){
+    /*Move it to the front of the list.*/
+    *pnext=entry->next;
+    entry->next=cache->head;
+    cache->head=entry;
+    if(strcmp(entry->validator,_stream->validator)!=0
+     ||entry->content_length!=_stream->content_length){
+      char *validator;
+      /*The resource has changed.
+        If another stream is still reading the old version, leave it be.*/
+      if(entry->nrefs>0)return;
+      validator=op_string_dup(_stream->validator);
+      if(OP_UNLIKELY(validator==NULL))return;
+      _ogg_free(entry->validator);
+      entry->validator=validator;
+      entry->content_length=_stream->content_length;
+      fresh=1;
+    }
+  }
+  else{
+    entry=(OpusHTTPCacheEntry *)_ogg_malloc(sizeof(*entry));
+    if(OP_UNLIKELY(entry==NULL))return;
+    entry->url=op_string_dup(_url);
+    entry->validator=op_string_dup(_stream->validator);
+    entry->ranges=NULL;
+    entry->content_length=_stream->content_length;
+    entry->size=0;
+    entry->nranges=entry->cranges=0;
+    entry->nrefs=0;
+    entry->id=cache->next_id++;
+    if(OP_UNLIKELY(entry->url==NULL)||OP_UNLIKELY(entry->validator==NULL)){
+      op_http_cache_entry_free(entry);
+      return;
+    }
+    entry->next=cache->head;
+    cache->head=entry;
+  }
+  cache->dirty=1;
+  op_sb_init(&path);
+  if(OP_LIKELY(op_http_cache_path(&path,cache,NULL,entry->id)>=0)){
+    if(!fresh)_stream->cache_fp=op_fopen(&_stream->cache_cb,path.buf,"r+b");
+    if(_stream->cache_fp==NULL){
+      /*Start over with an empty data file.*/
+      cache->size-=entry->size;
+      entry->size=0;
+      entry->nranges=0;
+      _stream->cache_fp=op_fopen(&_stream->cache_cb,path.buf,"w+b");
+    }
+  }
+  op_sb_clear(&path);
+  if(OP_UNLIKELY(_stream->cache_fp==NULL))return;
+  entry->nrefs++;
+  _stream->cache_entry=entry;
+}
+
+/*Store data we just read from the network in the cache.
+  If there's no room, or anything goes wrong, the data just doesn't get
+   stored.*/
+static void op_http_stream_cache_write(OpusHTTPStream *_stream,
+ opus_int64 _pos,const unsigned char *_buf,int _nbytes){
+  OpusHTTPCache      *cache;
+  OpusHTTPCacheEntry *entry;
+  opus_int64          nadded;
+  cache=_stream->cache;
+  entry=_stream->cache_entry;
+  /*Only make room for the bytes we don't already have, and skip the write
+     entirely if there aren't any.*/
+  nadded=op_http_cache_entry_count_new(entry,_pos,_pos+_nbytes);
+  if(nadded<=0||!op_http_cache_make_room(cache,nadded))return;
+  if(OP_UNLIKELY((*_stream->cache_cb.seek)(_stream->cache_fp,_pos,SEEK_SET)<0)
+   ||OP_UNLIKELY(fwrite(_buf,1,_nbytes,(FILE *)_stream->cache_fp)
+   !=(size_t)_nbytes)){
+    op_http_stream_cache_close(_stream);
+    return;
+  }
+  nadded=op_http_cache_entry_add(entry,_pos,_pos+_nbytes);
+  if(OP_UNLIKELY(nadded<0))return;
+  entry->size+=nadded;
+  cache->size+=nadded;
+  cache->dirty=1;
+}
+
+static int op_http_stream_read(void *_stream,
+ unsigned char *_ptr,int _buf_size){
+  OpusHTTPStream *stream;
+  opus_int64      pos;
+  opus_int64      end;
+  int             nread;
+  stream=(OpusHTTPStream *)_stream;
+  pos=stream->tail_pos;
+  if(pos>=0){
+    OP_ASSERT(pos>=stream->tail_start);
+    nread=(int)OP_MIN(OP_MAX(_buf_size,0),stream->content_length-pos);
+    memcpy(_ptr,stream->tail_buf+(pos-stream->tail_start),nread);
+    stream->tail_pos=pos+nread;
+    if(nread>0&&stream->cache_entry!=NULL){
+      op_http_stream_cache_write(stream,pos,_ptr,nread);
+    }
+    return nread;
+  }
+  if(stream->cache_entry==NULL&&stream->cache_pos<0){
+    return op_http_stream_read_conn(stream,_ptr,_buf_size);
+  }
+  /*Check for an empty read.*/
+  if(_buf_size<=0)return 0;
+  pos=op_http_stream_tell(stream);
+  if(stream->cache_entry!=NULL){
+    end=op_http_cache_entry_find(stream->cache_entry,pos);
+    if(end>pos){
+      nread=(int)OP_MIN(_buf_size,end-pos);
+      if(OP_LIKELY((*stream->cache_cb.seek)(stream->cache_fp,pos,SEEK_SET)>=0)
+       &&(*stream->cache_cb.read)(stream->cache_fp,_ptr,nread)==nread){
+        stream->cache_pos=pos+nread;
+        return nread;
+      }
+      /*Something is wrong with the data file, so stop using it.*/
+      op_http_stream_cache_close(stream);
+    }
+  }
+  if(stream->cache_pos>=0){
+    /*We ran out of cached data, so go back to the network.*/
+    stream->cache_pos=-1;
+    if(OP_UNLIKELY(op_http_stream_seek(stream,pos,SEEK_SET)<0))return OP_EREAD;
+  }
+  nread=op_http_stream_read_conn(stream,_ptr,_buf_size);
+  if(nread>0&&stream->cache_entry!=NULL){
+    op_http_stream_cache_write(stream,pos,_ptr,nread);
+  }
+  return nread;
 }
 
 static int op_http_stream_close(void *_stream){
   OpusHTTPStream *stream;
   stream=(OpusHTTPStream *)_stream;
   if(OP_LIKELY(stream!=NULL)){
+    if(stream->pool!=NULL){
+      while(stream->lru_head!=NULL){
+        op_http_conn_pool_put(stream,stream->lru_head,&stream->lru_head);
+      }
+    }
     op_http_stream_clear(stream);
     _ogg_free(stream);
   }
@@ -3366,6 +4951,131 @@ static const OpusFileCallbacks OP_HTTP_CALLBACKS={
   op_http_stream_tell,
   op_http_stream_close
 };
+
+/*Parse a string written by op_http_cache_append_string().
+  Return: A copy of the string, or NULL if it was invalid.*/
+static char *op_http_cache_parse_string(const char **_next){
+  const char *next;
+  opus_int64  len;
+  opus_int64  i;
+  next=*_next;
+  if(*next++!=' ')return NULL;
+  len=op_http_parse_nonnegative_int64(&next,next);
+  if(len<0||*next++!=':')return NULL;
+  /*Make sure it doesn't run off the end of the index.*/
+  for(i=0;i<len;i++)if(next[i]=='\0')return NULL;
+  *_next=next+len;
+  return op_string_range_dup(next,next+len);
+}
+
+/*Parse one line of a cache index written by op_http_cache_save().
+  Return: The new entry, or NULL if the line was invalid.*/
+static OpusHTTPCacheEntry *op_http_cache_parse_entry(const char **_next){
+  OpusHTTPCacheEntry *entry;
+  const char         *next;
+  opus_int64          id;
+  opus_int64          nranges;
+  opus_int64          last;
+  int                 ri;
+  entry=(OpusHTTPCacheEntry *)_ogg_malloc(sizeof(*entry));
+  if(OP_UNLIKELY(entry==NULL))return NULL;
+  entry->url=entry->validator=NULL;
+  entry->ranges=NULL;
+  entry->size=0;
+  entry->nranges=entry->cranges=0;
+  entry->nrefs=0;
+  next=*_next;
+  id=op_http_parse_nonnegative_int64(&next,next);
+  if(id<0||id>(opus_int64)0xFFFFFFFFU||*next++!=' ')goto fail;
+  entry->id=(opus_uint32)id;
+  entry->content_length=op_http_parse_nonnegative_int64(&next,next);
+  if(entry->content_length<0||*next++!=' ')goto fail;
+  nranges=op_http_parse_nonnegative_int64(&next,next);
+  /*Each range takes at least 4 characters, which bounds the allocation by the
+     size of the index.*/
+  if(nranges<0||nranges>(opus_int64)(strlen(next)>>2))goto fail;
+  if(nranges>0){
+    entry->ranges=(opus_int64 *)_ogg_malloc(
+     sizeof(*entry->ranges)*2*(size_t)nranges);
+    if(OP_UNLIKELY(entry->ranges==NULL))goto fail;
+  }
+  entry->nranges=entry->cranges=(int)nranges;
+  /*The ranges must be non-empty, sorted, disjoint, and inside the resource.*/
+  last=-1;
+  for(ri=0;ri<2*nranges;ri++){
+    opus_int64 val;
+    if(*next++!=' ')goto fail;
+    val=op_http_parse_nonnegative_int64(&next,next);
+    if(val<=last||val>entry->content_length)goto fail;
+    entry->ranges[ri]=last=val;
+    if(ri&1)entry->size+=val-entry->ranges[ri-1];
+  }
+  entry->url=op_http_cache_parse_string(&next);
+  if(entry->url==NULL)goto fail;
+  entry->validator=op_http_cache_parse_string(&next);
+  if(entry->validator==NULL||*next++!='\n')goto fail;
+  *_next=next;
+  return entry;
+fail:
+  op_http_cache_entry_free(entry);
+  return NULL;
+}
+
+/*Load the index of a cache directory.
+  If it is missing or damaged, we keep whatever entries we could read, and
+   start over from there.*/
+static void op_http_cache_load(OpusHTTPCache *_cache){
+  OpusFileCallbacks   cb;
+  OpusStringBuf       path;
+  OpusStringBuf       index;
+  void               *fp;
+  int                 ret;
+  op_sb_init(&path);
+  op_sb_init(&index);
+  fp=NULL;
+  if(OP_LIKELY(op_http_cache_path(&path,_cache,OP_CACHE_INDEX_NAME,0)>=0)){
+    fp=op_fopen(&cb,path.buf,"rb");
+  }
+  op_sb_clear(&path);
+  if(fp==NULL)return;
+  /*Read the whole thing into memory.*/
+  for(;;){
+    int nread;
+    if(OP_UNLIKELY(index.nbuf>INT_MAX-4096)){
+      ret=OP_EFAULT;
+      break;
+    }
+    ret=op_sb_ensure_capacity(&index,index.nbuf+4096);
+    if(OP_UNLIKELY(ret<0))break;
+    nread=(*cb.read)(fp,(unsigned char *)index.buf+index.nbuf,
+     index.cbuf-1-index.nbuf);
+    if(nread<=0)break;
+    index.nbuf+=nread;
+  }
+  (*cb.close)(fp);
+  if(OP_LIKELY(ret>=0)&&index.nbuf>0){
+    const char *next;
+    index.buf[index.nbuf]='\0';
+    next=index.buf;
+    if(strncmp(next,OP_CACHE_INDEX_MAGIC,
+     sizeof(OP_CACHE_INDEX_MAGIC)-1)==0){
+      OpusHTTPCacheEntry **ptail;
+      next+=sizeof(OP_CACHE_INDEX_MAGIC)-1;
+      ptail=&_cache->head;
+      while(*next!='\0'){
+        OpusHTTPCacheEntry *entry;
+        entry=op_http_cache_parse_entry(&next);
+        if(entry==NULL)break;
+        entry->next=NULL;
+        *ptail=entry;
+        ptail=&entry->next;
+        _cache->size+=entry->size;
+        if(entry->id>=_cache->next_id)_cache->next_id=entry->id+1;
+      }
+    }
+  }
+  op_sb_clear(&index);
+}
 #endif
 
 void opus_server_info_init(OpusServerInfo *_info){
@@ -3389,12 +5099,131 @@ void opus_server_info_clear(OpusServerInfo *_info){
   _ogg_free(_info->name);
 }
 
+OpusHTTPConnPool *op_http_conn_pool_create(int _max_idle){
+#if defined(OP_ENABLE_HTTP)
+  OpusHTTPConnPool *pool;
+  if(OP_UNLIKELY(_max_idle<=0))return NULL;
+  pool=(OpusHTTPConnPool *)_ogg_malloc(sizeof(*pool));
+  if(OP_UNLIKELY(pool==NULL))return NULL;
+  pool->idle_head=NULL;
+  pool->resolved_head=NULL;
+  pool->session_head=NULL;
+  pool->ssl_ctx[0]=pool->ssl_ctx[1]=NULL;
+  pool->nidle=0;
+  pool->max_idle=_max_idle;
+  pool->nresolved=0;
+  pool->nsessions=0;
+  return pool;
+#else
+  (void)_max_idle;
+  return NULL;
+#endif
+}
+
+void op_http_conn_pool_free(OpusHTTPConnPool *_pool){
+#if defined(OP_ENABLE_HTTP)
+  if(_pool!=NULL){
+    while(_pool->idle_head!=NULL){
+      OpusHTTPIdleConn *idle;
+      idle=_pool->idle_head;
+      _pool->idle_head=idle->next;
+      op_http_idle_conn_free(idle);
+    }
+    while(_pool->resolved_head!=NULL){
+      OpusHTTPResolved *resolved;
+      resolved=_pool->resolved_head;
+      _pool->resolved_head=resolved->next;
+      op_http_resolved_free(resolved);
+    }
+    while(_pool->session_head!=NULL){
+      OpusHTTPSession *session;
+      session=_pool->session_head;
+      _pool->session_head=session->next;
+      op_http_session_free(session);
+    }
+    if(_pool->ssl_ctx[0]!=NULL)SSL_CTX_free(_pool->ssl_ctx[0]);
+    if(_pool->ssl_ctx[1]!=NULL)SSL_CTX_free(_pool->ssl_ctx[1]);
+    _ogg_free(_pool);
+  }
+#else
+  (void)_pool;
+#endif
+}
+
+int op_url_prefetch_host(OpusHTTPConnPool *_pool,
+ const char *_host,opus_int32 _port){
+#if defined(OP_ENABLE_HTTP)
+  op_time resolve_time;
+  if(OP_UNLIKELY(_port<0)||OP_UNLIKELY(_port>(opus_int32)65535)){
+    return OP_EINVAL;
+  }
+# if defined(_WIN32)
+  op_init_winsock();
+# endif
+  return op_http_conn_pool_resolve(_pool,_host,(unsigned)_port,
+   &resolve_time)!=NULL?0:OP_FALSE;
+#else
+  (void)_pool;
+  (void)_host;
+  (void)_port;
+  return OP_EIMPL;
+#endif
+}
+
+OpusHTTPCache *op_http_cache_create(const char *_dir,opus_int64 _max_size){
+#if defined(OP_ENABLE_HTTP)
+  OpusHTTPCache *cache;
+  if(OP_UNLIKELY(_max_size<=0))return NULL;
+  cache=(OpusHTTPCache *)_ogg_malloc(sizeof(*cache));
+  if(OP_UNLIKELY(cache==NULL))return NULL;
+  cache->dir=op_string_dup(_dir);
+  if(OP_UNLIKELY(cache->dir==NULL)){
+    _ogg_free(cache);
+    return NULL;
+  }
+  cache->head=NULL;
+  cache->max_size=_max_size;
+  cache->size=0;
+  cache->next_id=0;
+  cache->dirty=0;
+  op_http_cache_load(cache);
+  /*The limit might be lower than it was when the index was written.*/
+  op_http_cache_make_room(cache,0);
+  return cache;
+#else
+  (void)_dir;
+  (void)_max_size;
+  return NULL;
+#endif
+}
+
+void op_http_cache_free(OpusHTTPCache *_cache){
+#if defined(OP_ENABLE_HTTP)
+  if(_cache!=NULL){
+    op_http_cache_save(_cache);
+    while(_cache->head!=NULL){
+      OpusHTTPCacheEntry *entry;
+      entry=_cache->head;
+      OP_ASSERT(entry->nrefs<=0);
+      _cache->head=entry->next;
+      op_http_cache_entry_free(entry);
+    }
+    _ogg_free(_cache->dir);
+    _ogg_free(_cache);
+  }
+#else
+  (void)_cache;
+#endif
+}
+
 /*The actual URL stream creation function.
   This one isn't extensible like the application-level interface, but because
    it isn't public, we're free to change it in the future.*/
 static void *op_url_stream_create_impl(OpusFileCallbacks *_cb,const char *_url,
  int _skip_certificate_check,const char *_proxy_host,unsigned _proxy_port,
- const char *_proxy_user,const char *_proxy_pass,OpusServerInfo *_info){
+ const char *_proxy_user,const char *_proxy_pass,OpusHTTPConnPool *_pool,
+ opus_int32 _prefetch_size,OpusHTTPCache *_cache,int _fetch_tail,
+ OpusServerInfo *_info){
   const char *path;
   /*Check to see if this is a valid file: URL.*/
   path=op_parse_file_url(_url);
@@ -3415,13 +5244,27 @@ static void *op_url_stream_create_impl(OpusFileCallbacks *_cb,const char *_url,
     stream=(OpusHTTPStream *)_ogg_malloc(sizeof(*stream));
     if(OP_UNLIKELY(stream==NULL))return NULL;
     op_http_stream_init(stream);
+    stream->pool=_pool;
+    stream->cache=_cache;
     ret=op_http_stream_open(stream,_url,_skip_certificate_check,
-     _proxy_host,_proxy_port,_proxy_user,_proxy_pass,_info);
+     _proxy_host,_proxy_port,_proxy_user,_proxy_pass,_fetch_tail,_info);
+    if(OP_LIKELY(ret>=0)&&_prefetch_size>0){
+      stream->prefetch_buf=(unsigned char *)_ogg_malloc(_prefetch_size);
+      if(OP_UNLIKELY(stream->prefetch_buf==NULL))ret=OP_EFAULT;
+      else stream->prefetch_cbuf=_prefetch_size;
+    }
     if(OP_UNLIKELY(ret<0)){
       op_http_stream_clear(stream);
       _ogg_free(stream);
       return NULL;
     }
+    op_http_stream_cache_open(stream,_url);
+    /*Once the headers are parsed, op_open_seekable2() will start looking for
+       the last page one chunk from the end.
+      Start fetching that now, so the request's round trip overlaps reading
+       the headers.
+      This does nothing if we already asked for the tail above.*/
+    op_http_stream_hint(stream,-OP_HTTP_TAIL_SIZE,SEEK_END);
     *_cb=*&OP_HTTP_CALLBACKS;
     return stream;
   }
@@ -3431,6 +5274,10 @@ static void *op_url_stream_create_impl(OpusFileCallbacks *_cb,const char *_url,
   (void)_proxy_port;
   (void)_proxy_user;
   (void)_proxy_pass;
+  (void)_pool;
+  (void)_prefetch_size;
+  (void)_cache;
+  (void)_fetch_tail;
   (void)_info;
   return NULL;
 #endif
@@ -3452,17 +5299,25 @@ static void *op_url_stream_create_impl(OpusFileCallbacks *_cb,const char *_url,
    succeeds, or for clearing *_info if it ultimately fails.*/
 static void *op_url_stream_vcreate_impl(OpusFileCallbacks *_cb,
  const char *_url,OpusServerInfo *_info,OpusServerInfo **_pinfo,va_list _ap){
-  int             skip_certificate_check;
-  const char     *proxy_host;
-  opus_int32      proxy_port;
-  const char     *proxy_user;
-  const char     *proxy_pass;
-  OpusServerInfo *pinfo;
+  int               skip_certificate_check;
+  const char       *proxy_host;
+  opus_int32        proxy_port;
+  const char       *proxy_user;
+  const char       *proxy_pass;
+  OpusHTTPConnPool *pool;
+  opus_int32        prefetch_size;
+  OpusHTTPCache    *cache;
+  int               fetch_tail;
+  OpusServerInfo   *pinfo;
   skip_certificate_check=0;
   proxy_host=NULL;
   proxy_port=8080;
   proxy_user=NULL;
   proxy_pass=NULL;
+  pool=NULL;
+  prefetch_size=0;
+  cache=NULL;
+  fetch_tail=0;
   pinfo=NULL;
   *_pinfo=NULL;
   for(;;){
@@ -3490,6 +5345,19 @@ static void *op_url_stream_vcreate_impl(OpusFileCallbacks *_cb,
       case OP_GET_SERVER_INFO_REQUEST:{
         pinfo=va_arg(_ap,OpusServerInfo *);
       }break;
+      case OP_HTTP_CONN_POOL_REQUEST:{
+        pool=va_arg(_ap,OpusHTTPConnPool *);
+      }break;
+      case OP_HTTP_PREFETCH_SIZE_REQUEST:{
+        prefetch_size=va_arg(_ap,opus_int32);
+        if(prefetch_size<0)return NULL;
+      }break;
+      case OP_HTTP_CACHE_REQUEST:{
+        cache=va_arg(_ap,OpusHTTPCache *);
+      }break;
+      case OP_HTTP_FETCH_TAIL_REQUEST:{
+        fetch_tail=!!va_arg(_ap,opus_int32);
+      }break;
       /*Some unknown option.*/
       default:return NULL;
     }
@@ -3500,13 +5368,15 @@ static void *op_url_stream_vcreate_impl(OpusFileCallbacks *_cb,
     void *ret;
     opus_server_info_init(_info);
     ret=op_url_stream_create_impl(_cb,_url,skip_certificate_check,
-     proxy_host,proxy_port,proxy_user,proxy_pass,_info);
+     proxy_host,proxy_port,proxy_user,proxy_pass,pool,prefetch_size,cache,
+     fetch_tail,_info);
     if(ret!=NULL)*_pinfo=pinfo;
     else opus_server_info_clear(_info);
     return ret;
   }
   return op_url_stream_create_impl(_cb,_url,skip_certificate_check,
-   proxy_host,proxy_port,proxy_user,proxy_pass,NULL);
+   proxy_host,proxy_port,proxy_user,proxy_pass,pool,prefetch_size,cache,
+   fetch_tail,NULL);
 }
 
 void *op_url_stream_vcreate(OpusFileCallbacks *_cb,
@@ -3529,6 +5399,78 @@ void *op_url_stream_create(OpusFileCallbacks *_cb,
   return ret;
 }
 
+int op_url_stream_set_nonblocking(void *_stream,const OpusFileCallbacks *_cb,
+ int _nonblocking){
+#if defined(OP_ENABLE_HTTP)
+  if(_cb->read!=op_http_stream_read)return OP_EIMPL;
+  ((OpusHTTPStream *)_stream)->nonblocking=!!_nonblocking;
+  return 0;
+#else
+  (void)_stream;
+  (void)_cb;
+  (void)_nonblocking;
+  return OP_EIMPL;
+#endif
+}
+
+int op_url_stream_get_stats(void *_stream,const OpusFileCallbacks *_cb,
+ OpusHTTPStats *_stats){
+#if defined(OP_ENABLE_HTTP)
+  OpusHTTPStream *stream;
+  opus_int64      read_rate;
+  opus_int32      latency;
+  int             ci;
+  if(_cb->read!=op_http_stream_read)return OP_EIMPL;
+  stream=(OpusHTTPStream *)_stream;
+  ci=stream->cur_conni;
+  /*Use the same estimates as op_http_stream_bdp(), but without saving the
+     current connection's throughput, so that querying the statistics never
+     changes how later requests are sized.*/
+  read_rate=ci<0?0:stream->conns[ci].read_rate;
+  if(read_rate<=0)read_rate=stream->read_rate;
+  latency=stream->latency>0?stream->latency:stream->connect_rate;
+  _stats->connect_ms=stream->connect_rate;
+  _stats->latency_ms=stream->latency;
+  _stats->bdp=read_rate*latency/1000;
+  _stats->read_rate=read_rate;
+  _stats->requests=stream->nrequests;
+  _stats->last_request_size=stream->last_request_size;
+  _stats->next_request_size=ci<0||!stream->pipeline?-1:
+   stream->conns[ci].chunk_size;
+  return 0;
+#else
+  (void)_stream;
+  (void)_cb;
+  (void)_stats;
+  return OP_EIMPL;
+#endif
+}
+
+int op_url_stream_get_poll_fd(void *_stream,const OpusFileCallbacks *_cb,
+ int *_fd,int *_events){
+#if defined(OP_ENABLE_HTTP)
+  OpusHTTPStream *stream;
+  int             ci;
+  if(_cb->read!=op_http_stream_read)return OP_EIMPL;
+  stream=(OpusHTTPStream *)_stream;
+  ci=stream->cur_conni;
+  /*Reads served from memory or the cache never wait.*/
+  if(ci<0||stream->prefetch_nbuf>0||stream->cache_pos>=0
+   ||stream->tail_pos>=0){
+    return OP_FALSE;
+  }
+  *_fd=(int)stream->conns[ci].fd;
+  *_events=POLLIN;
+  return 0;
+#else
+  (void)_stream;
+  (void)_cb;
+  (void)_fd;
+  (void)_events;
+  return OP_EIMPL;
+#endif
+}
+
 /*Convenience routines to open/test URLs in a single step.*/
 
 OggOpusFile *op_vopen_url(const char *_url,int *_error,va_list _ap){
@@ -31,7 +31,12 @@
 # include <stdlib.h>
 # include <opusfile.h>
 
-typedef struct OggOpusLink OggOpusLink;
+typedef struct OggOpusLink       OggOpusLink;
+typedef struct OpusSeekPoint     OpusSeekPoint;
+typedef struct OpusPooledDecoder OpusPooledDecoder;
+typedef struct OpusDecoderSnapshot OpusDecoderSnapshot;
+typedef struct OpusSeekRecord    OpusSeekRecord;
+typedef struct OpusLinkScan      OpusLinkScan;
 
 # if defined(OP_FIXED_POINT)
 
@@ -108,6 +113,16 @@ void op_fatal_impl(const char *_str,const char *_file,int _line);
 #define OP_ADV_OFFSET(_offset,_amount) \
  (OP_MIN(_offset,OP_INT64_MAX-(_amount))+(_amount))
 
+/*Statistics counters.
+  When these are compiled out, the amount is still evaluated for its value
+   (but it must never have side effects), so that variables used only to
+   compute it do not trigger warnings.*/
+# if defined(OP_ENABLE_STATS)
+#  define OP_STATS_ADD(_of,_field,_n) ((void)((_of)->stats._field+=(_n)))
+# else
+#  define OP_STATS_ADD(_of,_field,_n) ((void)(_n))
+# endif
+
 /*The maximum channel count for any mapping we'll actually decode.*/
 # define OP_NCHANNELS_MAX (8)
 
@@ -152,11 +167,137 @@ struct OggOpusLink{
   OpusTags     tags;
 };
 
+/*A page with a known location and timestamp.
+  These are collected while reading and seeking, and used to narrow the range
+   of later seeks.*/
+struct OpusSeekPoint{
+  /*The byte offset of the start of the page.*/
+  opus_int64   page_offset;
+  /*The byte offset of the end of the page.*/
+  opus_int64   end_offset;
+  /*The granule position of the page.*/
+  ogg_int64_t  gp;
+  /*The index of the link containing the page.*/
+  int          li;
+  /*Whether or not the last packet on this page continues on the next one.*/
+  int          continued;
+};
+
+/*A copy of the decoder state at a page boundary, taken while decoding straight
+   through a seekable stream.
+  Restoring it lets a later seek resume decoding right after that page, with
+   no pre-roll, and produce exactly the same output as the original decode.*/
+struct OpusDecoderSnapshot{
+  /*A copy of the OpusMSDecoder.*/
+  unsigned char *state;
+  /*The size of the copy, in bytes.*/
+  opus_int32     state_size;
+  /*The index of the link containing the page.*/
+  int            li;
+  /*The granule position of the page (the last sample decoded).*/
+  ogg_int64_t    gp;
+  /*The byte offset of the start of the page.*/
+  opus_int64     page_offset;
+  /*The byte offset of the end of the page.*/
+  opus_int64     end_offset;
+  /*Whether or not the last packet on this page continues on the next one.*/
+  int            continued;
+  /*When this snapshot was last taken or restored, for eviction.*/
+  opus_uint32    stamp;
+#if !defined(OP_FIXED_POINT)
+  /*The soft clipping and dithering state, so that op_read() output also
+     matches.*/
+# if defined(OP_SOFT_CLIP)
+  float          clip_state[OP_NCHANNELS_MAX];
+# endif
+  float          dither_a[4*OP_NCHANNELS_MAX];
+  float          dither_b[4*OP_NCHANNELS_MAX];
+  opus_uint32    dither_seed;
+  int            dither_mute;
+  int            state_channel_count;
+#endif
+};
+
+/*We use this to remember the pages we found while enumerating the links of a
+   chained stream.
+  We keep track of the starting and ending offsets, as well as the point we
+   started searching from, so we know where to bisect.
+  We also keep the serial number, so we can tell if the page belonged to the
+   current link or not, as well as the granule position, to aid in estimating
+   the start of the link.*/
+struct OpusSeekRecord{
+  /*The earliest byte we know of such that reading forward from it causes
+     capture to be regained at this page.*/
+  opus_int64   search_start;
+  /*The offset of this page.*/
+  opus_int64   offset;
+  /*The size of this page.*/
+  opus_int32   size;
+  /*The serial number of this page.*/
+  ogg_uint32_t serialno;
+  /*The granule position of this page.*/
+  ogg_int64_t  gp;
+};
+
+/*The state of a link enumeration that stopped early, so that it can pick up
+   where it left off.
+  This is only used for streams opened with op_set_lazy_links() or
+   op_open_chain().*/
+struct OpusLinkScan{
+  /*The seek records found so far, sorted in reverse order.
+    64 should be enough for anybody.
+    Actually, with a bisection search in a 63-bit range down to OP_CHUNK_SIZE
+     granularity, much more than enough.*/
+  OpusSeekRecord sr[64];
+  /*The number of seek records.*/
+  int            nsr;
+  /*The end of the last page we know belongs to a known link.*/
+  opus_int64     searched;
+  /*The offset of the first page of the next link.*/
+  opus_int64     next;
+  /*The total duration of the known links.*/
+  ogg_int64_t    total_duration;
+  /*The next member to open, for a chain built by op_open_chain().*/
+  int            member;
+};
+
+/*An idle decoder kept in an OpusDecoderPool, along with the configuration it
+   was created for.*/
+struct OpusPooledDecoder{
+  OpusMSDecoder *od;
+  int            stream_count;
+  int            coupled_count;
+  int            channel_count;
+  unsigned char  mapping[OP_NCHANNELS_MAX];
+};
+
+struct OpusDecoderPool{
+  /*The idle decoders.*/
+  OpusPooledDecoder  *decoders;
+  /*The number of idle decoders.*/
+  int                 ndecoders;
+  /*The idle decoder scratch buffers.
+    These are all large enough for 120 ms of OP_NCHANNELS_MAX channels, so that
+     they can be used by any stream.*/
+  op_sample         **buffers;
+  /*The number of idle buffers.*/
+  int                 nbuffers;
+  /*The maximum number of idle decoders (and of idle buffers) to keep.*/
+  int                 max_idle;
+};
+
 struct OggOpusFile{
   /*The callbacks used to access the stream.*/
   OpusFileCallbacks  callbacks;
   /*A FILE *, memory buffer, etc.*/
   void              *stream;
+  /*The complete contents of the stream, if it is a memory buffer or a mapped
+     file, or NULL otherwise.
+    When this is available, pages are framed directly from it instead of being
+     copied into the ogg_sync_state.*/
+  const unsigned char *map_data;
+  /*The size of map_data, in bytes.*/
+  opus_int64         map_size;
   /*Whether or not we can seek with this stream.*/
   int                seekable;
   /*The number of links in this chained Ogg Opus file.*/
@@ -165,6 +306,12 @@ struct OggOpusFile{
     If stream isn't seekable (e.g., it's a pipe), only the current link
      appears.*/
   OggOpusLink       *links;
+  /*Whether or not to stop enumerating links after the first one when opening
+     a seekable stream, and find the rest only as they are needed.*/
+  int                lazy_links;
+  /*The state of a link enumeration that has not finished yet, or NULL if we
+     know all of the links.*/
+  OpusLinkScan      *link_scan;
   /*The number of serial numbers from a single link.*/
   int                nserialnos;
   /*The capacity of the list of serial numbers from a single link.*/
@@ -183,6 +330,19 @@ struct OggOpusFile{
   opus_int64         end;
   /*Used to locate pages in the stream.*/
   ogg_sync_state     oy;
+  /*A copy of the pages framed while fetching the headers of a new link in an
+     unseekable stream.
+    If the stream returns OP_EAGAIN partway through, these are pushed back
+     into oy so we can start the link over on the next call.*/
+  unsigned char     *replay_buf;
+  /*The number of bytes in replay_buf, or -1 if we ran out of memory.*/
+  int                nreplay;
+  /*The capacity of replay_buf.*/
+  int                creplay;
+  /*Whether or not op_get_next_page() should copy pages into replay_buf.*/
+  int                replay_rec;
+  /*Set when a read returns OP_EAGAIN.*/
+  int                would_block;
   /*One of OP_NOTOPEN, OP_PARTOPEN, OP_OPENED, OP_STREAMSET, OP_INITSET.*/
   int                ready_state;
   /*The current link being played back.*/
@@ -196,6 +356,62 @@ struct OggOpusFile{
      when we use the current position as one of our bounds, only to later
      discover it was the correct starting point.*/
   opus_int64         prev_page_offset;
+  /*The table of known page locations, sorted by offset.
+    This is only used for seekable sources.*/
+  OpusSeekPoint     *seek_points;
+  /*The number of entries in the seek table.*/
+  int                nseek_points;
+  /*The capacity of the seek table.*/
+  int                cseek_points;
+  /*The minimum spacing between entries in the seek table from the same link,
+     in samples, or 0 if we're not collecting them.*/
+  opus_int32         seek_point_spacing;
+  /*The offset at which op_build_seek_table() will resume scanning.*/
+  opus_int64         seek_table_scan_offset;
+  /*The decoder snapshots taken so far, in no particular order.
+    This is only used for seekable sources.*/
+  OpusDecoderSnapshot *snapshots;
+  /*The number of decoder snapshots.*/
+  int                nsnapshots;
+  /*The capacity of the list of decoder snapshots.*/
+  int                csnapshots;
+  /*The minimum spacing between decoder snapshots from the same link, in
+     samples, or 0 if we're not taking them.*/
+  opus_int32         snapshot_spacing;
+  /*The maximum number of bytes of decoder state to keep.*/
+  opus_int64         snapshot_max_bytes;
+  /*The number of bytes of decoder state currently kept.*/
+  opus_int64         snapshot_bytes;
+  /*A counter used to find the least recently used snapshot.*/
+  opus_uint32        snapshot_stamp;
+  /*Whether or not the last read was made with op_read_reverse() (or
+     op_read_reverse_float()).
+    Reverse reads decode one block at a time in the usual forward order into
+     rev_buf, and then return it from back to front.*/
+  int                rev_active;
+  /*The PCM offset of the end of the audio not yet returned by reverse
+     reads.*/
+  ogg_int64_t        rev_pos;
+  /*The decoded block of audio ending at rev_pos.*/
+  op_sample         *rev_buf;
+  /*The number of samples (per channel) left in rev_buf.*/
+  int                rev_size;
+  /*The capacity of rev_buf, in samples (for all channels).*/
+  int                rev_cbuf;
+  /*The link containing the pages in rev_pages, or -1 if there are none.*/
+  int                rev_li;
+  /*The timestamped pages found while walking backwards through the link,
+     sorted by offset.*/
+  OpusSeekPoint     *rev_pages;
+  /*The number of pages in rev_pages.*/
+  int                nrev_pages;
+  /*The capacity of rev_pages.*/
+  int                crev_pages;
+  /*The range of the stream rev_pages covers.
+    Every timestamped page from the link that lies entirely within this range
+     is in rev_pages.*/
+  opus_int64         rev_scan_begin;
+  opus_int64         rev_scan_end;
   /*The number of bytes read since the last bitrate query, including framing.*/
   opus_int64         bytes_tracked;
   /*The number of samples decoded since the last bitrate query.*/
@@ -213,6 +429,12 @@ struct OggOpusFile{
   int                op_count;
   /*Central working state for the packet-to-PCM decoder.*/
   OpusMSDecoder     *od;
+  /*The pool to borrow the decoder and scratch buffer from, or NULL.*/
+  OpusDecoderPool   *pool;
+  /*Whether od has been set up for the current link.
+    This is done lazily, so that reading packets with op_read_packet() never
+     needs a decoder at all.*/
+  int                od_ready;
   /*The application-provided packet decode callback.*/
   op_decode_cb_func  decode_cb;
   /*The application-provided packet decode callback context.*/
@@ -241,8 +463,11 @@ struct OggOpusFile{
 # if defined(OP_SOFT_CLIP)
   float              clip_state[OP_NCHANNELS_MAX];
 # endif
-  float              dither_a[OP_NCHANNELS_MAX*4];
-  float              dither_b[OP_NCHANNELS_MAX*4];
+  /*The noise shaping filter history.
+    Tap j of channel ci is stored at [j*OP_NCHANNELS_MAX+ci], so that the same
+     tap of adjacent channels can be processed together.*/
+  float              dither_a[4*OP_NCHANNELS_MAX];
+  float              dither_b[4*OP_NCHANNELS_MAX];
   opus_uint32        dither_seed;
   int                dither_mute;
   int                dither_disabled;
@@ -252,8 +477,35 @@ struct OggOpusFile{
      stereo/multistream APIs).*/
   int                state_channel_count;
 #endif
+#if defined(OP_ENABLE_STATS)
+  /*The I/O and decoding counters reported by op_get_stats().*/
+  OpusFileStats      stats;
+#endif
 };
 
 int op_strncasecmp(const char *_a,const char *_b,int _n);
 
+/*Windows doesn't accept UTF-8 paths in the narrow-character file APIs, so
+   these translate them to UTF-16 first, just like op_fopen().*/
+# if defined(_WIN32)
+#  include <stddef.h>
+wchar_t *op_utf8_to_utf16(const char *_src);
+int op_remove(const char *_path);
+int op_rename(const char *_from,const char *_to);
+# else
+#  define op_remove(_path) remove(_path)
+#  define op_rename(_from,_to) rename(_from,_to)
+# endif
+
+const unsigned char *op_mem_stream_get_data(void *_stream,
+ const OpusFileCallbacks *_cb,opus_int64 *_size);
+
+void *op_chain_stream_create(OpusFileCallbacks *_cb,
+ const OpusChainSource *_sources,int _nsources,int _max_open);
+int op_is_chain_stream(const OpusFileCallbacks *_cb);
+void op_chain_stream_own_callbacks(void *_stream);
+int op_chain_stream_nmembers(void *_stream);
+void op_chain_stream_member_range(void *_stream,int _mi,
+ opus_int64 *_offset,opus_int64 *_size);
+
 #endif
@@ -25,6 +25,16 @@
 #include <limits.h>
 #include <string.h>
 #include <math.h>
+#if defined(OP_ENABLE_STATS)&&defined(OP_HAVE_CLOCK_MONOTONIC)
+# include <time.h>
+#endif
+#if !defined(OP_FIXED_POINT)||!defined(OP_DISABLE_FLOAT_API)
+# if defined(OP_HAVE_PTHREAD)
+#  include <pthread.h>
+# elif defined(_WIN32)
+#  include <windows.h>
+# endif
+#endif
 
 #include "opusfile.h"
 
@@ -139,6 +149,33 @@ int op_test(OpusHead *_head,
 
 /*The read/seek functions track absolute position within the stream.*/
 
+#if defined(OP_ENABLE_STATS)&&defined(OP_HAVE_CLOCK_MONOTONIC)
+/*Return the current time in nanoseconds on a monotonic clock.*/
+static opus_int64 op_stats_clock(void){
+  struct timespec ts;
+  if(OP_UNLIKELY(clock_gettime(CLOCK_MONOTONIC,&ts)!=0))return 0;
+  return (opus_int64)ts.tv_sec*1000000000+ts.tv_nsec;
+}
+# define OP_STATS_CLOCK() (op_stats_clock())
+#else
+# define OP_STATS_CLOCK() (0)
+#endif
+
+/*Call the read callback, keeping count of the traffic.*/
+static int op_stream_read(OggOpusFile *_of,unsigned char *_ptr,int _nbytes){
+  int nbytes;
+  nbytes=(*_of->callbacks.read)(_of->stream,_ptr,_nbytes);
+  OP_STATS_ADD(_of,read_calls,1);
+  OP_STATS_ADD(_of,read_bytes,OP_MAX(nbytes,0));
+  return nbytes;
+}
+
+/*Call the seek callback, keeping count of the traffic.*/
+static int op_stream_seek(OggOpusFile *_of,opus_int64 _offset,int _whence){
+  OP_STATS_ADD(_of,seek_calls,1);
+  return (*_of->callbacks.seek)(_of->stream,_offset,_whence);
+}
+
 /*Read a little more data from the file/pipe into the ogg_sync framer.
   _nbytes: The maximum number of bytes to read.
   Return: A positive number of bytes read on success, 0 on end-of-file, or a
@@ -149,7 +186,7 @@ static int op_get_data(OggOpusFile *_of,int _nbytes){
   OP_ASSERT(_nbytes>0);
   buffer=(unsigned char *)ogg_sync_buffer(&_of->oy,_nbytes);
   if(OP_UNLIKELY(buffer==NULL))return OP_EFAULT;
-  nbytes=(int)(*_of->callbacks.read)(_of->stream,buffer,_nbytes);
+  nbytes=op_stream_read(_of,buffer,_nbytes);
   OP_ASSERT(nbytes<=_nbytes);
   if(OP_LIKELY(nbytes>0))ogg_sync_wrote(&_of->oy,nbytes);
   return nbytes;
@@ -159,7 +196,7 @@ static int op_get_data(OggOpusFile *_of,int _nbytes){
 static int op_seek_helper(OggOpusFile *_of,opus_int64 _offset){
   if(_offset==_of->offset)return 0;
   if(_of->callbacks.seek==NULL
-   ||(*_of->callbacks.seek)(_of->stream,_offset,SEEK_SET)){
+   ||op_stream_seek(_of,_offset,SEEK_SET)){
     return OP_EREAD;
   }
   _of->offset=_offset;
@@ -175,6 +212,149 @@ static opus_int64 op_position(const OggOpusFile *_of){
   return _of->offset+_of->oy.fill-_of->oy.returned;
 }
 
+/*Frame the next page directly out of a stream whose contents are all in
+   memory, without copying them through the ogg_sync_state.
+  This follows the same rules as ogg_sync_pageseek(): a page needs a capture
+   pattern, a complete header and body, and a matching CRC, and when any of
+   those are missing we resynchronize at the next 'O'.
+  The arguments and return values are the same as op_get_next_page(), which
+   only calls this when the sync buffer is empty.*/
+static opus_int64 op_get_next_mapped_page(OggOpusFile *_of,ogg_page *_og,
+ opus_int64 _boundary){
+  const unsigned char *data;
+  opus_int64           size;
+  opus_int64           avail;
+  opus_int64           offset;
+  opus_int64           ret;
+  if(!_boundary)return OP_FALSE;
+  data=_of->map_data;
+  size=_of->map_size;
+  /*Never look past the boundary, as the buffered path would not have read
+     those bytes yet.*/
+  avail=_boundary<0?size:OP_MIN(_boundary,size);
+  offset=_of->offset;
+  ret=OP_FALSE;
+  while(offset<avail){
+    const unsigned char *page;
+    unsigned char        header[282];
+    ogg_page             og;
+    opus_int64           left;
+    long                 header_len;
+    long                 body_len;
+    int                  nsegs;
+    int                  si;
+    page=data+offset;
+    left=avail-offset;
+    /*Wait for a complete header, the same as ogg_sync_pageseek().*/
+    if(left<27)break;
+    if(memcmp(page,"OggS",4)==0){
+      nsegs=page[26];
+      header_len=27+nsegs;
+      if(left<header_len)break;
+      body_len=0;
+      for(si=0;si<nsegs;si++)body_len+=page[27+si];
+      if(left<header_len+body_len)break;
+      /*Check the CRC on a copy of the header, so that the mapping itself is
+         never written to.*/
+      memcpy(header,page,header_len);
+      og.header=header;
+      og.header_len=header_len;
+      og.body=(unsigned char *)page+header_len;
+      og.body_len=body_len;
+      ogg_page_checksum_set(&og);
+      if(memcmp(header+22,page+22,4)==0){
+        _og->header=(unsigned char *)page;
+        _og->header_len=header_len;
+        _og->body=(unsigned char *)page+header_len;
+        _og->body_len=body_len;
+        ret=offset;
+        offset+=header_len+body_len;
+        break;
+      }
+    }
+    /*Bad page: skip to the next possible capture pattern.*/
+    page=(const unsigned char *)memchr(page+1,'O',(size_t)(left-1));
+    offset=page!=NULL?page-data:avail;
+  }
+  OP_STATS_ADD(_of,bytes_skipped,(ret>=0?ret:offset)-_of->offset);
+  OP_STATS_ADD(_of,pages_framed,ret>=0);
+  _of->offset=offset;
+  /*Keep the stream position in sync with op_position().*/
+  if(OP_UNLIKELY(op_stream_seek(_of,offset,SEEK_SET))){
+    return OP_EREAD;
+  }
+  if(ret>=0)return ret;
+  /*We ran out of data without finding a page.
+    This only fails cleanly on EOF if we didn't have a known boundary, just
+     like op_get_next_page().*/
+  return _boundary<0||_boundary<=size?OP_FALSE:OP_EBADLINK;
+}
+
+/*Make room for _nbytes more bytes in the replay buffer.
+  Return: 0 on success, or a negative value if we couldn't (in which case we
+   also remember that we can't start over).*/
+static int op_replay_reserve(OggOpusFile *_of,int _nbytes){
+  unsigned char *replay_buf;
+  int            nreplay;
+  int            creplay;
+  nreplay=_of->nreplay;
+  if(OP_UNLIKELY(nreplay<0))return -1;
+  if(OP_LIKELY(_nbytes<=_of->creplay-nreplay))return 0;
+  if(OP_UNLIKELY(_nbytes>(INT_MAX>>1)-nreplay)){
+    _of->nreplay=-1;
+    return -1;
+  }
+  creplay=2*(nreplay+_nbytes);
+  replay_buf=(unsigned char *)_ogg_realloc(_of->replay_buf,creplay);
+  if(OP_UNLIKELY(replay_buf==NULL)){
+    _of->nreplay=-1;
+    return -1;
+  }
+  _of->replay_buf=replay_buf;
+  _of->creplay=creplay;
+  return 0;
+}
+
+/*Save a copy of a page framed while fetching the headers of a new link.
+  If the copy can't be made, we just remember that we can't start over.*/
+static void op_record_page(OggOpusFile *_of,const ogg_page *_og){
+  unsigned char *replay_buf;
+  int            nreplay;
+  int            nbytes;
+  nbytes=(int)(_og->header_len+_og->body_len);
+  if(OP_UNLIKELY(op_replay_reserve(_of,nbytes)<0))return;
+  nreplay=_of->nreplay;
+  replay_buf=_of->replay_buf;
+  memcpy(replay_buf+nreplay,_og->header,_og->header_len);
+  memcpy(replay_buf+nreplay+_og->header_len,_og->body,_og->body_len);
+  _of->nreplay=nreplay+nbytes;
+}
+
+/*Push the pages saved by op_record_page() back in front of the unconsumed
+   data in the ogg_sync_state, so they will be framed again by the next read.
+  We append the unconsumed data to the saved pages and then rebuild the
+   ogg_sync_state from scratch with the public API, which also discards the
+   partial page ogg_sync_pageseek() may have been in the middle of.
+  _offset: The stream offset of the first saved page.
+  Return: 0 on success, or OP_EFAULT if we couldn't save all the pages.*/
+static int op_unread_pages(OggOpusFile *_of,opus_int64 _offset){
+  char *buffer;
+  int   nbuffered;
+  int   nbytes;
+  nbuffered=_of->oy.fill-_of->oy.returned;
+  if(OP_UNLIKELY(op_replay_reserve(_of,nbuffered)<0))return OP_EFAULT;
+  nbytes=_of->nreplay;
+  memcpy(_of->replay_buf+nbytes,_of->oy.data+_of->oy.returned,nbuffered);
+  nbytes+=nbuffered;
+  ogg_sync_reset(&_of->oy);
+  buffer=ogg_sync_buffer(&_of->oy,nbytes);
+  if(OP_UNLIKELY(buffer==NULL))return OP_EFAULT;
+  memcpy(buffer,_of->replay_buf,nbytes);
+  if(OP_UNLIKELY(ogg_sync_wrote(&_of->oy,nbytes)<0))return OP_EFAULT;
+  _of->offset=_offset;
+  return 0;
+}
+
 /*From the head of the stream, get the next page.
   _boundary specifies if the function is allowed to fetch more data from the
    stream (and how much) or only use internally buffered data.
@@ -185,14 +365,22 @@ static opus_int64 op_position(const OggOpusFile *_of){
   Return: n>=0:       Found a page at absolute offset n.
           OP_FALSE:   Hit the _boundary limit.
           OP_EREAD:   An underlying read operation failed.
+          OP_EAGAIN:  A non-blocking stream had no data available yet.
+                      Nothing was consumed, so the call can be retried.
           OP_BADLINK: We hit end-of-file before reaching _boundary.*/
 static opus_int64 op_get_next_page(OggOpusFile *_of,ogg_page *_og,
  opus_int64 _boundary){
+  if(_of->map_data!=NULL&&_of->oy.fill<=_of->oy.returned){
+    return op_get_next_mapped_page(_of,_og,_boundary);
+  }
   while(_boundary<=0||_of->offset<_boundary){
     int more;
     more=ogg_sync_pageseek(&_of->oy,_og);
     /*Skipped (-more) bytes.*/
-    if(OP_UNLIKELY(more<0))_of->offset-=more;
+    if(OP_UNLIKELY(more<0)){
+      _of->offset-=more;
+      OP_STATS_ADD(_of,bytes_skipped,-more);
+    }
     else if(more==0){
       int read_nbytes;
       int ret;
@@ -206,7 +394,15 @@ static opus_int64 op_get_next_page(OggOpusFile *_of,ogg_page *_og,
         read_nbytes=(int)OP_MIN(_boundary-position,OP_READ_SIZE);
       }
       ret=op_get_data(_of,read_nbytes);
-      if(OP_UNLIKELY(ret<0))return OP_EREAD;
+      if(OP_UNLIKELY(ret<0)){
+        /*A non-blocking stream ran dry.
+          Nothing has been consumed, so the caller can try again later.*/
+        if(ret==OP_EAGAIN){
+          _of->would_block=1;
+          return OP_EAGAIN;
+        }
+        return OP_EREAD;
+      }
       if(OP_UNLIKELY(ret==0)){
         /*Only fail cleanly on EOF if we didn't have a known boundary.
           Otherwise, we should have been able to reach that boundary, and this
@@ -222,6 +418,8 @@ static opus_int64 op_get_next_page(OggOpusFile *_of,ogg_page *_og,
       page_offset=_of->offset;
       _of->offset+=more;
       OP_ASSERT(page_offset>=0);
+      OP_STATS_ADD(_of,pages_framed,1);
+      if(_of->replay_rec)op_record_page(_of,_og);
       return page_offset;
     }
   }
@@ -268,29 +466,6 @@ static int op_lookup_page_serialno(const ogg_page *_og,
   return op_lookup_serialno(ogg_page_serialno(_og),_serialnos,_nserialnos);
 }
 
-typedef struct OpusSeekRecord OpusSeekRecord;
-
-/*We use this to remember the pages we found while enumerating the links of a
-   chained stream.
-  We keep track of the starting and ending offsets, as well as the point we
-   started searching from, so we know where to bisect.
-  We also keep the serial number, so we can tell if the page belonged to the
-   current link or not, as well as the granule position, to aid in estimating
-   the start of the link.*/
-struct OpusSeekRecord{
-  /*The earliest byte we know of such that reading forward from it causes
-     capture to be regained at this page.*/
-  opus_int64   search_start;
-  /*The offset of this page.*/
-  opus_int64   offset;
-  /*The size of this page.*/
-  opus_int32   size;
-  /*The serial number of this page.*/
-  ogg_uint32_t serialno;
-  /*The granule position of this page.*/
-  ogg_int64_t  gp;
-};
-
 /*Find the last page beginning before _offset with a valid granule position.
   There is no '_boundary' parameter as it will always have to read more data.
   This is much dirtier than the above, as Ogg doesn't have any backward search
@@ -340,6 +515,7 @@ static int op_get_prev_page_serial(OggOpusFile *_of,OpusSeekRecord *_sr,
     ret=op_seek_helper(_of,begin);
     if(OP_UNLIKELY(ret<0))return ret;
     search_start=begin;
+    OP_STATS_ADD(_of,prev_page_chunks,1);
     while(_of->offset<end){
       opus_int64   llret;
       ogg_uint32_t serialno;
@@ -1101,23 +1277,156 @@ static opus_int64 op_predict_link_start(const OpusSeekRecord *_sr,int _nsr,
   return bisect>=_end_searched?-1:bisect;
 }
 
+/*The default minimum spacing between seek table entries in the same link.
+  This keeps the table to about 23 kB for every two hours of audio read.*/
+#define OP_SEEK_POINT_SPACING_DEFAULT (5*48000)
+
+/*A small helper to determine if an Ogg page contains data that continues onto
+   a subsequent page.*/
+static int op_page_continues(const ogg_page *_og){
+  int nlacing;
+  OP_ASSERT(_og->header_len>=27);
+  nlacing=_og->header[26];
+  OP_ASSERT(_og->header_len>=27+nlacing);
+  /*This also correctly handles the (unlikely) case of nlacing==0, because
+     0!=255.*/
+  return _og->header[27+nlacing-1]==255;
+}
+
+/*Remember the location of a page from link _li in the seek table.
+  This is purely an optimization, so failures are silently ignored.*/
+static void op_seek_points_add(OggOpusFile *_of,int _li,
+ const ogg_page *_og,opus_int64 _page_offset){
+  OpusSeekPoint *seek_points;
+  ogg_int64_t    gp;
+  ogg_int64_t    diff;
+  opus_int32     spacing;
+  int            nseek_points;
+  int            lo;
+  int            hi;
+  spacing=_of->seek_point_spacing;
+  if(spacing<=0)return;
+  /*Pages on which no packets end have no usable timestamp.*/
+  gp=ogg_page_granulepos(_og);
+  if(gp==-1||ogg_page_packets(_og)<=0)return;
+  seek_points=_of->seek_points;
+  nseek_points=_of->nseek_points;
+  /*Find the insertion point.
+    When reading straight through the stream, this is always the end.*/
+  lo=0;
+  hi=nseek_points;
+  if(hi>0&&seek_points[hi-1].page_offset<_page_offset)lo=hi;
+  while(lo<hi){
+    int mid;
+    mid=lo+(hi-lo>>1);
+    if(seek_points[mid].page_offset<_page_offset)lo=mid+1;
+    else hi=mid;
+  }
+  if(lo<nseek_points&&seek_points[lo].page_offset==_page_offset)return;
+  /*Keep the table sparse.*/
+  if(lo>0&&seek_points[lo-1].li==_li
+   &&!op_granpos_diff(&diff,gp,seek_points[lo-1].gp)
+   &&diff>-spacing&&diff<spacing){
+    return;
+  }
+  if(lo<nseek_points&&seek_points[lo].li==_li
+   &&!op_granpos_diff(&diff,seek_points[lo].gp,gp)
+   &&diff>-spacing&&diff<spacing){
+    return;
+  }
+  if(OP_UNLIKELY(nseek_points>=_of->cseek_points)){
+    int cseek_points;
+    cseek_points=_of->cseek_points;
+    if(OP_UNLIKELY(cseek_points>INT_MAX-1>>1))return;
+    cseek_points=2*cseek_points+1;
+    seek_points=(OpusSeekPoint *)_ogg_realloc(seek_points,
+     sizeof(*seek_points)*cseek_points);
+    if(OP_UNLIKELY(seek_points==NULL))return;
+    _of->seek_points=seek_points;
+    _of->cseek_points=cseek_points;
+  }
+  memmove(seek_points+lo+1,seek_points+lo,
+   sizeof(*seek_points)*(nseek_points-lo));
+  seek_points[lo].page_offset=_page_offset;
+  seek_points[lo].end_offset=_page_offset+_og->header_len+_og->body_len;
+  seek_points[lo].gp=gp;
+  seek_points[lo].li=_li;
+  seek_points[lo].continued=op_page_continues(_og);
+  _of->nseek_points=nseek_points+1;
+}
+
+/*Find the known pages in link _li that bracket _target_gp.
+  [out] _lo: The index of the last page with a granule position before
+              _target_gp, or -1 if there is none.
+  [out] _hi: The index of the first page with a granule position at or after
+              _target_gp, or -1 if there is none.*/
+static void op_seek_points_bracket(const OggOpusFile *_of,int _li,
+ ogg_int64_t _target_gp,int *_lo,int *_hi){
+  const OpusSeekPoint *seek_points;
+  int                  first;
+  int                  last;
+  int                  lo;
+  int                  hi;
+  seek_points=_of->seek_points;
+  /*The entries for each link are contiguous, since links do not overlap.*/
+  lo=0;
+  hi=_of->nseek_points;
+  while(lo<hi){
+    int mid;
+    mid=lo+(hi-lo>>1);
+    if(seek_points[mid].li<_li)lo=mid+1;
+    else hi=mid;
+  }
+  first=lo;
+  hi=_of->nseek_points;
+  while(lo<hi){
+    int mid;
+    mid=lo+(hi-lo>>1);
+    if(seek_points[mid].li<=_li)lo=mid+1;
+    else hi=mid;
+  }
+  last=lo;
+  /*Now find the first entry at or after the target.*/
+  lo=first;
+  hi=last;
+  while(lo<hi){
+    int mid;
+    mid=lo+(hi-lo>>1);
+    if(op_granpos_cmp(seek_points[mid].gp,_target_gp)<0)lo=mid+1;
+    else hi=mid;
+  }
+  *_lo=lo>first?lo-1:-1;
+  *_hi=lo<last?lo:-1;
+}
+
 /*Finds each bitstream link, one at a time, using a bisection search.
-  This has to begin by knowing the offset of the first link's initial page.*/
-static int op_bisect_forward_serialno(OggOpusFile *_of,
- opus_int64 _searched,OpusSeekRecord *_sr,int _csr,
- ogg_uint32_t **_serialnos,int *_nserialnos,int *_cserialnos){
-  ogg_page      og;
-  OggOpusLink  *links;
-  int           nlinks;
-  int           clinks;
-  ogg_uint32_t *serialnos;
-  int           nserialnos;
-  ogg_int64_t   total_duration;
-  int           nsr;
-  int           ret;
+  This has to begin by knowing the offset of the first link's initial page.
+  _scan holds the state of the search, so that it can stop early once we know
+   at least _nlinks links, every link that starts at or before byte _offset,
+   and every link that starts at or before sample _pcm_offset, and then pick
+   up where it left off later.
+  Return: 0 if we found all of the links, 1 if we stopped early, or a negative
+           value on error.*/
+static int op_bisect_forward_serialno(OggOpusFile *_of,OpusLinkScan *_scan,
+ int _nlinks,opus_int64 _offset,ogg_int64_t _pcm_offset){
+  ogg_page        og;
+  OpusSeekRecord *sr;
+  OggOpusLink    *links;
+  int             nlinks;
+  int             clinks;
+  ogg_uint32_t   *serialnos;
+  int             nserialnos;
+  ogg_int64_t     total_duration;
+  opus_int64      searched;
+  opus_int64      next;
+  opus_int64      last;
+  int             csr;
+  int             nsr;
+  int             ret;
   links=_of->links;
   nlinks=clinks=_of->nlinks;
-  total_duration=0;
+  sr=_scan->sr;
+  csr=sizeof(_scan->sr)/sizeof(*_scan->sr);
   /*We start with one seek record, for the last page in the file.
     We build up a list of records for places we seek to during link
      enumeration.
@@ -1125,46 +1434,78 @@ static int op_bisect_forward_serialno(OggOpusFile *_of,
     We only care about seek locations that were _not_ in the current link,
      therefore we can add them one at a time to the end of the list as we
      improve the lower bound on the location where the next link starts.*/
-  nsr=1;
+  nsr=_scan->nsr;
+  searched=_scan->searched;
+  total_duration=_scan->total_duration;
+  /*If we stopped early last time, we still have to fetch the headers of the
+     next link, and the page we last read is long gone.*/
+  next=_scan->next;
+  last=-1;
   for(;;){
     opus_int64  end_searched;
     opus_int64  bisect;
-    opus_int64  next;
-    opus_int64  last;
     ogg_int64_t end_offset;
     ogg_int64_t end_gp;
     int         sri;
-    serialnos=*_serialnos;
-    nserialnos=*_nserialnos;
-    if(OP_UNLIKELY(nlinks>=clinks)){
-      if(OP_UNLIKELY(clinks>INT_MAX-1>>1))return OP_EFAULT;
-      clinks=2*clinks+1;
-      OP_ASSERT(nlinks<clinks);
-      links=(OggOpusLink *)_ogg_realloc(links,sizeof(*links)*clinks);
-      if(OP_UNLIKELY(links==NULL))return OP_EFAULT;
-      _of->links=links;
+    if(next>=0){
+      if(OP_UNLIKELY(nlinks>=clinks)){
+        if(OP_UNLIKELY(clinks>INT_MAX-1>>1))return OP_EFAULT;
+        clinks=2*clinks+1;
+        OP_ASSERT(nlinks<clinks);
+        links=(OggOpusLink *)_ogg_realloc(links,sizeof(*links)*clinks);
+        if(OP_UNLIKELY(links==NULL))return OP_EFAULT;
+        _of->links=links;
+      }
+      if(last!=next){
+        /*The last page we read was not the first page the next link.
+          Move the cursor position to the offset of that first page.
+          This only performs an actual seek if the first page of the next link
+           does not start at the end of the last page from the current Opus
+           stream with a valid granule position.*/
+        ret=op_seek_helper(_of,next);
+        if(OP_UNLIKELY(ret<0))return ret;
+      }
+      ret=op_fetch_headers(_of,&links[nlinks].head,&links[nlinks].tags,
+       &_of->serialnos,&_of->nserialnos,&_of->cserialnos,
+       last!=next?NULL:&og);
+      if(OP_UNLIKELY(ret<0))return ret;
+      /*Mark the current link count so it can be cleaned up on error.*/
+      _of->nlinks=nlinks+1;
+      links[nlinks].offset=next;
+      links[nlinks].data_offset=_of->offset;
+      links[nlinks].serialno=_of->os.serialno;
+      links[nlinks].pcm_end=-1;
+      /*This might consume a page from the next link, however the next
+         bisection always starts with a seek.*/
+      ret=op_find_initial_pcm_offset(_of,links+nlinks,NULL);
+      if(OP_UNLIKELY(ret<0))return ret;
+      links[nlinks].pcm_file_offset=total_duration;
+      searched=_of->offset;
+      ++nlinks;
     }
+    serialnos=_of->serialnos;
+    nserialnos=_of->nserialnos;
     /*Invariants:
       We have the headers and serial numbers for the link beginning at 'begin'.
       We have the offset and granule position of the last page in the file
        (potentially not a page we care about).*/
     /*Scan the seek records we already have to save us some bisection.*/
     for(sri=0;sri<nsr;sri++){
-      if(op_lookup_serialno(_sr[sri].serialno,serialnos,nserialnos))break;
+      if(op_lookup_serialno(sr[sri].serialno,serialnos,nserialnos))break;
     }
     /*Is the last page in our current list of serial numbers?*/
     if(sri<=0)break;
     /*Last page wasn't found.
       We have at least one more link.*/
     last=-1;
-    end_searched=_sr[sri-1].search_start;
-    next=_sr[sri-1].offset;
+    end_searched=sr[sri-1].search_start;
+    next=sr[sri-1].offset;
     end_gp=-1;
     if(sri<nsr){
-      _searched=_sr[sri].offset+_sr[sri].size;
-      if(_sr[sri].serialno==links[nlinks-1].serialno){
-        end_gp=_sr[sri].gp;
-        end_offset=_sr[sri].offset;
+      searched=sr[sri].offset+sr[sri].size;
+      if(sr[sri].serialno==links[nlinks-1].serialno){
+        end_gp=sr[sri].gp;
+        end_offset=sr[sri].offset;
       }
     }
     nsr=sri;
@@ -1180,7 +1521,7 @@ static int op_bisect_forward_serialno(OggOpusFile *_of,
       last_offset=links[nlinks-1].offset;
       avg_link_size=last_offset/(nlinks-1);
       upper_limit=end_searched-OP_CHUNK_SIZE-avg_link_size;
-      if(OP_LIKELY(last_offset>_searched-avg_link_size)
+      if(OP_LIKELY(last_offset>searched-avg_link_size)
        &&OP_LIKELY(last_offset<upper_limit)){
         bisect=last_offset+avg_link_size;
         if(OP_LIKELY(bisect<upper_limit))bisect+=avg_link_size;
@@ -1188,18 +1529,18 @@ static int op_bisect_forward_serialno(OggOpusFile *_of,
     }
     /*We guard against garbage separating the last and first pages of two
        links below.*/
-    while(_searched<end_searched){
+    while(searched<end_searched){
       opus_int32 next_bias;
       /*If we don't have a better estimate, use simple bisection.*/
-      if(bisect==-1)bisect=_searched+(end_searched-_searched>>1);
+      if(bisect==-1)bisect=searched+(end_searched-searched>>1);
       /*If we're within OP_CHUNK_SIZE of the start, scan forward.*/
-      if(bisect-_searched<OP_CHUNK_SIZE)bisect=_searched;
+      if(bisect-searched<OP_CHUNK_SIZE)bisect=searched;
       /*Otherwise we're skipping data.
         Forget the end page, if we saw one, as we might miss a later one.*/
       else end_gp=-1;
       ret=op_seek_helper(_of,bisect);
       if(OP_UNLIKELY(ret<0))return ret;
-      last=op_get_next_page(_of,&og,_sr[nsr-1].offset);
+      last=op_get_next_page(_of,&og,sr[nsr-1].offset);
       if(OP_UNLIKELY(last<OP_FALSE))return (int)last;
       next_bias=0;
       if(last==OP_FALSE)end_searched=bisect;
@@ -1212,19 +1553,19 @@ static int op_bisect_forward_serialno(OggOpusFile *_of,
           end_searched=bisect;
           next=last;
           /*In reality we should always have enough room, but be paranoid.*/
-          if(OP_LIKELY(nsr<_csr)){
-            _sr[nsr].search_start=bisect;
-            _sr[nsr].offset=last;
+          if(OP_LIKELY(nsr<csr)){
+            sr[nsr].search_start=bisect;
+            sr[nsr].offset=last;
             OP_ASSERT(_of->offset-last>=0);
             OP_ASSERT(_of->offset-last<=OP_PAGE_SIZE_MAX);
-            _sr[nsr].size=(opus_int32)(_of->offset-last);
-            _sr[nsr].serialno=serialno;
-            _sr[nsr].gp=gp;
+            sr[nsr].size=(opus_int32)(_of->offset-last);
+            sr[nsr].serialno=serialno;
+            sr[nsr].gp=gp;
             nsr++;
           }
         }
         else{
-          _searched=_of->offset;
+          searched=_of->offset;
           next_bias=OP_CHUNK_SIZE;
           if(serialno==links[nlinks-1].serialno){
             /*This page was from the stream we want, remember it.
@@ -1232,10 +1573,11 @@ static int op_bisect_forward_serialno(OggOpusFile *_of,
                looking for it later.*/
             end_gp=gp;
             end_offset=last;
+            op_seek_points_add(_of,nlinks-1,&og,last);
           }
         }
       }
-      bisect=op_predict_link_start(_sr,nsr,_searched,end_searched,next_bias);
+      bisect=op_predict_link_start(sr,nsr,searched,end_searched,next_bias);
     }
     /*Bisection point found.
       Get the final granule position of the previous link, assuming
@@ -1255,31 +1597,15 @@ static int op_bisect_forward_serialno(OggOpusFile *_of,
        &total_duration);
       if(OP_UNLIKELY(ret<0))return ret;
     }
-    if(last!=next){
-      /*The last page we read was not the first page the next link.
-        Move the cursor position to the offset of that first page.
-        This only performs an actual seek if the first page of the next link
-         does not start at the end of the last page from the current Opus
-         stream with a valid granule position.*/
-      ret=op_seek_helper(_of,next);
-      if(OP_UNLIKELY(ret<0))return ret;
+    if(nlinks>=_nlinks&&next>_offset&&total_duration>_pcm_offset){
+      /*We know everything we were asked to find.
+        Save our place so we can come back for the rest.*/
+      _scan->nsr=nsr;
+      _scan->searched=searched;
+      _scan->next=next;
+      _scan->total_duration=total_duration;
+      return 1;
     }
-    ret=op_fetch_headers(_of,&links[nlinks].head,&links[nlinks].tags,
-     _serialnos,_nserialnos,_cserialnos,last!=next?NULL:&og);
-    if(OP_UNLIKELY(ret<0))return ret;
-    /*Mark the current link count so it can be cleaned up on error.*/
-    _of->nlinks=nlinks+1;
-    links[nlinks].offset=next;
-    links[nlinks].data_offset=_of->offset;
-    links[nlinks].serialno=_of->os.serialno;
-    links[nlinks].pcm_end=-1;
-    /*This might consume a page from the next link, however the next bisection
-       always starts with a seek.*/
-    ret=op_find_initial_pcm_offset(_of,links+nlinks,NULL);
-    if(OP_UNLIKELY(ret<0))return ret;
-    links[nlinks].pcm_file_offset=total_duration;
-    _searched=_of->offset;
-    ++nlinks;
   }
   /*Last page is in the starting serialno list, so we've reached the last link.
     Now find the last granule position for it (if we didn't the first time we
@@ -1287,16 +1613,17 @@ static int op_bisect_forward_serialno(OggOpusFile *_of,
      didn't already determine the link was empty).*/
   if(OP_LIKELY(links[nlinks-1].pcm_end==-1)){
     ret=op_find_final_pcm_offset(_of,serialnos,nserialnos,
-     links+nlinks-1,_sr[0].offset,_sr[0].serialno,_sr[0].gp,&total_duration);
+     links+nlinks-1,sr[0].offset,sr[0].serialno,sr[0].gp,&total_duration);
     if(OP_UNLIKELY(ret<0))return ret;
   }
+  _scan->total_duration=total_duration;
   /*Trim back the links array if necessary.*/
   links=(OggOpusLink *)_ogg_realloc(links,sizeof(*links)*nlinks);
   if(OP_LIKELY(links!=NULL))_of->links=links;
   /*We also don't need these anymore.*/
-  _ogg_free(*_serialnos);
-  *_serialnos=NULL;
-  *_cserialnos=*_nserialnos=0;
+  _ogg_free(_of->serialnos);
+  _of->serialnos=NULL;
+  _of->cserialnos=_of->nserialnos=0;
   return 0;
 }
 
@@ -1306,7 +1633,7 @@ static void op_update_gain(OggOpusFile *_of){
   int         li;
   /*If decode isn't ready, then we'll apply the gain when we initialize the
      decoder.*/
-  if(_of->ready_state<OP_INITSET)return;
+  if(_of->ready_state<OP_INITSET||!_of->od_ready)return;
   gain_q8=_of->gain_offset_q8;
   li=_of->seekable?_of->cur_link:0;
   head=&_of->links[li].head;
@@ -1344,14 +1671,57 @@ static void op_update_gain(OggOpusFile *_of){
 #endif
 }
 
-static int op_make_decode_ready(OggOpusFile *_of){
+/*Give up the current decoder, returning it to the pool if there is room.*/
+static void op_release_decoder(OggOpusFile *_of){
+  OpusDecoderPool *pool;
+  if(_of->od==NULL)return;
+  pool=_of->pool;
+  if(pool!=NULL&&pool->ndecoders<pool->max_idle){
+    OpusPooledDecoder *pd;
+    pd=pool->decoders+pool->ndecoders++;
+    pd->od=_of->od;
+    pd->stream_count=_of->od_stream_count;
+    pd->coupled_count=_of->od_coupled_count;
+    pd->channel_count=_of->od_channel_count;
+    memcpy(pd->mapping,_of->od_mapping,
+     sizeof(*pd->mapping)*_of->od_channel_count);
+  }
+  else opus_multistream_decoder_destroy(_of->od);
+  _of->od=NULL;
+}
+
+/*Take an idle decoder for the given configuration out of the pool.
+  Return: The decoder, or NULL if there was no compatible one.*/
+static OpusMSDecoder *op_pool_take_decoder(OpusDecoderPool *_pool,
+ const OpusHead *_head){
+  int di;
+  /*Search from the end, so we prefer the most recently used decoders.*/
+  for(di=_pool->ndecoders;di-->0;){
+    OpusPooledDecoder *pd;
+    pd=_pool->decoders+di;
+    if(pd->stream_count==_head->stream_count
+     &&pd->coupled_count==_head->coupled_count
+     &&pd->channel_count==_head->channel_count
+     &&memcmp(pd->mapping,_head->mapping,
+     sizeof(*_head->mapping)*_head->channel_count)==0){
+      OpusMSDecoder *od;
+      od=pd->od;
+      *pd=*(_pool->decoders+--_pool->ndecoders);
+      return od;
+    }
+  }
+  return NULL;
+}
+
+/*Set up the decoder for the current link, reusing the existing one if it is
+   compatible.*/
+static int op_init_decoder(OggOpusFile *_of){
   const OpusHead *head;
   int             li;
   int             stream_count;
   int             coupled_count;
   int             channel_count;
-  if(_of->ready_state>OP_STREAMSET)return 0;
-  if(OP_UNLIKELY(_of->ready_state<OP_STREAMSET))return OP_EFAULT;
+  OP_ASSERT(_of->ready_state>=OP_INITSET);
   li=_of->seekable?_of->cur_link:0;
   head=&_of->links[li].head;
   stream_count=head->stream_count;
@@ -1363,18 +1733,43 @@ static int op_make_decode_ready(OggOpusFile *_of){
    &&memcmp(_of->od_mapping,head->mapping,
    sizeof(*head->mapping)*channel_count)==0){
     opus_multistream_decoder_ctl(_of->od,OPUS_RESET_STATE);
+    OP_STATS_ADD(_of,decoder_resets,1);
   }
   else{
-    int err;
-    opus_multistream_decoder_destroy(_of->od);
-    _of->od=opus_multistream_decoder_create(48000,channel_count,
-     stream_count,coupled_count,head->mapping,&err);
-    if(_of->od==NULL)return OP_EFAULT;
+    OpusMSDecoder *od;
+    int            err;
+    op_release_decoder(_of);
+    od=NULL;
+    if(_of->pool!=NULL){
+      od=op_pool_take_decoder(_of->pool,head);
+      if(od!=NULL){
+        opus_multistream_decoder_ctl(od,OPUS_RESET_STATE);
+        OP_STATS_ADD(_of,decoder_resets,1);
+      }
+    }
+    if(od==NULL){
+      od=opus_multistream_decoder_create(48000,channel_count,
+       stream_count,coupled_count,head->mapping,&err);
+      if(od==NULL)return OP_EFAULT;
+      OP_STATS_ADD(_of,decoder_creations,1);
+    }
+    _of->od=od;
     _of->od_stream_count=stream_count;
     _of->od_coupled_count=coupled_count;
     _of->od_channel_count=channel_count;
     memcpy(_of->od_mapping,head->mapping,sizeof(*head->mapping)*channel_count);
   }
+  _of->od_ready=1;
+  op_update_gain(_of);
+  return 0;
+}
+
+static int op_make_decode_ready(OggOpusFile *_of){
+  if(_of->ready_state>OP_STREAMSET)return 0;
+  if(OP_UNLIKELY(_of->ready_state<OP_STREAMSET))return OP_EFAULT;
+  /*The decoder itself is set up by op_decode() when the first packet needs
+     it.*/
+  _of->od_ready=0;
   _of->ready_state=OP_INITSET;
   _of->bytes_tracked=0;
   _of->samples_tracked=0;
@@ -1382,47 +1777,605 @@ static int op_make_decode_ready(OggOpusFile *_of){
   _of->state_channel_count=0;
   /*Use the serial number for the PRNG seed to get repeatable output for
      straight play-throughs.*/
-  _of->dither_seed=_of->links[li].serialno;
+  _of->dither_seed=_of->links[_of->seekable?_of->cur_link:0].serialno;
 #endif
-  op_update_gain(_of);
   return 0;
 }
 
-static int op_open_seekable2_impl(OggOpusFile *_of){
-  /*64 seek records should be enough for anybody.
-    Actually, with a bisection search in a 63-bit range down to OP_CHUNK_SIZE
-     granularity, much more than enough.*/
-  OpusSeekRecord sr[64];
-  opus_int64     data_offset;
+/*The persistent link index.
+  This is a flat, little-endian serialization of the links array, together
+   with enough information about the stream to detect when it no longer
+   matches.
+  The layout is
+    "OpusLIdx"                        (8 bytes)
+    stream size                       (8 bytes)
+    end                               (8 bytes)
+    CRC of the first page             (4 bytes)
+    CRC of the last page              (4 bytes)
+    number of links                   (4 bytes)
+   followed by one record per link:
+    offset                            (8 bytes)
+    data_offset                       (8 bytes)
+    end_offset                        (8 bytes)
+    pcm_file_offset                   (8 bytes)
+    pcm_start                         (8 bytes)
+    pcm_end                           (8 bytes)
+    serialno                          (4 bytes)
+    ID header size, then the packet   (4+n bytes)
+    comment header size, then packet  (4+n bytes)
+  The headers are stored in their Ogg Opus packet format, so that they can be
+   re-loaded with opus_head_parse() and opus_tags_parse().*/
+#define OP_LINK_INDEX_HEADER_SIZE (36)
+#define OP_LINK_INDEX_LINK_SIZE   (60)
+
+static unsigned char *op_pack_uint32le(unsigned char *_dst,opus_uint32 _x){
+  _dst[0]=(unsigned char)(_x&0xFF);
+  _dst[1]=(unsigned char)(_x>>8&0xFF);
+  _dst[2]=(unsigned char)(_x>>16&0xFF);
+  _dst[3]=(unsigned char)(_x>>24&0xFF);
+  return _dst+4;
+}
+
+static unsigned char *op_pack_int64le(unsigned char *_dst,opus_int64 _x){
+  _dst=op_pack_uint32le(_dst,(opus_uint32)(_x&0xFFFFFFFF));
+  return op_pack_uint32le(_dst,(opus_uint32)(_x>>32&0xFFFFFFFF));
+}
+
+static opus_uint32 op_unpack_uint32le(const unsigned char *_src){
+  return _src[0]|(opus_uint32)_src[1]<<8|
+   (opus_uint32)_src[2]<<16|(opus_uint32)_src[3]<<24;
+}
+
+static opus_int64 op_unpack_int64le(const unsigned char *_src){
+  opus_uint32 lo;
+  opus_uint32 hi;
+  lo=op_unpack_uint32le(_src);
+  hi=op_unpack_uint32le(_src+4);
+  /*Avoid shifting a negative value.*/
+  return ((opus_int64)(hi^0x80000000)-0x80000000)*((opus_int64)1<<32)+lo;
+}
+
+/*The size of an ID header in packet form.*/
+static int op_head_packed_size(const OpusHead *_head){
+  return _head->mapping_family==0?19:21+_head->channel_count;
+}
+
+/*Convert an ID header back into packet form.*/
+static unsigned char *op_head_pack(unsigned char *_dst,const OpusHead *_head){
+  memcpy(_dst,"OpusHead",8);
+  _dst[8]=(unsigned char)_head->version;
+  _dst[9]=(unsigned char)_head->channel_count;
+  _dst[10]=(unsigned char)(_head->pre_skip&0xFF);
+  _dst[11]=(unsigned char)(_head->pre_skip>>8&0xFF);
+  op_pack_uint32le(_dst+12,_head->input_sample_rate);
+  _dst[16]=(unsigned char)(_head->output_gain&0xFF);
+  _dst[17]=(unsigned char)(_head->output_gain>>8&0xFF);
+  _dst[18]=(unsigned char)_head->mapping_family;
+  if(_head->mapping_family==0)return _dst+19;
+  _dst[19]=(unsigned char)_head->stream_count;
+  _dst[20]=(unsigned char)_head->coupled_count;
+  memcpy(_dst+21,_head->mapping,_head->channel_count);
+  return _dst+21+_head->channel_count;
+}
+
+/*The size of a comment header in packet form, or 0 if it is too large to
+   store.*/
+static size_t op_tags_packed_size(const OpusTags *_tags){
+  size_t size;
+  int    binary_suffix_len;
+  int    ncomments;
+  int    ci;
+  ncomments=_tags->comments;
+  size=16+(_tags->vendor==NULL?0:strlen(_tags->vendor));
+  for(ci=0;ci<ncomments;ci++){
+    size+=4+(size_t)_tags->comment_lengths[ci];
+    if(OP_UNLIKELY(size>(size_t)OP_INT32_MAX))return 0;
+  }
+  opus_tags_get_binary_suffix(_tags,&binary_suffix_len);
+  size+=binary_suffix_len;
+  return OP_LIKELY(size<=(size_t)OP_INT32_MAX)?size:0;
+}
+
+/*Convert a comment header back into packet form.*/
+static unsigned char *op_tags_pack(unsigned char *_dst,const OpusTags *_tags){
+  const unsigned char *binary_suffix;
+  size_t               vendor_len;
+  int                  binary_suffix_len;
+  int                  ncomments;
+  int                  ci;
+  memcpy(_dst,"OpusTags",8);
+  vendor_len=_tags->vendor==NULL?0:strlen(_tags->vendor);
+  _dst=op_pack_uint32le(_dst+8,(opus_uint32)vendor_len);
+  if(vendor_len>0)memcpy(_dst,_tags->vendor,vendor_len);
+  _dst+=vendor_len;
+  ncomments=_tags->comments;
+  _dst=op_pack_uint32le(_dst,(opus_uint32)ncomments);
+  for(ci=0;ci<ncomments;ci++){
+    int len;
+    len=_tags->comment_lengths[ci];
+    _dst=op_pack_uint32le(_dst,(opus_uint32)len);
+    memcpy(_dst,_tags->user_comments[ci],len);
+    _dst+=len;
+  }
+  binary_suffix=opus_tags_get_binary_suffix(_tags,&binary_suffix_len);
+  if(binary_suffix_len>0)memcpy(_dst,binary_suffix,binary_suffix_len);
+  return _dst+binary_suffix_len;
+}
+
+/*Check whether a comment header in packet form is the same as _tags.
+  Return: 1 if it is, 0 if it is not, or OP_EFAULT on allocation failure.*/
+static int op_tags_packed_equal(const OpusTags *_tags,
+ const unsigned char *_data,size_t _size){
+  unsigned char *buf;
   int            ret;
+  if(_size==0||op_tags_packed_size(_tags)!=_size)return 0;
+  buf=(unsigned char *)_ogg_malloc(_size);
+  if(OP_UNLIKELY(buf==NULL))return OP_EFAULT;
+  op_tags_pack(buf,_tags);
+  ret=memcmp(buf,_data,_size)==0;
+  _ogg_free(buf);
+  return ret;
+}
+
+/*Read the CRC of the page that starts at the given offset directly from the
+   stream, bypassing the sync state.
+  This does not restore the position indicator afterwards.*/
+static int op_get_page_crc(OggOpusFile *_of,opus_uint32 *_crc,
+ opus_int64 _offset){
+  unsigned char header[27];
+  int           nread;
+  int           ret;
+  if(OP_UNLIKELY(op_stream_seek(_of,_offset,SEEK_SET)<0)){
+    return OP_EREAD;
+  }
+  for(nread=0;nread<27;nread+=ret){
+    ret=op_stream_read(_of,header+nread,27-nread);
+    if(OP_UNLIKELY(ret<=0))return ret<0?OP_EREAD:OP_EBADLINK;
+  }
+  if(OP_UNLIKELY(memcmp(header,"OggS",4)!=0))return OP_EBADLINK;
+  *_crc=op_unpack_uint32le(header+22);
+  return 0;
+}
+
+/*Get the size of the stream and the CRCs of its first and last pages, as
+   recorded in the link index.*/
+static int op_get_index_signature(OggOpusFile *_of,opus_int64 *_size,
+ opus_uint32 *_first_crc,opus_uint32 *_last_crc,opus_int64 _last_offset){
+  opus_int64 size;
+  int        ret;
+  if(OP_UNLIKELY(op_stream_seek(_of,0,SEEK_END)<0)){
+    return OP_EREAD;
+  }
+  size=(*_of->callbacks.tell)(_of->stream);
+  if(OP_UNLIKELY(size<0))return OP_EREAD;
+  *_size=size;
+  ret=op_get_page_crc(_of,_first_crc,_of->links[0].offset);
+  if(OP_UNLIKELY(ret<0))return ret;
+  return op_get_page_crc(_of,_last_crc,_last_offset);
+}
+
+/*Load the link structure from a previously exported index.
+  On failure, the contents of _of are left unchanged (except for the
+   position indicator of the underlying stream), so that the caller can fall
+   back to scanning the stream.
+  On success, link 0 keeps the headers already read by op_open1(), since they
+   have been checked against the copies in the index.*/
+static int op_link_index_import(OggOpusFile *_of,
+ const unsigned char *_index,size_t _index_size){
+  OggOpusLink         *links;
+  const unsigned char *data;
+  size_t               left;
+  opus_int64           stream_size;
+  opus_int64           end;
+  opus_int64           prev_end_offset;
+  ogg_int64_t          total_duration;
+  opus_uint32          first_crc;
+  opus_uint32          last_crc;
+  opus_uint32          nlinks;
+  int                  ntags;
+  int                  ret;
+  int                  li;
+  if(OP_UNLIKELY(_index_size<OP_LINK_INDEX_HEADER_SIZE)
+   ||memcmp(_index,"OpusLIdx",8)!=0){
+    return OP_ENOTFORMAT;
+  }
+  end=op_unpack_int64le(_index+16);
+  nlinks=op_unpack_uint32le(_index+32);
+  if(OP_UNLIKELY(end<_of->links[0].data_offset)
+   ||OP_UNLIKELY(nlinks<1)
+   ||OP_UNLIKELY(nlinks>(_index_size-OP_LINK_INDEX_HEADER_SIZE)
+   /OP_LINK_INDEX_LINK_SIZE)){
+    return OP_EBADHEADER;
+  }
+  links=(OggOpusLink *)_ogg_malloc(sizeof(*links)*nlinks);
+  if(OP_UNLIKELY(links==NULL))return OP_EFAULT;
+  data=_index+OP_LINK_INDEX_HEADER_SIZE;
+  left=_index_size-OP_LINK_INDEX_HEADER_SIZE;
+  prev_end_offset=0;
+  total_duration=0;
+  ntags=1;
+  ret=0;
+  for(li=0;li<(int)nlinks;li++){
+    OggOpusLink *link;
+    ogg_int64_t  duration;
+    opus_uint32  size;
+    link=links+li;
+    if(OP_UNLIKELY(left<OP_LINK_INDEX_LINK_SIZE)){
+      ret=OP_EBADHEADER;
+      break;
+    }
+    link->offset=op_unpack_int64le(data);
+    link->data_offset=op_unpack_int64le(data+8);
+    link->end_offset=op_unpack_int64le(data+16);
+    link->pcm_file_offset=op_unpack_int64le(data+24);
+    link->pcm_start=op_unpack_int64le(data+32);
+    link->pcm_end=op_unpack_int64le(data+40);
+    link->serialno=op_unpack_uint32le(data+48);
+    data+=52;
+    left-=52;
+    /*The ID header.*/
+    size=op_unpack_uint32le(data);
+    data+=4;
+    left-=4;
+    if(OP_UNLIKELY(size>left)){
+      ret=OP_EBADHEADER;
+      break;
+    }
+    /*We already have the headers for the first link.*/
+    if(li>0){
+      ret=opus_head_parse(&link->head,data,size);
+      if(OP_UNLIKELY(ret<0))break;
+    }
+    else{
+      unsigned char head[21+255];
+      OP_ASSERT(li==0);
+      *&link->head=*&_of->links[0].head;
+      /*It must be the same ID header we read while opening the stream.*/
+      op_head_pack(head,&link->head);
+      if(size!=(opus_uint32)op_head_packed_size(&link->head)
+       ||memcmp(head,data,size)!=0){
+        ret=OP_EBADLINK;
+        break;
+      }
+    }
+    data+=size;
+    left-=size;
+    /*The comment header.*/
+    if(OP_UNLIKELY(left<4)){
+      ret=OP_EBADHEADER;
+      break;
+    }
+    size=op_unpack_uint32le(data);
+    data+=4;
+    left-=4;
+    if(OP_UNLIKELY(size>left)){
+      ret=OP_EBADHEADER;
+      break;
+    }
+    if(li>0){
+      opus_tags_init(&link->tags);
+      ret=opus_tags_parse(&link->tags,data,size);
+      if(OP_UNLIKELY(ret<0))break;
+      ntags++;
+    }
+    else{
+      /*Likewise for the comment header.*/
+      ret=op_tags_packed_equal(&_of->links[0].tags,data,size);
+      if(OP_UNLIKELY(ret<=0)){
+        if(ret==0)ret=OP_EBADLINK;
+        break;
+      }
+    }
+    data+=size;
+    left-=size;
+    /*Make sure the link offsets and timestamps are consistent, since the rest
+       of the library relies on that.*/
+    if(OP_UNLIKELY(link->offset<prev_end_offset)
+     ||OP_UNLIKELY(link->data_offset<link->offset)
+     ||OP_UNLIKELY(link->end_offset<link->data_offset)
+     ||OP_UNLIKELY(link->end_offset>=end)
+     ||OP_UNLIKELY(link->pcm_start==-1)||OP_UNLIKELY(link->pcm_end==-1)
+     ||OP_UNLIKELY(link->pcm_file_offset!=total_duration)
+     ||OP_UNLIKELY(op_granpos_diff(&duration,
+     link->pcm_end,link->pcm_start)<0)
+     ||OP_UNLIKELY(duration<link->head.pre_skip)){
+      ret=OP_EBADTIMESTAMP;
+      break;
+    }
+    duration-=link->head.pre_skip;
+    if(OP_UNLIKELY(OP_INT64_MAX-duration<total_duration)){
+      ret=OP_EBADTIMESTAMP;
+      break;
+    }
+    total_duration+=duration;
+    prev_end_offset=link->end_offset;
+  }
+  if(OP_LIKELY(ret>=0)&&OP_UNLIKELY(left>0))ret=OP_EBADHEADER;
+  /*The first link must match what we read while opening the stream.*/
+  if(OP_LIKELY(ret>=0)&&(links[0].offset!=_of->links[0].offset
+   ||links[0].data_offset!=_of->links[0].data_offset
+   ||links[0].pcm_start!=_of->links[0].pcm_start
+   ||links[0].serialno!=_of->links[0].serialno)){
+    ret=OP_EBADLINK;
+  }
+  /*Finally, check that the stream itself has not changed.*/
+  if(OP_LIKELY(ret>=0)){
+    ret=op_get_index_signature(_of,&stream_size,&first_crc,&last_crc,
+     links[nlinks-1].end_offset);
+    if(OP_LIKELY(ret>=0)
+     &&(stream_size!=op_unpack_int64le(_index+8)
+     ||OP_UNLIKELY(end>stream_size)
+     ||first_crc!=op_unpack_uint32le(_index+24)
+     ||last_crc!=op_unpack_uint32le(_index+28))){
+      ret=OP_EBADLINK;
+    }
+  }
+  if(OP_UNLIKELY(ret<0)){
+    for(li=1;li<ntags;li++)opus_tags_clear(&links[li].tags);
+    _ogg_free(links);
+    return ret;
+  }
+  *&links[0].tags=*&_of->links[0].tags;
+  _ogg_free(_of->links);
+  _of->links=links;
+  _of->nlinks=(int)nlinks;
+  _of->end=end;
+  /*We don't need these anymore, just like after op_bisect_forward_serialno().*/
+  _ogg_free(_of->serialnos);
+  _of->serialnos=NULL;
+  _of->cserialnos=_of->nserialnos=0;
+  return 0;
+}
+
+/*Finds the links in one member of a chain created by op_open_chain(), which
+   occupies bytes [_offset,_offset+_size) of the stream.
+  Each member is enumerated on its own, so a link can never run past the end of
+   its member, even if the next member starts with the same serial number.
+  _fetch is zero if we already have the headers of the member's first link
+   (from op_open1()).
+  Return: 0 on success, or a negative value on error.*/
+static int op_chain_enumerate_member(OggOpusFile *_of,opus_int64 _offset,
+ opus_int64 _size,ogg_int64_t *_total_duration,int _fetch){
+  OpusLinkScan  scan;
+  OggOpusLink  *links;
+  int           nlinks;
+  int           ret;
+  links=_of->links;
+  nlinks=_of->nlinks;
+  if(_fetch){
+    if(OP_UNLIKELY(nlinks>=INT_MAX))return OP_EFAULT;
+    links=(OggOpusLink *)_ogg_realloc(links,sizeof(*links)*(nlinks+1));
+    if(OP_UNLIKELY(links==NULL))return OP_EFAULT;
+    _of->links=links;
+    ret=op_seek_helper(_of,_offset);
+    if(OP_UNLIKELY(ret<0))return ret;
+    ret=op_fetch_headers(_of,&links[nlinks].head,&links[nlinks].tags,
+     &_of->serialnos,&_of->nserialnos,&_of->cserialnos,NULL);
+    if(OP_UNLIKELY(ret<0))return ret;
+    _of->nlinks=++nlinks;
+    links[nlinks-1].offset=_offset;
+    links[nlinks-1].data_offset=_of->offset;
+    links[nlinks-1].serialno=_of->os.serialno;
+    links[nlinks-1].pcm_end=-1;
+    ret=op_find_initial_pcm_offset(_of,links+nlinks-1,NULL);
+    if(OP_UNLIKELY(ret<0))return ret;
+    links[nlinks-1].pcm_file_offset=*_total_duration;
+  }
+  /*From here on, this is op_open_seekable2_impl() with the end of the member
+     standing in for the end of the file.*/
+  ret=op_get_prev_page_serial(_of,scan.sr,_offset+_size,
+   links[nlinks-1].serialno,_of->serialnos,_of->nserialnos);
+  if(OP_UNLIKELY(ret<0))return ret;
+  if(OP_UNLIKELY(scan.sr[0].offset<links[nlinks-1].data_offset)){
+    return OP_EBADLINK;
+  }
+  scan.nsr=1;
+  scan.searched=links[nlinks-1].data_offset;
+  scan.next=-1;
+  scan.total_duration=*_total_duration;
+  ret=op_bisect_forward_serialno(_of,&scan,INT_MAX,-1,-1);
+  if(OP_UNLIKELY(ret<0))return ret;
+  *_total_duration=scan.total_duration;
+  return 0;
+}
+
+/*The chain counterpart of op_bisect_forward_serialno().
+  _scan->member is the next member to enumerate, and _scan->next and
+   _scan->total_duration are the byte and sample offsets at which it starts.
+  Return: 0 if we found all of the links, 1 if we stopped early, or a negative
+           value on error.*/
+static int op_chain_probe(OggOpusFile *_of,OpusLinkScan *_scan,
+ int _nlinks,opus_int64 _offset,ogg_int64_t _pcm_offset){
+  ogg_int64_t total_duration;
+  opus_int64  next;
+  int         nmembers;
+  int         mi;
+  nmembers=op_chain_stream_nmembers(_of->stream);
+  mi=_scan->member;
+  next=_scan->next;
+  total_duration=_scan->total_duration;
+  for(;;){
+    opus_int64 offset;
+    opus_int64 size;
+    int        ret;
+    /*Empty members contribute no links.*/
+    for(size=0;mi<nmembers;mi++){
+      op_chain_stream_member_range(_of->stream,mi,&offset,&size);
+      if(size>0)break;
+    }
+    if(mi>=nmembers)return 0;
+    if(_of->nlinks>=_nlinks&&next>_offset&&total_duration>_pcm_offset){
+      _scan->member=mi;
+      _scan->next=next;
+      _scan->total_duration=total_duration;
+      return 1;
+    }
+    ret=op_chain_enumerate_member(_of,offset,size,&total_duration,1);
+    if(OP_UNLIKELY(ret<0))return ret;
+    next=offset+size;
+    mi++;
+  }
+}
+
+/*Find the links in the first non-empty member of a chain, whose first link
+   op_open1() has already read, and leave _scan ready to find the rest.
+  Return: 0 if that was the only member with any links, 1 if there are more
+           to find, or a negative value on error.*/
+static int op_chain_open(OggOpusFile *_of,OpusLinkScan *_scan){
+  ogg_int64_t total_duration;
+  opus_int64  offset;
+  opus_int64  size;
+  int         nmembers;
+  int         mi;
+  int         ret;
+  nmembers=op_chain_stream_nmembers(_of->stream);
+  for(size=offset=0,mi=0;mi<nmembers;mi++){
+    op_chain_stream_member_range(_of->stream,mi,&offset,&size);
+    if(size>0)break;
+  }
+  /*op_open1() would have failed on a chain with no data at all.*/
+  OP_ASSERT(mi<nmembers);
+  OP_ASSERT(offset==0);
+  total_duration=0;
+  ret=op_chain_enumerate_member(_of,offset,size,&total_duration,0);
+  if(OP_UNLIKELY(ret<0))return ret;
+  _scan->member=mi+1;
+  _scan->next=offset+size;
+  _scan->total_duration=total_duration;
+  return op_chain_probe(_of,_scan,1,-1,-1);
+}
+
+static int op_open_seekable2_impl(OggOpusFile *_of,
+ const unsigned char *_index,size_t _index_size){
+  OpusLinkScan *scan;
+  opus_int64    data_offset;
+  int           ret;
+  /*If we were given a link index that still matches this stream, we can skip
+     the scan entirely.
+    Otherwise, just ignore it.*/
+  if(_index!=NULL&&op_link_index_import(_of,_index,_index_size)>=0)return 0;
   /*We can seek, so set out learning all about this file.*/
-  (*_of->callbacks.seek)(_of->stream,0,SEEK_END);
+  op_stream_seek(_of,0,SEEK_END);
   _of->offset=_of->end=(*_of->callbacks.tell)(_of->stream);
   if(OP_UNLIKELY(_of->end<0))return OP_EREAD;
   data_offset=_of->links[0].data_offset;
   if(OP_UNLIKELY(_of->end<data_offset))return OP_EBADLINK;
+  /*The seek records are a bit too large to put on the stack, and we need to
+     keep them around in lazy mode anyway.*/
+  scan=(OpusLinkScan *)_ogg_malloc(sizeof(*scan));
+  if(OP_UNLIKELY(scan==NULL))return OP_EFAULT;
+  /*Chains keep track of where each member starts and ends, so there's no
+     need to go looking for the end of the stream.
+    We always enumerate the rest of their members lazily.*/
+  if(op_is_chain_stream(&_of->callbacks)){
+    ret=op_chain_open(_of,scan);
+    if(ret>0){
+      _of->link_scan=scan;
+      return 0;
+    }
+    _ogg_free(scan);
+    return ret;
+  }
   /*Get the offset of the last page of the physical bitstream, or, if we're
      lucky, the last Opus page of the first link, as most Ogg Opus files will
      contain a single logical bitstream.*/
-  ret=op_get_prev_page_serial(_of,sr,_of->end,
+  ret=op_get_prev_page_serial(_of,scan->sr,_of->end,
    _of->links[0].serialno,_of->serialnos,_of->nserialnos);
-  if(OP_UNLIKELY(ret<0))return ret;
-  /*If there's any trailing junk, forget about it.*/
-  _of->end=sr[0].offset+sr[0].size;
-  if(OP_UNLIKELY(_of->end<data_offset))return OP_EBADLINK;
-  /*Now enumerate the bitstream structure.*/
-  return op_bisect_forward_serialno(_of,data_offset,sr,sizeof(sr)/sizeof(*sr),
-   &_of->serialnos,&_of->nserialnos,&_of->cserialnos);
+  if(OP_LIKELY(ret>=0)){
+    /*If there's any trailing junk, forget about it.*/
+    _of->end=scan->sr[0].offset+scan->sr[0].size;
+    if(OP_UNLIKELY(_of->end<data_offset))ret=OP_EBADLINK;
+  }
+  if(OP_LIKELY(ret>=0)){
+    scan->nsr=1;
+    scan->searched=data_offset;
+    scan->next=-1;
+    scan->total_duration=0;
+    /*Now enumerate the bitstream structure (or, in lazy mode, just the first
+       link).*/
+    ret=op_bisect_forward_serialno(_of,scan,_of->lazy_links?1:INT_MAX,-1,-1);
+    if(ret>0){
+      _of->link_scan=scan;
+      return 0;
+    }
+  }
+  _ogg_free(scan);
+  return ret;
 }
 
-static int op_open_seekable2(OggOpusFile *_of){
-  ogg_sync_state    oy_start;
-  ogg_stream_state  os_start;
-  ogg_packet       *op_start;
+/*The stream state set aside while we go look at other parts of the stream.*/
+typedef struct OpusStreamSave OpusStreamSave;
+
+struct OpusStreamSave{
+  ogg_sync_state    oy;
+  ogg_stream_state  os;
+  ogg_packet       *op;
+  opus_int64        offset;
   opus_int64        prev_page_offset;
-  opus_int64        start_offset;
-  int               start_op_count;
-  int               ret;
+  ogg_int64_t       prev_packet_gp;
+  opus_int64        bytes_tracked;
+  opus_int32        cur_discard_count;
+  int               op_pos;
+  int               op_count;
+  int               ready_state;
+};
+
+/*Set aside the current stream state, and start over with fresh ones.*/
+static int op_stream_save(OggOpusFile *_of,OpusStreamSave *_save){
+  int op_count;
+  op_count=_of->op_count;
+  /*This is a bit too large to put on the stack unconditionally.*/
+  _save->op=NULL;
+  if(op_count>0){
+    _save->op=(ogg_packet *)_ogg_malloc(sizeof(*_save->op)*op_count);
+    if(_save->op==NULL)return OP_EFAULT;
+    memcpy(_save->op,_of->op,sizeof(*_save->op)*op_count);
+  }
+  OP_ASSERT((*_of->callbacks.tell)(_of->stream)==op_position(_of));
+  *&_save->oy=*&_of->oy;
+  *&_save->os=*&_of->os;
+  _save->offset=_of->offset;
+  _save->prev_page_offset=_of->prev_page_offset;
+  _save->prev_packet_gp=_of->prev_packet_gp;
+  _save->bytes_tracked=_of->bytes_tracked;
+  _save->cur_discard_count=_of->cur_discard_count;
+  _save->op_pos=_of->op_pos;
+  _save->op_count=op_count;
+  _save->ready_state=_of->ready_state;
+  /*The new sync state is empty, so the offset has to move up to where the
+     stream actually is.*/
+  _of->offset=op_position(_of);
+  ogg_sync_init(&_of->oy);
+  ogg_stream_init(&_of->os,-1);
+  return 0;
+}
+
+/*Throw away the scratch stream state and put back the one we set aside,
+   including the position indicator.*/
+static int op_stream_restore(OggOpusFile *_of,OpusStreamSave *_save){
+  ogg_stream_clear(&_of->os);
+  ogg_sync_clear(&_of->oy);
+  *&_of->oy=*&_save->oy;
+  *&_of->os=*&_save->os;
+  _of->offset=_save->offset;
+  _of->prev_page_offset=_save->prev_page_offset;
+  _of->prev_packet_gp=_save->prev_packet_gp;
+  _of->bytes_tracked=_save->bytes_tracked;
+  _of->cur_discard_count=_save->cur_discard_count;
+  _of->op_pos=_save->op_pos;
+  _of->op_count=_save->op_count;
+  _of->ready_state=_save->ready_state;
+  if(_save->op!=NULL){
+    memcpy(_of->op,_save->op,sizeof(*_of->op)*_save->op_count);
+    _ogg_free(_save->op);
+  }
+  return op_stream_seek(_of,op_position(_of),SEEK_SET)<0?OP_EREAD:0;
+}
+
+static int op_open_seekable2(OggOpusFile *_of,
+ const unsigned char *_index,size_t _index_size){
+  OpusStreamSave save;
+  int            ret;
   /*We're partially open and have a first link header state in storage in _of.
     Save off that stream state so we can come back to it.
     It would be simpler to just dump all this state and seek back to
@@ -1433,35 +2386,54 @@ static int op_open_seekable2(OggOpusFile *_of){
      connection (if it's still available), instead of opening a new one.
     This means we can open and start playing a normal Opus file with a single
      link and reasonable packet sizes using only two HTTP requests.*/
-  start_op_count=_of->op_count;
-  /*This is a bit too large to put on the stack unconditionally.*/
-  op_start=(ogg_packet *)_ogg_malloc(sizeof(*op_start)*start_op_count);
-  if(op_start==NULL)return OP_EFAULT;
-  *&oy_start=_of->oy;
-  *&os_start=_of->os;
-  prev_page_offset=_of->prev_page_offset;
-  start_offset=_of->offset;
-  memcpy(op_start,_of->op,sizeof(*op_start)*start_op_count);
-  OP_ASSERT((*_of->callbacks.tell)(_of->stream)==op_position(_of));
-  ogg_sync_init(&_of->oy);
-  ogg_stream_init(&_of->os,-1);
-  ret=op_open_seekable2_impl(_of);
-  /*Restore the old stream state.*/
-  ogg_stream_clear(&_of->os);
-  ogg_sync_clear(&_of->oy);
-  *&_of->oy=*&oy_start;
-  *&_of->os=*&os_start;
-  _of->offset=start_offset;
-  _of->op_count=start_op_count;
-  memcpy(_of->op,op_start,sizeof(*_of->op)*start_op_count);
-  _ogg_free(op_start);
-  _of->prev_packet_gp=_of->links[0].pcm_start;
-  _of->prev_page_offset=prev_page_offset;
-  _of->cur_discard_count=_of->links[0].head.pre_skip;
+  ret=op_stream_save(_of,&save);
+  if(OP_UNLIKELY(ret<0))return ret;
+  ret=op_open_seekable2_impl(_of,_index,_index_size);
+  /*Restore the old stream state (and the position indicator).*/
+  if(OP_UNLIKELY(ret<0)){
+    op_stream_restore(_of,&save);
+    return ret;
+  }
+  return op_stream_restore(_of,&save);
+}
+
+/*Find more of the links of a stream opened in lazy mode, until we know at
+   least _nlinks links, every link that starts at or before byte _offset, and
+   every link that starts at or before sample _pcm_offset.
+  Like op_open_seekable2(), this puts the stream state back the way it was when
+   it's done, so decoding can continue where it left off.
+  Return: 0 on success, or a negative value on error.
+          On error, we forget any links we found along the way, so that we can
+           try again from the same place later.*/
+static int op_discover_links(OggOpusFile *_of,int _nlinks,
+ opus_int64 _offset,ogg_int64_t _pcm_offset){
+  OpusStreamSave  save;
+  OpusLinkScan   *scan;
+  int             nlinks;
+  int             ret;
+  scan=_of->link_scan;
+  if(scan==NULL||_of->nlinks>=_nlinks&&scan->next>_offset
+   &&scan->total_duration>_pcm_offset){
+    return 0;
+  }
+  nlinks=_of->nlinks;
+  ret=op_stream_save(_of,&save);
   if(OP_UNLIKELY(ret<0))return ret;
-  /*And restore the position indicator.*/
-  ret=(*_of->callbacks.seek)(_of->stream,op_position(_of),SEEK_SET);
-  return OP_UNLIKELY(ret<0)?OP_EREAD:0;
+  ret=op_is_chain_stream(&_of->callbacks)?
+   op_chain_probe(_of,scan,_nlinks,_offset,_pcm_offset):
+   op_bisect_forward_serialno(_of,scan,_nlinks,_offset,_pcm_offset);
+  if(OP_UNLIKELY(ret<0)){
+    int li;
+    for(li=nlinks;li<_of->nlinks;li++)opus_tags_clear(&_of->links[li].tags);
+    _of->nlinks=nlinks;
+    op_stream_restore(_of,&save);
+    return ret;
+  }
+  if(ret==0){
+    _ogg_free(scan);
+    _of->link_scan=NULL;
+  }
+  return op_stream_restore(_of,&save);
 }
 
 /*Clear out the current logical bitstream decoder.*/
@@ -1479,10 +2451,55 @@ static void op_decode_clear(OggOpusFile *_of){
   _of->ready_state=OP_OPENED;
 }
 
-static void op_clear(OggOpusFile *_of){
-  OggOpusLink *links;
-  _ogg_free(_of->od_buffer);
-  if(_of->od!=NULL)opus_multistream_decoder_destroy(_of->od);
+/*Drop decoder snapshot _si.*/
+static void op_snapshot_drop(OggOpusFile *_of,int _si){
+  OpusDecoderSnapshot *snapshots;
+  snapshots=_of->snapshots;
+  _of->snapshot_bytes-=snapshots[_si].state_size;
+  _ogg_free(snapshots[_si].state);
+  snapshots[_si]=snapshots[--_of->nsnapshots];
+}
+
+/*Drop the least recently used decoder snapshots until the rest use no more
+   than _max_bytes.*/
+static void op_snapshots_evict(OggOpusFile *_of,opus_int64 _max_bytes){
+  const OpusDecoderSnapshot *snapshots;
+  snapshots=_of->snapshots;
+  while(_of->snapshot_bytes>_max_bytes&&_of->nsnapshots>0){
+    opus_uint32 age;
+    int         lru;
+    int         si;
+    /*Measure ages from the current stamp, so wraparound doesn't matter.*/
+    lru=0;
+    age=_of->snapshot_stamp-snapshots[0].stamp;
+    for(si=1;si<_of->nsnapshots;si++){
+      if(_of->snapshot_stamp-snapshots[si].stamp>age){
+        age=_of->snapshot_stamp-snapshots[si].stamp;
+        lru=si;
+      }
+    }
+    op_snapshot_drop(_of,lru);
+  }
+}
+
+static void op_snapshots_clear(OggOpusFile *_of){
+  int si;
+  for(si=0;si<_of->nsnapshots;si++)_ogg_free(_of->snapshots[si].state);
+  _ogg_free(_of->snapshots);
+  _of->snapshots=NULL;
+  _of->nsnapshots=_of->csnapshots=0;
+  _of->snapshot_bytes=0;
+}
+
+static void op_clear(OggOpusFile *_of){
+  OggOpusLink     *links;
+  OpusDecoderPool *pool;
+  pool=_of->pool;
+  if(_of->od_buffer!=NULL&&pool!=NULL&&pool->nbuffers<pool->max_idle){
+    pool->buffers[pool->nbuffers++]=_of->od_buffer;
+  }
+  else _ogg_free(_of->od_buffer);
+  op_release_decoder(_of);
   links=_of->links;
   if(!_of->seekable){
     if(_of->ready_state>OP_OPENED||_of->ready_state==OP_PARTOPEN){
@@ -1496,7 +2513,13 @@ static void op_clear(OggOpusFile *_of){
     for(link=0;link<nlinks;link++)opus_tags_clear(&links[link].tags);
   }
   _ogg_free(links);
+  _ogg_free(_of->link_scan);
+  _ogg_free(_of->seek_points);
+  op_snapshots_clear(_of);
+  _ogg_free(_of->rev_buf);
+  _ogg_free(_of->rev_pages);
   _ogg_free(_of->serialnos);
+  _ogg_free(_of->replay_buf);
   ogg_stream_clear(&_of->os);
   ogg_sync_clear(&_of->oy);
   if(_of->callbacks.close!=NULL)(*_of->callbacks.close)(_of->stream);
@@ -1512,6 +2535,7 @@ static int op_open1(OggOpusFile *_of,
   memset(_of,0,sizeof(*_of));
   if(OP_UNLIKELY(_initial_bytes>(size_t)LONG_MAX))return OP_EFAULT;
   _of->end=-1;
+  _of->seek_point_spacing=OP_SEEK_POINT_SPACING_DEFAULT;
   _of->stream=_stream;
   *&_of->callbacks=*_cb;
   /*At a minimum, we need to be able to read data.*/
@@ -1547,6 +2571,10 @@ static int op_open1(OggOpusFile *_of,
     if(OP_UNLIKELY(pos!=(opus_int64)_initial_bytes))return OP_EINVAL;
   }
   _of->seekable=seekable;
+  /*If the whole stream is already in memory, we can frame pages in place.*/
+  if(seekable){
+    _of->map_data=op_mem_stream_get_data(_stream,_cb,&_of->map_size);
+  }
   /*Don't seek yet.
     Set up a 'single' (current) logical bitstream entry for partial open.*/
   _of->links=(OggOpusLink *)_ogg_malloc(sizeof(*_of->links));
@@ -1579,12 +2607,13 @@ static int op_open1(OggOpusFile *_of,
   return ret;
 }
 
-static int op_open2(OggOpusFile *_of){
+static int op_open2(OggOpusFile *_of,
+ const unsigned char *_index,size_t _index_size){
   int ret;
   OP_ASSERT(_of->ready_state==OP_PARTOPEN);
   if(_of->seekable){
     _of->ready_state=OP_OPENED;
-    ret=op_open_seekable2(_of);
+    ret=op_open_seekable2(_of,_index,_index_size);
   }
   else ret=0;
   if(OP_LIKELY(ret>=0)){
@@ -1603,11 +2632,15 @@ static int op_open2(OggOpusFile *_of){
 OggOpusFile *op_test_callbacks(void *_stream,const OpusFileCallbacks *_cb,
  const unsigned char *_initial_data,size_t _initial_bytes,int *_error){
   OggOpusFile *of;
+  opus_int64   start;
   int          ret;
   of=(OggOpusFile *)_ogg_malloc(sizeof(*of));
   ret=OP_EFAULT;
   if(OP_LIKELY(of!=NULL)){
+    start=OP_STATS_CLOCK();
     ret=op_open1(of,_stream,_cb,_initial_data,_initial_bytes);
+    /*op_open1() clears the counters, so this has to come after.*/
+    OP_STATS_ADD(of,open_ns,OP_STATS_CLOCK()-start);
     if(OP_LIKELY(ret>=0)){
       if(_error!=NULL)*_error=0;
       return of;
@@ -1621,13 +2654,18 @@ OggOpusFile *op_test_callbacks(void *_stream,const OpusFileCallbacks *_cb,
   return NULL;
 }
 
-OggOpusFile *op_open_callbacks(void *_stream,const OpusFileCallbacks *_cb,
- const unsigned char *_initial_data,size_t _initial_bytes,int *_error){
+OggOpusFile *op_open_callbacks_with_index(void *_stream,
+ const OpusFileCallbacks *_cb,const unsigned char *_initial_data,
+ size_t _initial_bytes,const unsigned char *_index,size_t _index_size,
+ int *_error){
   OggOpusFile *of;
   of=op_test_callbacks(_stream,_cb,_initial_data,_initial_bytes,_error);
   if(OP_LIKELY(of!=NULL)){
-    int ret;
-    ret=op_open2(of);
+    opus_int64 start;
+    int        ret;
+    start=OP_STATS_CLOCK();
+    ret=op_open2(of,_index,_index_size);
+    OP_STATS_ADD(of,open_ns,OP_STATS_CLOCK()-start);
     if(OP_LIKELY(ret>=0))return of;
     if(_error!=NULL)*_error=ret;
     _ogg_free(of);
@@ -1635,30 +2673,66 @@ OggOpusFile *op_open_callbacks(void *_stream,const OpusFileCallbacks *_cb,
   return NULL;
 }
 
+OggOpusFile *op_open_callbacks(void *_stream,const OpusFileCallbacks *_cb,
+ const unsigned char *_initial_data,size_t _initial_bytes,int *_error){
+  return op_open_callbacks_with_index(_stream,_cb,
+   _initial_data,_initial_bytes,NULL,0,_error);
+}
+
 /*Convenience routine to clean up from failure for the open functions that
    create their own streams.*/
 static OggOpusFile *op_open_close_on_failure(void *_stream,
- const OpusFileCallbacks *_cb,int *_error){
+ const OpusFileCallbacks *_cb,const unsigned char *_index,size_t _index_size,
+ int *_error){
   OggOpusFile *of;
   if(OP_UNLIKELY(_stream==NULL)){
     if(_error!=NULL)*_error=OP_EFAULT;
     return NULL;
   }
-  of=op_open_callbacks(_stream,_cb,NULL,0,_error);
+  of=op_open_callbacks_with_index(_stream,_cb,NULL,0,
+   _index,_index_size,_error);
   if(OP_UNLIKELY(of==NULL))(*_cb->close)(_stream);
   return of;
 }
 
 OggOpusFile *op_open_file(const char *_path,int *_error){
-  OpusFileCallbacks cb;
-  return op_open_close_on_failure(op_fopen(&cb,_path,"rb"),&cb,_error);
+  return op_open_file_with_index(_path,NULL,0,_error);
 }
 
 OggOpusFile *op_open_memory(const unsigned char *_data,size_t _size,
  int *_error){
+  return op_open_memory_with_index(_data,_size,NULL,0,_error);
+}
+
+OggOpusFile *op_open_file_with_index(const char *_path,
+ const unsigned char *_index,size_t _index_size,int *_error){
+  OpusFileCallbacks cb;
+  return op_open_close_on_failure(op_fopen(&cb,_path,"rb"),&cb,
+   _index,_index_size,_error);
+}
+
+OggOpusFile *op_open_memory_with_index(const unsigned char *_data,
+ size_t _size,const unsigned char *_index,size_t _index_size,int *_error){
   OpusFileCallbacks cb;
   return op_open_close_on_failure(op_mem_stream_create(&cb,_data,_size),&cb,
-   _error);
+   _index,_index_size,_error);
+}
+
+OggOpusFile *op_open_chain(const OpusChainSource *_sources,int _nsources,
+ int _max_open,int *_error){
+  OpusFileCallbacks  cb;
+  OggOpusFile       *of;
+  void              *stream;
+  if(OP_UNLIKELY(_nsources<=0)||OP_UNLIKELY(_max_open<=0)){
+    if(_error!=NULL)*_error=OP_EINVAL;
+    return NULL;
+  }
+  stream=op_chain_stream_create(&cb,_sources,_nsources,_max_open);
+  /*The chain only closes the streams of callback sources once we've
+     succeeded, so the caller still owns them if we fail.*/
+  of=op_open_close_on_failure(stream,&cb,NULL,0,_error);
+  if(OP_LIKELY(of!=NULL))op_chain_stream_own_callbacks(stream);
+  return of;
 }
 
 /*Convenience routine to clean up from failure for the open functions that
@@ -1688,9 +2762,12 @@ OggOpusFile *op_test_memory(const unsigned char *_data,size_t _size,
 }
 
 int op_test_open(OggOpusFile *_of){
-  int ret;
+  opus_int64 start;
+  int        ret;
   if(OP_UNLIKELY(_of->ready_state!=OP_PARTOPEN))return OP_EINVAL;
-  ret=op_open2(_of);
+  start=OP_STATS_CLOCK();
+  ret=op_open2(_of,NULL,0);
+  OP_STATS_ADD(_of,open_ns,OP_STATS_CLOCK()-start);
   /*op_open2() will clear this structure on failure.
     Reset its contents to prevent double-frees in op_free().*/
   if(OP_UNLIKELY(ret<0))memset(_of,0,sizeof(*_of));
@@ -1704,12 +2781,71 @@ void op_free(OggOpusFile *_of){
   }
 }
 
+OpusDecoderPool *op_decoder_pool_create(int _max_idle){
+  OpusDecoderPool *pool;
+  if(OP_UNLIKELY(_max_idle<=0)
+   ||OP_UNLIKELY((size_t)_max_idle>
+   (size_t)INT_MAX/sizeof(OpusPooledDecoder))){
+    return NULL;
+  }
+  pool=(OpusDecoderPool *)_ogg_malloc(sizeof(*pool));
+  if(OP_UNLIKELY(pool==NULL))return NULL;
+  pool->decoders=(OpusPooledDecoder *)_ogg_malloc(
+   sizeof(*pool->decoders)*_max_idle);
+  pool->buffers=(op_sample **)_ogg_malloc(sizeof(*pool->buffers)*_max_idle);
+  if(OP_UNLIKELY(pool->decoders==NULL)||OP_UNLIKELY(pool->buffers==NULL)){
+    _ogg_free(pool->buffers);
+    _ogg_free(pool->decoders);
+    _ogg_free(pool);
+    return NULL;
+  }
+  pool->ndecoders=pool->nbuffers=0;
+  pool->max_idle=_max_idle;
+  return pool;
+}
+
+void op_decoder_pool_free(OpusDecoderPool *_pool){
+  if(OP_LIKELY(_pool!=NULL)){
+    int i;
+    for(i=0;i<_pool->ndecoders;i++){
+      opus_multistream_decoder_destroy(_pool->decoders[i].od);
+    }
+    for(i=0;i<_pool->nbuffers;i++)_ogg_free(_pool->buffers[i]);
+    _ogg_free(_pool->buffers);
+    _ogg_free(_pool->decoders);
+    _ogg_free(_pool);
+  }
+}
+
+int op_set_decoder_pool(OggOpusFile *_of,OpusDecoderPool *_pool){
+  /*A decoder or buffer we allocated on our own might not be the right size to
+     hand over to a pool, so only allow this before we've made any.*/
+  if(OP_UNLIKELY(_of->od!=NULL)||OP_UNLIKELY(_of->od_buffer!=NULL)){
+    return OP_EINVAL;
+  }
+  _of->pool=_pool;
+  return 0;
+}
+
 int op_seekable(const OggOpusFile *_of){
   return _of->seekable;
 }
 
 int op_link_count(const OggOpusFile *_of){
-  return _of->nlinks;
+  return _of->link_scan!=NULL?OP_FALSE:_of->nlinks;
+}
+
+int op_set_lazy_links(OggOpusFile *_of,int _enabled){
+  if(OP_UNLIKELY(_of->ready_state!=OP_PARTOPEN))return OP_EINVAL;
+  _of->lazy_links=!!_enabled;
+  return 0;
+}
+
+int op_enumerate_links(OggOpusFile *_of,int _nlinks){
+  int ret;
+  if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
+  ret=op_discover_links(_of,_nlinks<0?INT_MAX:_nlinks,-1,-1);
+  return OP_UNLIKELY(ret<0)?ret:_of->nlinks;
 }
 
 opus_uint32 op_serialno(const OggOpusFile *_of,int _li){
@@ -1723,24 +2859,100 @@ int op_channel_count(const OggOpusFile *_of,int _li){
 }
 
 opus_int64 op_raw_total(const OggOpusFile *_of,int _li){
+  opus_int64 end;
   if(OP_UNLIKELY(_of->ready_state<OP_OPENED)
-   ||OP_UNLIKELY(!_of->seekable)
-   ||OP_UNLIKELY(_li>=_of->nlinks)){
+   ||OP_UNLIKELY(!_of->seekable)){
     return OP_EINVAL;
   }
   if(_li<0)return _of->end;
-  return (_li+1>=_of->nlinks?_of->end:_of->links[_li+1].offset)
+  /*In lazy mode, links we haven't found yet are out of range.*/
+  if(OP_UNLIKELY(_li>=_of->nlinks))return OP_EINVAL;
+  /*The last link we know about ends where the next one starts.*/
+  end=_of->link_scan!=NULL?_of->link_scan->next:_of->end;
+  return (_li+1>=_of->nlinks?end:_of->links[_li+1].offset)
    -(_li>0?_of->links[_li].offset:0);
 }
 
+int op_link_index_export(OggOpusFile *_of,unsigned char *_buf,size_t *_size){
+  OggOpusLink   *links;
+  unsigned char *data;
+  opus_int64     stream_size;
+  opus_uint32    first_crc;
+  opus_uint32    last_crc;
+  size_t         size;
+  size_t         buf_size;
+  int            nlinks;
+  int            ret;
+  int            li;
+  if(OP_UNLIKELY(_of->ready_state<OP_OPENED)
+   ||OP_UNLIKELY(!_of->seekable)){
+    return OP_EINVAL;
+  }
+  /*The index has to describe the whole stream.*/
+  ret=op_discover_links(_of,INT_MAX,-1,-1);
+  if(OP_UNLIKELY(ret<0))return ret;
+  links=_of->links;
+  nlinks=_of->nlinks;
+  size=OP_LINK_INDEX_HEADER_SIZE;
+  for(li=0;li<nlinks;li++){
+    size_t tags_size;
+    tags_size=op_tags_packed_size(&links[li].tags);
+    if(OP_UNLIKELY(tags_size==0))return OP_EFAULT;
+    tags_size+=OP_LINK_INDEX_LINK_SIZE+op_head_packed_size(&links[li].head);
+    if(OP_UNLIKELY(size+tags_size<size))return OP_EFAULT;
+    size+=tags_size;
+  }
+  buf_size=*_size;
+  *_size=size;
+  if(_buf==NULL)return 0;
+  if(OP_UNLIKELY(buf_size<size))return OP_EINVAL;
+  /*Read the signature directly from the stream, and then put the position
+     indicator back where we found it so decoding can continue undisturbed.*/
+  ret=op_get_index_signature(_of,&stream_size,&first_crc,&last_crc,
+   links[nlinks-1].end_offset);
+  if(OP_UNLIKELY(op_stream_seek(_of,
+   op_position(_of),SEEK_SET)<0)){
+    ret=OP_EREAD;
+  }
+  if(OP_UNLIKELY(ret<0))return ret;
+  memcpy(_buf,"OpusLIdx",8);
+  data=op_pack_int64le(_buf+8,stream_size);
+  data=op_pack_int64le(data,_of->end);
+  data=op_pack_uint32le(data,first_crc);
+  data=op_pack_uint32le(data,last_crc);
+  data=op_pack_uint32le(data,(opus_uint32)nlinks);
+  for(li=0;li<nlinks;li++){
+    data=op_pack_int64le(data,links[li].offset);
+    data=op_pack_int64le(data,links[li].data_offset);
+    data=op_pack_int64le(data,links[li].end_offset);
+    data=op_pack_int64le(data,links[li].pcm_file_offset);
+    data=op_pack_int64le(data,links[li].pcm_start);
+    data=op_pack_int64le(data,links[li].pcm_end);
+    data=op_pack_uint32le(data,links[li].serialno);
+    data=op_pack_uint32le(data,
+     (opus_uint32)op_head_packed_size(&links[li].head));
+    data=op_head_pack(data,&links[li].head);
+    data=op_pack_uint32le(data,
+     (opus_uint32)op_tags_packed_size(&links[li].tags));
+    data=op_tags_pack(data,&links[li].tags);
+  }
+  OP_ASSERT((size_t)(data-_buf)==size);
+  return 0;
+}
+
 ogg_int64_t op_pcm_total(const OggOpusFile *_of,int _li){
   OggOpusLink *links;
   ogg_int64_t  pcm_total;
   ogg_int64_t  diff;
   int          nlinks;
-  nlinks=_of->nlinks;
   if(OP_UNLIKELY(_of->ready_state<OP_OPENED)
-   ||OP_UNLIKELY(!_of->seekable)
+   ||OP_UNLIKELY(!_of->seekable)){
+    return OP_EINVAL;
+  }
+  nlinks=_of->nlinks;
+  /*In lazy mode, we don't know the length of the whole stream until we've
+     found every link, and links we haven't found yet are out of range.*/
+  if(OP_UNLIKELY(_li<0&&_of->link_scan!=NULL)
    ||OP_UNLIKELY(_li>=nlinks)){
     return OP_EINVAL;
   }
@@ -1807,6 +3019,7 @@ static opus_int32 op_calc_bitrate(opus_int64 _bytes,ogg_int64_t _samples){
 
 opus_int32 op_bitrate(const OggOpusFile *_of,int _li){
   if(OP_UNLIKELY(_of->ready_state<OP_OPENED)||OP_UNLIKELY(!_of->seekable)
+   ||OP_UNLIKELY(_li<0&&_of->link_scan!=NULL)
    ||OP_UNLIKELY(_li>=_of->nlinks)){
     return OP_EINVAL;
   }
@@ -1886,8 +3099,11 @@ static int op_fetch_and_process_page(OggOpusFile *_of,
     else _page_offset=op_get_next_page(_of,&og,_of->end);
     /*EOF: Leave uninitialized.*/
     if(_page_offset<0)return _page_offset<OP_FALSE?(int)_page_offset:OP_EOF;
+    /*Consecutive links in a chain may reuse a serial number, so a BOS page
+       always marks a new link.*/
     if(OP_LIKELY(_of->ready_state>=OP_STREAMSET)
-     &&cur_serialno!=(ogg_uint32_t)ogg_page_serialno(&og)){
+     &&(cur_serialno!=(ogg_uint32_t)ogg_page_serialno(&og)
+     ||OP_UNLIKELY(ogg_page_bos(&og)))){
       /*Two possibilities:
          1) Another stream is multiplexed into this logical section, or*/
       if(OP_LIKELY(!ogg_page_bos(&og)))continue;
@@ -1910,13 +3126,24 @@ static int op_fetch_and_process_page(OggOpusFile *_of,
       if(seekable){
         ogg_uint32_t serialno;
         serialno=ogg_page_serialno(&og);
+        /*In lazy mode, make sure we know which link this page belongs to.*/
+        if(OP_UNLIKELY(_of->link_scan!=NULL)
+         &&_page_offset>=_of->link_scan->next){
+          ret=op_discover_links(_of,0,_page_offset,-1);
+          if(OP_UNLIKELY(ret<0))return ret;
+          links=_of->links;
+        }
         /*Match the serialno to bitstream section.*/
         OP_ASSERT(cur_link>=0&&cur_link<_of->nlinks);
-        if(links[cur_link].serialno!=serialno){
+        if(links[cur_link].serialno!=serialno
+         ||_page_offset<links[cur_link].offset
+         ||cur_link+1<_of->nlinks&&_page_offset>=links[cur_link+1].offset){
           /*It wasn't a page from the current link.
             Is it from the next one?*/
           if(OP_LIKELY(cur_link+1<_of->nlinks&&links[cur_link+1].serialno==
-           serialno)){
+           serialno)&&_page_offset>=links[cur_link+1].offset
+           &&(cur_link+2>=_of->nlinks
+           ||_page_offset<links[cur_link+2].offset)){
             cur_link++;
           }
           else{
@@ -1945,22 +3172,46 @@ static int op_fetch_and_process_page(OggOpusFile *_of,
         }
       }
       else{
+        opus_int64 link_offset;
+        int        prev_link;
+        /*If the stream returns OP_EAGAIN before we have all the headers, we
+           can't pick up where we left off, so keep copies of the pages we
+           consume in order to start over.*/
+        link_offset=_page_offset;
+        prev_link=_of->cur_link;
+        _of->nreplay=0;
+        _of->replay_rec=1;
+        _of->would_block=0;
+        op_record_page(_of,&og);
         do{
           /*We're streaming.
             Fetch the two header packets, build the info struct.*/
           ret=op_fetch_headers(_of,&links[0].head,&links[0].tags,
            NULL,NULL,NULL,&og);
-          if(OP_UNLIKELY(ret<0))return ret;
+          if(OP_UNLIKELY(ret<0))break;
           /*op_find_initial_pcm_offset() will suppress any initial hole for us,
              so no need to set _ignore_holes.*/
           ret=op_find_initial_pcm_offset(_of,links,&og);
-          if(OP_UNLIKELY(ret<0))return ret;
+          if(OP_UNLIKELY(ret<0))break;
           _of->links[0].serialno=cur_serialno=_of->os.serialno;
           _of->cur_link++;
         }
         /*If the link was empty, keep going, because we already have the
            BOS page of the next one in og.*/
         while(OP_UNLIKELY(ret>0));
+        _of->replay_rec=0;
+        if(OP_UNLIKELY(ret<0)){
+          if(!_of->would_block)return ret;
+          /*op_fetch_headers() and op_find_initial_pcm_offset() turn read
+             errors into format errors, so check for OP_EAGAIN ourselves.*/
+          if(_of->ready_state>=OP_STREAMSET){
+            opus_tags_clear(&links[0].tags);
+            _of->ready_state=OP_OPENED;
+          }
+          _of->cur_link=prev_link;
+          ret=op_unread_pages(_of,link_offset);
+          return OP_UNLIKELY(ret<0)?ret:OP_EAGAIN;
+        }
         /*If we didn't get any packets out of op_find_initial_pcm_offset(),
            keep going (this is possible if end-trimming trimmed them all).*/
         if(_of->op_count<=0)continue;
@@ -1980,6 +3231,7 @@ static int op_fetch_and_process_page(OggOpusFile *_of,
     }
     /*Extract all the packets from the current page.*/
     ogg_stream_pagein(&_of->os,&og);
+    if(seekable)op_seek_points_add(_of,cur_link,&og,_page_offset);
     if(OP_LIKELY(_of->ready_state>=OP_INITSET)){
       opus_int32 total_duration;
       int        durations[255];
@@ -2154,12 +3406,15 @@ static int op_fetch_and_process_page(OggOpusFile *_of,
   }
 }
 
-int op_raw_seek(OggOpusFile *_of,opus_int64 _pos){
+static int op_raw_seek_impl(OggOpusFile *_of,opus_int64 _pos){
   int ret;
   if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
   /*Don't dump the decoder state if we can't seek.*/
   if(OP_UNLIKELY(!_of->seekable))return OP_ENOSEEK;
   if(OP_UNLIKELY(_pos<0)||OP_UNLIKELY(_pos>_of->end))return OP_EINVAL;
+  _of->rev_active=0;
+  ret=op_discover_links(_of,0,_pos,-1);
+  if(OP_UNLIKELY(ret<0))return ret;
   /*Clear out any buffered, decoded data.*/
   op_decode_clear(_of);
   _of->bytes_tracked=0;
@@ -2181,6 +3436,15 @@ int op_raw_seek(OggOpusFile *_of,opus_int64 _pos){
   return ret;
 }
 
+int op_raw_seek(OggOpusFile *_of,opus_int64 _pos){
+  opus_int64 start;
+  int        ret;
+  start=OP_STATS_CLOCK();
+  ret=op_raw_seek_impl(_of,_pos);
+  OP_STATS_ADD(_of,seek_ns,OP_STATS_CLOCK()-start);
+  return ret;
+}
+
 /*Convert a PCM offset relative to the start of the whole stream to a granule
    position in an individual link.*/
 static ogg_int64_t op_get_granulepos(const OggOpusFile *_of,
@@ -2224,18 +3488,6 @@ static ogg_int64_t op_get_granulepos(const OggOpusFile *_of,
   return pcm_start;
 }
 
-/*A small helper to determine if an Ogg page contains data that continues onto
-   a subsequent page.*/
-static int op_page_continues(const ogg_page *_og){
-  int nlacing;
-  OP_ASSERT(_og->header_len>=27);
-  nlacing=_og->header[26];
-  OP_ASSERT(_og->header_len>=27+nlacing);
-  /*This also correctly handles the (unlikely) case of nlacing==0, because
-     0!=255.*/
-  return _og->header[27+nlacing-1]==255;
-}
-
 /*A small helper to buffer the continued packet data from a page.*/
 static void op_buffer_continued_data(OggOpusFile *_of,ogg_page *_og){
   ogg_packet op;
@@ -2250,6 +3502,13 @@ static void op_buffer_continued_data(OggOpusFile *_of,ogg_page *_og){
   Two minutes seems to be a good default.*/
 #define OP_CUR_TIME_THRESH (120*48*(opus_int32)1000)
 
+/*How far before the interpolated position to start scanning, in samples.
+  We back off by this much audio at the average bitrate of the interval (but
+   never more than OP_CHUNK_SIZE bytes), so that at low bitrates we don't scan
+   forward through several seconds of pages after every guess.
+  Half a second seems to be a good default.*/
+#define OP_GUESS_BACKOFF (24000)
+
 /*Note: The OP_SMALL_FOOTPRINT #define doesn't (currently) save much code size,
    but it's meant to serve as documentation for portions of the seeking
    algorithm that are purely optional, to aid others learning from/porting this
@@ -2399,6 +3658,38 @@ static int op_pcm_seek_page(OggOpusFile *_of,
       }
     }
 #endif
+    /*Use any pages we've seen before to narrow the range further.*/
+    if(_of->nseek_points>0){
+      const OpusSeekPoint *sp;
+      int                  lo;
+      int                  hi;
+      op_seek_points_bracket(_of,_li,_target_gp,&lo,&hi);
+      if(lo>=0){
+        sp=_of->seek_points+lo;
+        if(sp->end_offset>begin&&sp->end_offset<=end
+         &&OP_LIKELY(op_granpos_cmp(pcm_start,sp->gp)<=0)
+         &&OP_LIKELY(op_granpos_cmp(pcm_end,sp->gp)>=0)){
+          /*Any continued packet data we were buffering is no longer
+             needed.*/
+          buffering=0;
+          best=begin=sp->end_offset;
+          /*As above, if the page has a continued packet, we start from the
+             beginning of the page so we can recover it.*/
+          best_start=sp->continued?sp->page_offset:best;
+          best_gp=pcm_start=sp->gp;
+        }
+      }
+      if(hi>=0){
+        sp=_of->seek_points+hi;
+        if(sp->page_offset>=begin&&sp->page_offset<end
+         &&OP_LIKELY(op_granpos_cmp(pcm_start,sp->gp)<=0)
+         &&OP_LIKELY(op_granpos_cmp(pcm_end,sp->gp)>=0)){
+          /*The page we want must start before this one.*/
+          end=boundary=sp->page_offset;
+          pcm_end=sp->gp;
+        }
+      }
+    }
   }
   /*This code was originally based on the "new search algorithm by HB (Nicholas
      Vinen)" from libvorbisfile.
@@ -2414,6 +3705,7 @@ static int op_pcm_seek_page(OggOpusFile *_of,
     opus_int64 bisect;
     opus_int64 next_boundary;
     opus_int32 chunk_size;
+    OP_STATS_ADD(_of,bisect_steps,1);
     if(end-begin<OP_CHUNK_SIZE)bisect=begin;
     else{
       /*Update the interval size history.*/
@@ -2426,7 +3718,8 @@ static int op_pcm_seek_page(OggOpusFile *_of,
         OP_ALWAYS_TRUE(!op_granpos_diff(&diff,_target_gp,pcm_start));
         OP_ALWAYS_TRUE(!op_granpos_diff(&diff2,pcm_end,pcm_start));
         /*Take a (pretty decent) guess.*/
-        bisect=begin+op_rescale64(diff,diff2,end-begin)-OP_CHUNK_SIZE;
+        bisect=begin+op_rescale64(diff,diff2,end-begin)
+         -OP_MIN(OP_CHUNK_SIZE,op_rescale64(OP_GUESS_BACKOFF,diff2,end-begin));
       }
       if(bisect-OP_CHUNK_SIZE<begin)bisect=begin;
       force_bisect=0;
@@ -2500,6 +3793,7 @@ static int op_pcm_seek_page(OggOpusFile *_of,
           }
           continue;
         }
+        op_seek_points_add(_of,_li,&og,page_offset);
         if(op_granpos_cmp(gp,_target_gp)<0){
           /*We found a page that ends before our target.
             Advance to the raw offset of the next page.*/
@@ -2596,7 +3890,198 @@ static int op_pcm_seek_page(OggOpusFile *_of,
   return 0;
 }
 
-int op_pcm_seek(OggOpusFile *_of,ogg_int64_t _pcm_offset){
+/*Take a snapshot of the decoder state, if we're at a page boundary and far
+   enough away from any existing snapshot in the same link.
+  This is called when every packet from the current page has been decoded and
+   returned, just before we fetch the next page.*/
+static void op_snapshot_take(OggOpusFile *_of){
+  OpusDecoderSnapshot *snapshots;
+  OpusDecoderSnapshot *snap;
+  ogg_int64_t          gp;
+  ogg_int64_t          diff;
+  opus_int32           spacing;
+  int                  state_size;
+  int                  nsnapshots;
+  int                  cur_link;
+  int                  si;
+  spacing=_of->snapshot_spacing;
+  if(spacing<=0)return;
+  /*The decoder has to have decoded every packet up to the end of the page
+     itself (not an application callback), with nothing left to discard.*/
+  if(!_of->seekable||_of->ready_state<OP_INITSET||!_of->od_ready
+   ||_of->decode_cb!=NULL||_of->op_count<=0||_of->cur_discard_count>0
+   ||_of->prev_page_offset<0){
+    return;
+  }
+  OP_ASSERT(_of->op_pos>=_of->op_count);
+  /*There's nothing to resume after the last page of a link.*/
+  if(_of->op[_of->op_count-1].e_o_s)return;
+  gp=_of->prev_packet_gp;
+  if(gp==-1)return;
+  cur_link=_of->cur_link;
+  snapshots=_of->snapshots;
+  nsnapshots=_of->nsnapshots;
+  for(si=0;si<nsnapshots;si++){
+    if(snapshots[si].li==cur_link
+     &&!op_granpos_diff(&diff,gp,snapshots[si].gp)
+     &&diff>-spacing&&diff<spacing){
+      return;
+    }
+  }
+  state_size=opus_multistream_decoder_get_size(_of->od_stream_count,
+   _of->od_coupled_count);
+  if(OP_UNLIKELY(state_size<=0)||state_size>_of->snapshot_max_bytes)return;
+  op_snapshots_evict(_of,_of->snapshot_max_bytes-state_size);
+  nsnapshots=_of->nsnapshots;
+  if(OP_UNLIKELY(nsnapshots>=_of->csnapshots)){
+    int csnapshots;
+    csnapshots=_of->csnapshots;
+    if(OP_UNLIKELY(csnapshots>INT_MAX-1>>1))return;
+    csnapshots=2*csnapshots+1;
+    snapshots=(OpusDecoderSnapshot *)_ogg_realloc(snapshots,
+     sizeof(*snapshots)*csnapshots);
+    if(OP_UNLIKELY(snapshots==NULL))return;
+    _of->snapshots=snapshots;
+    _of->csnapshots=csnapshots;
+  }
+  snap=snapshots+nsnapshots;
+  snap->state=(unsigned char *)_ogg_malloc(state_size);
+  if(OP_UNLIKELY(snap->state==NULL))return;
+  /*libopus decoders don't contain any pointers into themselves, so a plain
+     copy is a complete copy of the state.*/
+  memcpy(snap->state,_of->od,state_size);
+  snap->state_size=state_size;
+  snap->li=cur_link;
+  snap->gp=gp;
+  snap->page_offset=_of->prev_page_offset;
+  /*We haven't read anything past the end of the page yet.*/
+  snap->end_offset=_of->offset;
+  snap->continued=_of->os.body_returned<_of->os.body_fill;
+  snap->stamp=_of->snapshot_stamp++;
+#if !defined(OP_FIXED_POINT)
+# if defined(OP_SOFT_CLIP)
+  memcpy(snap->clip_state,_of->clip_state,sizeof(snap->clip_state));
+# endif
+  memcpy(snap->dither_a,_of->dither_a,sizeof(snap->dither_a));
+  memcpy(snap->dither_b,_of->dither_b,sizeof(snap->dither_b));
+  snap->dither_seed=_of->dither_seed;
+  snap->dither_mute=_of->dither_mute;
+  snap->state_channel_count=_of->state_channel_count;
+#endif
+  _of->snapshot_bytes+=state_size;
+  _of->nsnapshots=nsnapshots+1;
+}
+
+/*Find a decoder snapshot in link _li that we can resume from to reach
+   _target_gp.
+  Return: The index of the closest snapshot at or before the target, if it is
+           no more than the snapshot spacing away, or -1 if there is none.*/
+static int op_snapshot_find(const OggOpusFile *_of,int _li,
+ ogg_int64_t _target_gp){
+  const OpusDecoderSnapshot *snapshots;
+  ogg_int64_t                best_diff;
+  int                        nsnapshots;
+  int                        best;
+  int                        si;
+  snapshots=_of->snapshots;
+  nsnapshots=_of->nsnapshots;
+  best=-1;
+  best_diff=_of->snapshot_spacing;
+  for(si=0;si<nsnapshots;si++){
+    ogg_int64_t diff;
+    if(snapshots[si].li==_li
+     &&!op_granpos_diff(&diff,_target_gp,snapshots[si].gp)
+     &&diff>=0&&diff<=best_diff){
+      best=si;
+      best_diff=diff;
+    }
+  }
+  return best;
+}
+
+/*Position the stream to resume decoding in link _li right after a page whose
+   location and granule position we already know, without any searching.
+  This leaves the packets from the following page buffered and the decoder
+   ready to be set up, with no samples to discard.
+  _page_offset: The offset of the start of the page.
+  _end_offset:  The offset of the end of the page.
+  _gp:          The granule position of the page.
+  _continued:   Whether or not the last packet on the page continues on the
+                 next one.
+  Return: 0 on success, or a negative value on failure.*/
+static int op_seek_to_page(OggOpusFile *_of,int _li,opus_int64 _page_offset,
+ opus_int64 _end_offset,ogg_int64_t _gp,int _continued){
+  const OggOpusLink *link;
+  ogg_page           og;
+  opus_int64         start;
+  int                ret;
+  link=_of->links+_li;
+  op_decode_clear(_of);
+  _of->bytes_tracked=0;
+  _of->samples_tracked=0;
+  ogg_stream_reset_serialno(&_of->os,link->serialno);
+  _of->cur_link=_li;
+  _of->ready_state=OP_STREAMSET;
+  /*As in op_pcm_seek_page(), if the page has a continued packet, we start
+     from the beginning of the page so we can recover it.*/
+  start=_continued?_page_offset:_end_offset;
+  ret=op_seek_helper(_of,start);
+  if(OP_UNLIKELY(ret<0))return ret;
+  if(_continued){
+    opus_int64 page_offset;
+    page_offset=op_get_next_page(_of,&og,link->end_offset);
+    if(OP_UNLIKELY(page_offset<OP_FALSE))return (int)page_offset;
+    if(OP_UNLIKELY(page_offset!=start))return OP_EBADLINK;
+    op_buffer_continued_data(_of,&og);
+  }
+  _of->prev_packet_gp=_gp;
+  _of->prev_page_offset=start;
+  ret=op_fetch_and_process_page(_of,NULL,-1,0,1);
+  if(OP_UNLIKELY(ret<0))return OP_EBADLINK;
+  _of->cur_discard_count=0;
+  return 0;
+}
+
+/*Restore decoder snapshot _si and position the stream so that decoding
+   resumes with the page after it, discarding samples up to _target_gp.
+  This skips the usual 80 ms of pre-roll, since the decoder is in exactly the
+   state it was in when we first decoded this part of the stream.*/
+static int op_snapshot_restore(OggOpusFile *_of,int _si,
+ ogg_int64_t _target_gp){
+  OpusDecoderSnapshot *snap;
+  ogg_int64_t          diff;
+  int                  ret;
+  snap=_of->snapshots+_si;
+  ret=op_seek_to_page(_of,snap->li,snap->page_offset,snap->end_offset,
+   snap->gp,snap->continued);
+  if(OP_UNLIKELY(ret<0))return ret;
+  /*Make sure the packets we got pick up exactly where the snapshot left
+     off.*/
+  if(OP_UNLIKELY(_of->prev_packet_gp!=snap->gp))return OP_EBADLINK;
+  ret=op_init_decoder(_of);
+  if(OP_UNLIKELY(ret<0))return ret;
+  memcpy(_of->od,snap->state,snap->state_size);
+  /*The gain is part of the decoder state, and may have changed since the
+     snapshot was taken.*/
+  op_update_gain(_of);
+#if !defined(OP_FIXED_POINT)
+# if defined(OP_SOFT_CLIP)
+  memcpy(_of->clip_state,snap->clip_state,sizeof(_of->clip_state));
+# endif
+  memcpy(_of->dither_a,snap->dither_a,sizeof(_of->dither_a));
+  memcpy(_of->dither_b,snap->dither_b,sizeof(_of->dither_b));
+  _of->dither_seed=snap->dither_seed;
+  _of->dither_mute=snap->dither_mute;
+  _of->state_channel_count=snap->state_channel_count;
+#endif
+  snap->stamp=_of->snapshot_stamp++;
+  OP_ALWAYS_TRUE(!op_granpos_diff(&diff,_target_gp,snap->gp));
+  OP_ASSERT(diff>=0&&diff<=_of->snapshot_spacing);
+  _of->cur_discard_count=(opus_int32)diff;
+  return 0;
+}
+
+static int op_pcm_seek_impl(OggOpusFile *_of,ogg_int64_t _pcm_offset){
   const OggOpusLink *link;
   ogg_int64_t        pcm_start;
   ogg_int64_t        target_gp;
@@ -2610,6 +4095,9 @@ int op_pcm_seek(OggOpusFile *_of,ogg_int64_t _pcm_offset){
   if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
   if(OP_UNLIKELY(!_of->seekable))return OP_ENOSEEK;
   if(OP_UNLIKELY(_pcm_offset<0))return OP_EINVAL;
+  _of->rev_active=0;
+  ret=op_discover_links(_of,0,-1,_pcm_offset);
+  if(OP_UNLIKELY(ret<0))return ret;
   target_gp=op_get_granulepos(_of,_pcm_offset,&li);
   if(OP_UNLIKELY(target_gp==-1))return OP_EINVAL;
   link=_of->links+li;
@@ -2642,6 +4130,19 @@ int op_pcm_seek(OggOpusFile *_of,ogg_int64_t _pcm_offset){
     }
   }
 #endif
+  /*If we have a decoder snapshot shortly before the target, resume from
+     there.*/
+  if(_of->nsnapshots>0&&_of->decode_cb==NULL){
+    int si;
+    si=op_snapshot_find(_of,li,target_gp);
+    if(si>=0){
+      ret=op_snapshot_restore(_of,si,target_gp);
+      if(OP_LIKELY(ret>=0))return 0;
+      /*The stream didn't match the snapshot (or we couldn't read it).
+        Forget about it and do a regular seek.*/
+      op_snapshot_drop(_of,si);
+    }
+  }
   ret=op_pcm_seek_page(_of,target_gp,li);
   if(OP_UNLIKELY(ret<0))return ret;
   /*Now skip samples until we actually get to our target.*/
@@ -2685,6 +4186,15 @@ int op_pcm_seek(OggOpusFile *_of,ogg_int64_t _pcm_offset){
   return 0;
 }
 
+int op_pcm_seek(OggOpusFile *_of,ogg_int64_t _pcm_offset){
+  opus_int64 start;
+  int        ret;
+  start=OP_STATS_CLOCK();
+  ret=op_pcm_seek_impl(_of,_pcm_offset);
+  OP_STATS_ADD(_of,seek_ns,OP_STATS_CLOCK()-start);
+  return ret;
+}
+
 opus_int64 op_raw_tell(const OggOpusFile *_of){
   if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
   return _of->offset;
@@ -2726,6 +4236,7 @@ ogg_int64_t op_pcm_tell(const OggOpusFile *_of){
   int         nbuffered;
   int         li;
   if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
+  if(_of->rev_active)return _of->rev_pos;
   gp=_of->prev_packet_gp;
   if(gp==-1)return 0;
   nbuffered=OP_MAX(_of->od_buffer_size-_of->od_buffer_pos,0);
@@ -2737,6 +4248,144 @@ ogg_int64_t op_pcm_tell(const OggOpusFile *_of){
   return op_get_pcm_offset(_of,gp,li);
 }
 
+int op_get_stats(const OggOpusFile *_of,OpusFileStats *_stats){
+#if defined(OP_ENABLE_STATS)
+  *_stats=*&_of->stats;
+# if !defined(OP_HAVE_CLOCK_MONOTONIC)
+  _stats->open_ns=_stats->seek_ns=_stats->read_ns=-1;
+# endif
+  return 0;
+#else
+  (void)_of;
+  (void)_stats;
+  return OP_EIMPL;
+#endif
+}
+
+void op_reset_stats(OggOpusFile *_of){
+#if defined(OP_ENABLE_STATS)
+  memset(&_of->stats,0,sizeof(_of->stats));
+#else
+  (void)_of;
+#endif
+}
+
+int op_set_seek_table_spacing(OggOpusFile *_of,opus_int32 _spacing){
+  if(OP_UNLIKELY(_spacing<0))return OP_EINVAL;
+  _of->seek_point_spacing=_spacing;
+  if(_spacing==0){
+    _ogg_free(_of->seek_points);
+    _of->seek_points=NULL;
+    _of->nseek_points=_of->cseek_points=0;
+    _of->seek_table_scan_offset=0;
+  }
+  return 0;
+}
+
+int op_build_seek_table(OggOpusFile *_of,opus_int64 _max_bytes){
+  ogg_sync_state  oy;
+  ogg_page        og;
+  OggOpusLink    *links;
+  opus_int64      offset;
+  opus_int64      end;
+  opus_int64      nread_total;
+  int             nlinks;
+  int             li;
+  int             ret;
+  if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
+  if(OP_UNLIKELY(!_of->seekable))return OP_ENOSEEK;
+  if(OP_UNLIKELY(_of->seek_point_spacing<=0))return OP_EINVAL;
+  /*This reads the whole stream anyway, so finding the rest of the links first
+     costs comparatively little.*/
+  ret=op_discover_links(_of,INT_MAX,-1,-1);
+  if(OP_UNLIKELY(ret<0))return ret;
+  links=_of->links;
+  nlinks=_of->nlinks;
+  end=_of->end;
+  offset=OP_MAX(_of->seek_table_scan_offset,links[0].data_offset);
+  if(offset>=end)return 0;
+  /*We scan with our own sync state, reading directly from the stream, so that
+     we don't disturb any decoding in progress.*/
+  if(OP_UNLIKELY(op_stream_seek(_of,offset,SEEK_SET)<0)){
+    return OP_EREAD;
+  }
+  for(li=0;li+1<nlinks&&links[li+1].offset<=offset;li++);
+  ogg_sync_init(&oy);
+  nread_total=0;
+  ret=0;
+  while(offset<end){
+    int more;
+    more=ogg_sync_pageseek(&oy,&og);
+    /*Skipped (-more) bytes.*/
+    if(OP_UNLIKELY(more<0))offset-=more;
+    else if(more==0){
+      unsigned char *buffer;
+      int            nbytes;
+      /*Only stop at a page boundary, so we can resume from there.*/
+      if(_max_bytes>0&&nread_total>=_max_bytes)break;
+      buffer=(unsigned char *)ogg_sync_buffer(&oy,OP_CHUNK_SIZE);
+      if(OP_UNLIKELY(buffer==NULL)){
+        ret=OP_EFAULT;
+        break;
+      }
+      nbytes=op_stream_read(_of,buffer,OP_CHUNK_SIZE);
+      if(OP_UNLIKELY(nbytes<0)){
+        ret=OP_EREAD;
+        break;
+      }
+      /*If the stream was truncated, there's nothing more to find.*/
+      if(OP_UNLIKELY(nbytes==0)){
+        offset=end;
+        break;
+      }
+      ogg_sync_wrote(&oy,nbytes);
+      nread_total+=nbytes;
+    }
+    else{
+      /*Find the link this page belongs to.*/
+      while(li+1<nlinks&&links[li+1].offset<=offset)li++;
+      if((ogg_uint32_t)ogg_page_serialno(&og)==links[li].serialno
+       &&offset>=links[li].data_offset&&offset<=links[li].end_offset){
+        op_seek_points_add(_of,li,&og,offset);
+      }
+      offset+=more;
+    }
+  }
+  ogg_sync_clear(&oy);
+  _of->seek_table_scan_offset=offset;
+  /*Put the position indicator back where decoding left it.*/
+  if(OP_UNLIKELY(op_stream_seek(_of,
+   op_position(_of),SEEK_SET)<0)){
+    ret=OP_EREAD;
+  }
+  if(OP_UNLIKELY(ret<0))return ret;
+  return offset<end;
+}
+
+int op_seek_table_count(const OggOpusFile *_of){
+  return _of->nseek_points;
+}
+
+int op_seek_table_get(const OggOpusFile *_of,int _i,
+ opus_int64 *_byte_offset,ogg_int64_t *_pcm_offset){
+  const OpusSeekPoint *sp;
+  if(OP_UNLIKELY(_i<0)||OP_UNLIKELY(_i>=_of->nseek_points))return OP_EINVAL;
+  sp=_of->seek_points+_i;
+  if(_byte_offset!=NULL)*_byte_offset=sp->end_offset;
+  if(_pcm_offset!=NULL)*_pcm_offset=op_get_pcm_offset(_of,sp->gp,sp->li);
+  return sp->li;
+}
+
+int op_set_decoder_snapshots(OggOpusFile *_of,opus_int32 _spacing,
+ opus_int64 _max_bytes){
+  if(OP_UNLIKELY(_spacing<0)||OP_UNLIKELY(_max_bytes<0))return OP_EINVAL;
+  _of->snapshot_spacing=_spacing;
+  _of->snapshot_max_bytes=_max_bytes;
+  if(_spacing==0)op_snapshots_clear(_of);
+  else op_snapshots_evict(_of,_max_bytes);
+  return 0;
+}
+
 void op_set_decode_callback(OggOpusFile *_of,
  op_decode_cb_func _decode_cb,void *_ctx){
   _of->decode_cb=_decode_cb;
@@ -2770,7 +4419,18 @@ void op_set_dither_enabled(OggOpusFile *_of,int _enabled){
    never need it.*/
 static int op_init_buffer(OggOpusFile *_of){
   int nchannels_max;
-  if(_of->seekable){
+  if(_of->pool!=NULL){
+    OpusDecoderPool *pool;
+    pool=_of->pool;
+    if(pool->nbuffers>0){
+      _of->od_buffer=pool->buffers[--pool->nbuffers];
+      return 0;
+    }
+    /*Buffers that go back to the pool must be usable by any stream.*/
+    nchannels_max=OP_NCHANNELS_MAX;
+  }
+  /*In lazy mode, links we haven't found yet could have any channel count.*/
+  else if(_of->seekable&&_of->link_scan==NULL){
     const OggOpusLink *links;
     int                nlinks;
     int                li;
@@ -2792,6 +4452,10 @@ static int op_init_buffer(OggOpusFile *_of){
 static int op_decode(OggOpusFile *_of,op_sample *_pcm,
  const ogg_packet *_op,int _nsamples,int _nchannels){
   int ret;
+  if(OP_UNLIKELY(!_of->od_ready)){
+    ret=op_init_decoder(_of);
+    if(OP_UNLIKELY(ret<0))return ret;
+  }
   /*First we try using the application-provided decode callback.*/
   if(_of->decode_cb!=NULL){
 #if defined(OP_FIXED_POINT)
@@ -2818,12 +4482,38 @@ static int op_decode(OggOpusFile *_of,op_sample *_pcm,
      OP_DEC_USE_DEFAULT, fail.*/
   else if(OP_UNLIKELY(ret>0))return OP_EBADPACKET;
   if(OP_UNLIKELY(ret<0))return OP_EBADPACKET;
+  OP_STATS_ADD(_of,packets_decoded,1);
   return ret;
 }
 
+/*Perform end-trimming on the next buffered packet, and advance the granule
+   position tracking past it.
+  _duration: The full duration of the packet, from its TOC sequence.
+  Return: The number of samples from the packet that should be played,
+           before accounting for any pre-skip or pre-roll.*/
+static int op_trim_packet(OggOpusFile *_of,const ogg_packet *_op,
+ int _duration){
+  ogg_int64_t diff;
+  int         trimmed_duration;
+  /*We don't buffer packets with an invalid TOC sequence.*/
+  OP_ASSERT(_duration>0);
+  trimmed_duration=_duration;
+  if(OP_UNLIKELY(_op->e_o_s)){
+    if(OP_UNLIKELY(op_granpos_cmp(_op->granulepos,_of->prev_packet_gp)<=0)){
+      trimmed_duration=0;
+    }
+    else if(OP_LIKELY(!op_granpos_diff(&diff,
+     _op->granulepos,_of->prev_packet_gp))){
+      trimmed_duration=(int)OP_MIN(diff,trimmed_duration);
+    }
+  }
+  _of->prev_packet_gp=_op->granulepos;
+  return trimmed_duration;
+}
+
 /*Read more samples from the stream, using the same API as op_read() or
    op_read_float().*/
-static int op_read_native(OggOpusFile *_of,
+static int op_read_native_impl(OggOpusFile *_of,
  op_sample *_pcm,int _buf_size,int *_li){
   if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
   for(;;){
@@ -2857,7 +4547,6 @@ static int op_read_native(OggOpusFile *_of,
       op_pos=_of->op_pos;
       if(OP_LIKELY(op_pos<_of->op_count)){
         const ogg_packet *pop;
-        ogg_int64_t       diff;
         opus_int32        cur_discard_count;
         int               duration;
         int               trimmed_duration;
@@ -2865,21 +4554,7 @@ static int op_read_native(OggOpusFile *_of,
         _of->op_pos=op_pos;
         cur_discard_count=_of->cur_discard_count;
         duration=op_get_packet_duration(pop->packet,pop->bytes);
-        /*We don't buffer packets with an invalid TOC sequence.*/
-        OP_ASSERT(duration>0);
-        trimmed_duration=duration;
-        /*Perform end-trimming.*/
-        if(OP_UNLIKELY(pop->e_o_s)){
-          if(OP_UNLIKELY(op_granpos_cmp(pop->granulepos,
-           _of->prev_packet_gp)<=0)){
-            trimmed_duration=0;
-          }
-          else if(OP_LIKELY(!op_granpos_diff(&diff,
-           pop->granulepos,_of->prev_packet_gp))){
-            trimmed_duration=(int)OP_MIN(diff,trimmed_duration);
-          }
-        }
-        _of->prev_packet_gp=pop->granulepos;
+        trimmed_duration=op_trim_packet(_of,pop,duration);
         if(OP_UNLIKELY(duration*nchannels>_buf_size)){
           op_sample *buf;
           /*If the user's buffer is too small, decode into a scratch buffer.*/
@@ -2895,6 +4570,9 @@ static int op_read_native(OggOpusFile *_of,
           od_buffer_pos=(int)OP_MIN(trimmed_duration,cur_discard_count);
           cur_discard_count-=od_buffer_pos;
           _of->cur_discard_count=cur_discard_count;
+          OP_STATS_ADD(_of,samples_discarded,od_buffer_pos);
+          OP_STATS_ADD(_of,packets_discarded,
+           od_buffer_pos>0&&od_buffer_pos>=trimmed_duration);
           _of->od_buffer_pos=od_buffer_pos;
           _of->od_buffer_size=trimmed_duration;
           /*Update bitrate tracking based on the actual samples we used from
@@ -2913,6 +4591,9 @@ static int op_read_native(OggOpusFile *_of,
             cur_discard_count-=od_buffer_pos;
             _of->cur_discard_count=cur_discard_count;
             trimmed_duration-=od_buffer_pos;
+            OP_STATS_ADD(_of,samples_discarded,od_buffer_pos);
+            OP_STATS_ADD(_of,packets_discarded,
+             od_buffer_pos>0&&trimmed_duration<=0);
             if(OP_LIKELY(trimmed_duration>0)
              &&OP_UNLIKELY(od_buffer_pos>0)){
               memmove(_pcm,_pcm+od_buffer_pos*nchannels,
@@ -2933,6 +4614,8 @@ static int op_read_native(OggOpusFile *_of,
         continue;
       }
     }
+    /*We're at a page boundary: remember the decoder state, if requested.*/
+    if(_of->snapshot_spacing>0)op_snapshot_take(_of);
     /*Suck in another page.*/
     ret=op_fetch_and_process_page(_of,NULL,-1,1,0);
     if(OP_UNLIKELY(ret==OP_EOF)){
@@ -2943,6 +4626,278 @@ static int op_read_native(OggOpusFile *_of,
   }
 }
 
+/*The minimum amount of audio to decode at once for reverse playback.
+  Each block costs 80 ms of pre-roll, so this keeps the overhead under 10%
+   compared to forward playback.*/
+#define OP_REVERSE_BLOCK_SIZE (48000)
+
+/*Find the last page in link _li with a granule position no larger than
+   _target_gp, walking backwards through the stream from rev_scan_end.
+  The pages found along the way are kept in rev_pages, so that each part of
+   the link only needs to be scanned once during reverse playback.
+  [out] _sp: Returns the location of the page that was found.
+  Return: 1 if we found a page, 0 if there is no such page in the link, or a
+           negative value on failure.*/
+static int op_reverse_find_page(OggOpusFile *_of,int _li,
+ ogg_int64_t _target_gp,OpusSeekPoint *_sp){
+  const OggOpusLink *link;
+  opus_int32         chunk_size;
+  link=_of->links+_li;
+  OP_ASSERT(_of->rev_li==_li);
+  chunk_size=OP_CHUNK_SIZE;
+  for(;;){
+    OpusSeekPoint *rev_pages;
+    ogg_page       og;
+    opus_int64     begin;
+    opus_int64     end;
+    opus_int64     first;
+    int            nrev_pages;
+    int            nnew;
+    int            pi;
+    int            ret;
+    rev_pages=_of->rev_pages;
+    nrev_pages=_of->nrev_pages;
+    for(pi=nrev_pages;pi-->0;){
+      if(op_granpos_cmp(rev_pages[pi].gp,_target_gp)<=0){
+        *_sp=*(rev_pages+pi);
+        /*We'll never need the pages after this one again.
+          The next search starts from the end of this page.*/
+        _of->nrev_pages=pi+1;
+        _of->rev_scan_end=rev_pages[pi].end_offset;
+        return 1;
+      }
+    }
+    begin=_of->rev_scan_begin;
+    if(begin<=link->data_offset)return 0;
+    /*Scan the previous chunk.
+      We read up to a page past the start of the range we already covered, to
+       pick up any page that straddles it.*/
+    end=OP_MIN(OP_ADV_OFFSET(begin,OP_PAGE_SIZE_MAX-1),_of->rev_scan_end);
+    begin=OP_MAX(begin-chunk_size,link->data_offset);
+    first=nrev_pages>0?rev_pages[0].page_offset:end;
+    ret=op_seek_helper(_of,begin);
+    if(OP_UNLIKELY(ret<0))return ret;
+    OP_STATS_ADD(_of,prev_page_chunks,1);
+    nnew=0;
+    while(_of->offset<end){
+      opus_int64  llret;
+      ogg_int64_t gp;
+      llret=op_get_next_page(_of,&og,end);
+      if(OP_UNLIKELY(llret<OP_FALSE))return (int)llret;
+      else if(llret==OP_FALSE||llret>=first)break;
+      if(link->serialno!=(ogg_uint32_t)ogg_page_serialno(&og))continue;
+      gp=ogg_page_granulepos(&og);
+      if(gp==-1||ogg_page_packets(&og)<=0)continue;
+      op_seek_points_add(_of,_li,&og,llret);
+      if(OP_UNLIKELY(nrev_pages+nnew>=_of->crev_pages)){
+        int crev_pages;
+        crev_pages=_of->crev_pages;
+        if(OP_UNLIKELY(crev_pages>INT_MAX-1>>1))return OP_EFAULT;
+        crev_pages=2*crev_pages+1;
+        rev_pages=(OpusSeekPoint *)_ogg_realloc(rev_pages,
+         sizeof(*rev_pages)*crev_pages);
+        if(OP_UNLIKELY(rev_pages==NULL))return OP_EFAULT;
+        _of->rev_pages=rev_pages;
+        _of->crev_pages=crev_pages;
+      }
+      /*Append the new pages for now, and rotate them into place below.*/
+      rev_pages[nrev_pages+nnew].page_offset=llret;
+      rev_pages[nrev_pages+nnew].end_offset=_of->offset;
+      rev_pages[nrev_pages+nnew].gp=gp;
+      rev_pages[nrev_pages+nnew].li=_li;
+      rev_pages[nrev_pages+nnew].continued=op_page_continues(&og);
+      nnew++;
+    }
+    if(nnew>0){
+      OpusSeekPoint *tmp;
+      tmp=(OpusSeekPoint *)_ogg_malloc(sizeof(*tmp)*nnew);
+      if(OP_UNLIKELY(tmp==NULL))return OP_EFAULT;
+      memcpy(tmp,rev_pages+nrev_pages,sizeof(*tmp)*nnew);
+      memmove(rev_pages+nnew,rev_pages,sizeof(*rev_pages)*nrev_pages);
+      memcpy(rev_pages,tmp,sizeof(*tmp)*nnew);
+      _ogg_free(tmp);
+      _of->nrev_pages=nrev_pages+nnew;
+    }
+    _of->rev_scan_begin=begin;
+    /*Bump up the chunk size, as in op_get_prev_page_serial().*/
+    chunk_size=OP_MIN(2*chunk_size,OP_CHUNK_SIZE_MAX);
+  }
+}
+
+/*Decode the block of audio ending at rev_pos into rev_buf for reverse
+   playback.
+  Return: The number of samples (per channel) decoded, 0 if we're at the start
+           of the stream, or a negative value on failure.*/
+static int op_reverse_fill(OggOpusFile *_of){
+  const OggOpusLink *link;
+  OpusSeekPoint      sp;
+  ogg_int64_t        end_gp;
+  ogg_int64_t        start_gp;
+  ogg_int64_t        pre_skip_gp;
+  ogg_int64_t        target_gp;
+  ogg_int64_t        diff;
+  opus_int32         discard;
+  opus_int32         spacing;
+  int                nchannels;
+  int                nsamples;
+  int                nread;
+  int                li;
+  int                ret;
+  if(_of->rev_pos<=0)return 0;
+  /*Find the link containing the last sample we want.*/
+  end_gp=op_get_granulepos(_of,_of->rev_pos-1,&li);
+  if(OP_UNLIKELY(end_gp==-1))return OP_EINVAL;
+  OP_ALWAYS_TRUE(!op_granpos_add(&end_gp,end_gp,1));
+  link=_of->links+li;
+  if(li!=_of->rev_li){
+    /*Start a new walk through this link, from the end of the data we last
+       decoded in it, if we can.*/
+    _of->rev_li=li;
+    _of->nrev_pages=0;
+    _of->rev_scan_begin=_of->rev_scan_end=link->end_offset;
+    if(_of->ready_state>=OP_INITSET&&_of->cur_link==li
+     &&_of->offset>link->data_offset&&_of->offset<link->end_offset){
+      _of->rev_scan_begin=_of->rev_scan_end=_of->offset;
+    }
+  }
+  nchannels=link->head.channel_count;
+  OP_ALWAYS_TRUE(!op_granpos_add(&pre_skip_gp,
+   link->pcm_start,link->head.pre_skip));
+  /*Unless we find a better place below, decode from the start of the link.*/
+  sp.page_offset=sp.end_offset=link->data_offset;
+  sp.gp=link->pcm_start;
+  sp.li=li;
+  sp.continued=0;
+  discard=link->head.pre_skip;
+  /*Look for a page far enough back to give us a full block after the
+     pre-roll.*/
+  if(!op_granpos_add(&target_gp,end_gp,-OP_REVERSE_BLOCK_SIZE-80*48)
+   &&op_granpos_cmp(target_gp,pre_skip_gp)>=0){
+    ret=op_reverse_find_page(_of,li,target_gp,&sp);
+    if(OP_UNLIKELY(ret<0))return ret;
+    if(ret>0){
+      /*Discard 80 ms of pre-roll, or to the end of the pre-skip region, if
+         that's farther.*/
+      OP_ALWAYS_TRUE(!op_granpos_diff(&diff,pre_skip_gp,sp.gp));
+      discard=(opus_int32)OP_CLAMP(80*48,diff,OP_INT32_MAX);
+    }
+  }
+  start_gp=sp.gp;
+  OP_ALWAYS_TRUE(!op_granpos_diff(&diff,end_gp,start_gp));
+  if(OP_UNLIKELY(diff<=discard)||OP_UNLIKELY(diff-discard>OP_INT32_MAX/8)){
+    return OP_EBADLINK;
+  }
+  nsamples=(int)(diff-discard);
+  if(nsamples*nchannels>_of->rev_cbuf){
+    op_sample *rev_buf;
+    rev_buf=(op_sample *)_ogg_realloc(_of->rev_buf,
+     sizeof(*rev_buf)*nsamples*nchannels);
+    if(OP_UNLIKELY(rev_buf==NULL))return OP_EFAULT;
+    _of->rev_buf=rev_buf;
+    _of->rev_cbuf=nsamples*nchannels;
+  }
+  ret=op_seek_to_page(_of,li,sp.page_offset,sp.end_offset,
+   start_gp,sp.continued);
+  if(OP_UNLIKELY(ret<0))return ret;
+  _of->cur_discard_count=discard;
+  /*The dithering state will not match a forward decode, so don't take any
+     snapshots of it.*/
+  spacing=_of->snapshot_spacing;
+  _of->snapshot_spacing=0;
+  for(nread=0;nread<nsamples;){
+    int li_read;
+    ret=op_read_native_impl(_of,_of->rev_buf+nread*nchannels,
+     (nsamples-nread)*nchannels,&li_read);
+    if(ret==OP_HOLE)continue;
+    if(ret<=0||li_read!=li)break;
+    nread+=ret;
+  }
+  _of->snapshot_spacing=spacing;
+  if(OP_UNLIKELY(ret<0)&&ret!=OP_HOLE)return ret;
+  if(OP_UNLIKELY(nread<=0))return OP_EBADLINK;
+  /*If the stream ended early, return what we got.
+    The block still starts nsamples before rev_pos, so it ends early, too, and
+     we skip over the samples we couldn't decode.*/
+  _of->rev_pos-=nsamples-nread;
+  _of->rev_size=nread;
+  return nread;
+}
+
+/*Stop reading in reverse, and continue forward from wherever reverse playback
+   left off.*/
+static int op_reverse_end(OggOpusFile *_of){
+  _of->rev_active=0;
+  _of->rev_li=-1;
+  _of->rev_size=0;
+  /*We can't seek to the very end with op_pcm_seek(), but a raw seek there
+     does the same thing.*/
+  if(_of->link_scan==NULL&&_of->rev_pos>=op_pcm_total(_of,-1)){
+    return op_raw_seek_impl(_of,_of->end);
+  }
+  return op_pcm_seek_impl(_of,_of->rev_pos);
+}
+
+/*Time the reads for op_get_stats().*/
+static int op_read_native(OggOpusFile *_of,
+ op_sample *_pcm,int _buf_size,int *_li){
+  opus_int64 start;
+  int        ret;
+  start=OP_STATS_CLOCK();
+  ret=0;
+  if(OP_UNLIKELY(_of->rev_active))ret=op_reverse_end(_of);
+  if(OP_LIKELY(ret>=0))ret=op_read_native_impl(_of,_pcm,_buf_size,_li);
+  OP_STATS_ADD(_of,read_ns,OP_STATS_CLOCK()-start);
+  return ret;
+}
+
+int op_read_packet(OggOpusFile *_of,ogg_packet *_op,OpusPacketInfo *_info){
+  if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
+  if(OP_UNLIKELY(_of->rev_active)){
+    int ret;
+    ret=op_reverse_end(_of);
+    if(OP_UNLIKELY(ret<0))return ret;
+  }
+  /*Any samples still buffered by op_read() came from packets we've already
+     consumed, so the caller can't get them back in packet form.*/
+  _of->od_buffer_pos=_of->od_buffer_size;
+  for(;;){
+    int ret;
+    if(OP_LIKELY(_of->ready_state>=OP_INITSET)){
+      int op_pos;
+      op_pos=_of->op_pos;
+      if(OP_LIKELY(op_pos<_of->op_count)){
+        const ogg_packet *pop;
+        opus_int32        cur_discard_count;
+        int               duration;
+        int               trimmed_duration;
+        int               discard;
+        pop=_of->op+op_pos++;
+        _of->op_pos=op_pos;
+        duration=op_get_packet_duration(pop->packet,pop->bytes);
+        trimmed_duration=op_trim_packet(_of,pop,duration);
+        /*Account for pre-skip/pre-roll the same way op_read_native() does.*/
+        cur_discard_count=_of->cur_discard_count;
+        discard=(int)OP_MIN(trimmed_duration,cur_discard_count);
+        _of->cur_discard_count=cur_discard_count-discard;
+        _of->bytes_tracked+=pop->bytes;
+        _of->samples_tracked+=trimmed_duration-discard;
+        *_op=*pop;
+        if(_info!=NULL){
+          _info->duration=duration;
+          _info->trimmed_duration=trimmed_duration;
+          _info->discard=discard;
+          _info->li=_of->cur_link;
+        }
+        return (int)pop->bytes;
+      }
+    }
+    /*Suck in another page.*/
+    ret=op_fetch_and_process_page(_of,NULL,-1,1,0);
+    if(OP_UNLIKELY(ret==OP_EOF))return 0;
+    if(OP_UNLIKELY(ret<0))return ret;
+  }
+}
+
 /*A generic filter to apply to the decoded audio data.
   _src is non-const because we will destructively modify the contents of the
    source buffer that we consume in some cases.*/
@@ -2975,6 +4930,64 @@ static int op_filter_read_native(OggOpusFile *_of,void *_dst,int _dst_sz,
   return ret;
 }
 
+/*Return some samples from the end of the audio not yet returned by reverse
+   reads, decoding another block first if necessary, and apply a custom filter
+   to them.
+  The samples are handed to the filter in reverse order.*/
+static int op_filter_read_reverse(OggOpusFile *_of,void *_dst,int _dst_sz,
+ op_read_filter_func _filter,int *_li){
+  op_sample *src;
+  int        nchannels;
+  int        nsamples;
+  int        i;
+  int        ret;
+  if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
+  if(OP_UNLIKELY(!_of->seekable))return OP_ENOSEEK;
+  if(!_of->rev_active){
+    /*Start from the current position.*/
+    _of->rev_pos=op_pcm_tell(_of);
+    _of->rev_size=0;
+    _of->rev_li=-1;
+    _of->rev_active=1;
+  }
+  if(_of->rev_size<=0){
+    ret=op_reverse_fill(_of);
+    if(ret<=0)return ret;
+  }
+  nchannels=_of->links[_of->rev_li].head.channel_count;
+  nsamples=OP_MIN(_of->rev_size,_dst_sz/nchannels);
+  if(OP_UNLIKELY(nsamples<=0))return OP_EINVAL;
+  src=_of->rev_buf+(_of->rev_size-nsamples)*nchannels;
+  for(i=0;i<nsamples>>1;i++){
+    op_sample *a;
+    op_sample *b;
+    int        ci;
+    a=src+i*nchannels;
+    b=src+(nsamples-1-i)*nchannels;
+    for(ci=0;ci<nchannels;ci++){
+      op_sample t;
+      t=a[ci];
+      a[ci]=b[ci];
+      b[ci]=t;
+    }
+  }
+  ret=(*_filter)(_of,_dst,_dst_sz,src,nsamples,nchannels);
+  OP_ASSERT(ret==nsamples);
+  _of->rev_size-=nsamples;
+  _of->rev_pos-=nsamples;
+  if(_li!=NULL)*_li=_of->rev_li;
+  return nsamples;
+}
+
+/*A filter that copies the samples unchanged.*/
+static int op_copy_filter(OggOpusFile *_of,void *_dst,int _dst_sz,
+ op_sample *_src,int _nsamples,int _nchannels){
+  (void)_of;
+  if(OP_UNLIKELY(_nsamples*_nchannels>_dst_sz))_nsamples=_dst_sz/_nchannels;
+  memcpy(_dst,_src,sizeof(*_src)*_nsamples*_nchannels);
+  return _nsamples;
+}
+
 #if !defined(OP_FIXED_POINT)||!defined(OP_DISABLE_FLOAT_API)
 
 /*Matrices for downmixing from the supported channel counts to stereo.
@@ -3093,6 +5106,10 @@ int op_read_stereo(OggOpusFile *_of,opus_int16 *_pcm,int _buf_size){
   return op_filter_read_native(_of,_pcm,_buf_size,op_stereo_filter,NULL);
 }
 
+int op_read_reverse(OggOpusFile *_of,opus_int16 *_pcm,int _buf_size,int *_li){
+  return op_filter_read_reverse(_of,_pcm,_buf_size,op_copy_filter,_li);
+}
+
 # if !defined(OP_DISABLE_FLOAT_API)
 
 static int op_short2float_filter(OggOpusFile *_of,void *_dst,int _dst_sz,
@@ -3156,6 +5173,11 @@ int op_read_float_stereo(OggOpusFile *_of,float *_pcm,int _buf_size){
    op_short2float_stereo_filter,NULL);
 }
 
+int op_read_reverse_float(OggOpusFile *_of,
+ float *_pcm,int _buf_size,int *_li){
+  return op_filter_read_reverse(_of,_pcm,_buf_size,op_short2float_filter,_li);
+}
+
 # endif
 
 #else
@@ -3208,6 +5230,93 @@ static const float OP_FCOEF_A[4]={
   0.9030F,0.0116F,-0.5853F,-0.2571F
 };
 
+/*Vectorize the quantization across channels with SSE2 when it will give
+   exactly the same results as the scalar code.
+  That requires lrintf() (so both round to nearest even in the current
+   rounding mode), and scalar float math done in single precision, which is
+   always the case on x86-64.
+  It also requires that the compiler not contract the scalar multiply-adds
+   below into fused ones or reorder them.
+  Without -ffast-math, nothing gets reordered, but clang contracts by default
+   (even in ISO C modes), as does gcc in GNU modes, as soon as FMA
+   instructions are available, so we fall back to the scalar code then.*/
+# if defined(OP_HAVE_LRINTF)&&!defined(__FAST_MATH__)&&!defined(__FMA__) \
+ &&(defined(_M_X64)||defined(__SSE2__) \
+ &&defined(__FLT_EVAL_METHOD__)&&__FLT_EVAL_METHOD__==0)
+#  define OP_DITHER_SSE2 (1)
+#  include <emmintrin.h>
+# endif
+
+/*Run the noise shaping filter and quantize one sample of channel _ci.*/
+static opus_int16 op_shape_quantize(float *_dither_a,
+ float *_dither_b,int _ci,float _s,float _r,int _mute){
+  float err;
+  int   si;
+  int   j;
+  _s*=OP_GAIN;
+  err=0;
+  for(j=0;j<4;j++){
+    err+=OP_FCOEF_B[j]*_dither_b[j*OP_NCHANNELS_MAX+_ci]
+     -OP_FCOEF_A[j]*_dither_a[j*OP_NCHANNELS_MAX+_ci];
+  }
+  for(j=3;j-->0;){
+    _dither_a[(j+1)*OP_NCHANNELS_MAX+_ci]=_dither_a[j*OP_NCHANNELS_MAX+_ci];
+    _dither_b[(j+1)*OP_NCHANNELS_MAX+_ci]=_dither_b[j*OP_NCHANNELS_MAX+_ci];
+  }
+  _dither_a[_ci]=err;
+  _s-=err;
+  /*Clamp in float out of paranoia that the input will be > 96 dBFS and wrap
+     if the integer is clamped.*/
+  si=op_float2int(OP_CLAMP(-32768,_s+_r,32767));
+  /*Including clipping in the noise shaping is generally disastrous: the futile
+     effort to restore the clipped energy results in more clipping.
+    However, small amounts---at the level which could normally be created by
+     dither and rounding---are harmless and can even reduce clipping somewhat
+     due to the clipping sometimes reducing the dither + rounding error.*/
+  _dither_b[_ci]=_mute>16?0:OP_CLAMP(-1.5F,si-_s,1.5F);
+  return (opus_int16)si;
+}
+
+# if defined(OP_DITHER_SSE2)
+/*The same as op_shape_quantize(), but for the four channels starting at _ci.
+  Every operation is done in the same order as the scalar version, and
+   _mm_min_ps()/_mm_max_ps() pick the same operand as OP_MIN()/OP_MAX() when
+   given a NaN, so the output is bit-identical.*/
+static void op_shape_quantize4(float *_dither_a,float *_dither_b,
+ int _ci,opus_int16 *_dst,const float *_src,const float *_r,int _mute){
+  __m128 s;
+  __m128 err;
+  __m128 t;
+  __m128 a[4];
+  __m128 b[4];
+  __m128i si;
+  int     j;
+  s=_mm_mul_ps(_mm_loadu_ps(_src),_mm_set1_ps(OP_GAIN));
+  err=_mm_setzero_ps();
+  for(j=0;j<4;j++){
+    a[j]=_mm_loadu_ps(_dither_a+j*OP_NCHANNELS_MAX+_ci);
+    b[j]=_mm_loadu_ps(_dither_b+j*OP_NCHANNELS_MAX+_ci);
+    err=_mm_add_ps(err,_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(OP_FCOEF_B[j]),b[j]),
+     _mm_mul_ps(_mm_set1_ps(OP_FCOEF_A[j]),a[j])));
+  }
+  for(j=3;j-->0;){
+    _mm_storeu_ps(_dither_a+(j+1)*OP_NCHANNELS_MAX+_ci,a[j]);
+    _mm_storeu_ps(_dither_b+(j+1)*OP_NCHANNELS_MAX+_ci,b[j]);
+  }
+  _mm_storeu_ps(_dither_a+_ci,err);
+  s=_mm_sub_ps(s,err);
+  t=_mm_min_ps(_mm_add_ps(s,_mm_loadu_ps(_r)),_mm_set1_ps(32767));
+  si=_mm_cvtps_epi32(_mm_max_ps(_mm_set1_ps(-32768),t));
+  _mm_storel_epi64((__m128i *)_dst,_mm_packs_epi32(si,si));
+  if(_mute>16)t=_mm_setzero_ps();
+  else{
+    t=_mm_min_ps(_mm_sub_ps(_mm_cvtepi32_ps(si),s),_mm_set1_ps(1.5F));
+    t=_mm_max_ps(_mm_set1_ps(-1.5F),t);
+  }
+  _mm_storeu_ps(_dither_b+_ci,t);
+}
+# endif
+
 static int op_float2short_filter(OggOpusFile *_of,void *_dst,int _dst_sz,
  float *_src,int _nsamples,int _nchannels){
   opus_int16 *dst;
@@ -3222,11 +5331,25 @@ static int op_float2short_filter(OggOpusFile *_of,void *_dst,int _dst_sz,
   opus_pcm_soft_clip(_src,_nsamples,_nchannels,_of->clip_state);
 # endif
   if(_of->dither_disabled){
-    for(i=0;i<_nchannels*_nsamples;i++){
+    i=0;
+# if defined(OP_DITHER_SSE2)
+    for(;i+8<=_nchannels*_nsamples;i+=8){
+      __m128 lo;
+      __m128 hi;
+      lo=_mm_mul_ps(_mm_loadu_ps(_src+i),_mm_set1_ps(32768.0F));
+      hi=_mm_mul_ps(_mm_loadu_ps(_src+i+4),_mm_set1_ps(32768.0F));
+      lo=_mm_max_ps(_mm_set1_ps(-32768),_mm_min_ps(lo,_mm_set1_ps(32767)));
+      hi=_mm_max_ps(_mm_set1_ps(-32768),_mm_min_ps(hi,_mm_set1_ps(32767)));
+      _mm_storeu_si128((__m128i *)(dst+i),
+       _mm_packs_epi32(_mm_cvtps_epi32(lo),_mm_cvtps_epi32(hi)));
+    }
+# endif
+    for(;i<_nchannels*_nsamples;i++){
       dst[i]=op_float2int(OP_CLAMP(-32768,32768.0F*_src[i],32767));
     }
   }
   else{
+    float       r[OP_NCHANNELS_MAX];
     opus_uint32 seed;
     int         mute;
     seed=_of->dither_seed;
@@ -3234,46 +5357,32 @@ static int op_float2short_filter(OggOpusFile *_of,void *_dst,int _dst_sz,
     if(_of->state_channel_count!=_nchannels)mute=65;
     /*In order to avoid replacing digital silence with quiet dither noise, we
        mute if the output has been silent for a while.*/
-    if(mute>64)memset(_of->dither_a,0,sizeof(*_of->dither_a)*4*_nchannels);
+    if(mute>64)memset(_of->dither_a,0,sizeof(_of->dither_a));
     for(i=0;i<_nsamples;i++){
       int silent;
+      /*The dither for each channel comes from a single serial PRNG, so
+         generate it all up front.*/
       silent=1;
       for(ci=0;ci<_nchannels;ci++){
-        float r;
-        float s;
-        float err;
-        int   si;
-        int   j;
-        s=_src[_nchannels*i+ci];
-        silent&=s==0;
-        s*=OP_GAIN;
-        err=0;
-        for(j=0;j<4;j++){
-          err+=OP_FCOEF_B[j]*_of->dither_b[ci*4+j]
-           -OP_FCOEF_A[j]*_of->dither_a[ci*4+j];
-        }
-        for(j=3;j-->0;)_of->dither_a[ci*4+j+1]=_of->dither_a[ci*4+j];
-        for(j=3;j-->0;)_of->dither_b[ci*4+j+1]=_of->dither_b[ci*4+j];
-        _of->dither_a[ci*4]=err;
-        s-=err;
-        if(mute>16)r=0;
+        silent&=_src[_nchannels*i+ci]==0;
+        if(mute>16)r[ci]=0;
         else{
           seed=op_rand(seed);
-          r=seed*OP_PRNG_GAIN;
+          r[ci]=seed*OP_PRNG_GAIN;
           seed=op_rand(seed);
-          r-=seed*OP_PRNG_GAIN;
+          r[ci]-=seed*OP_PRNG_GAIN;
         }
-        /*Clamp in float out of paranoia that the input will be > 96 dBFS and
-           wrap if the integer is clamped.*/
-        si=op_float2int(OP_CLAMP(-32768,s+r,32767));
-        dst[_nchannels*i+ci]=(opus_int16)si;
-        /*Including clipping in the noise shaping is generally disastrous: the
-           futile effort to restore the clipped energy results in more clipping.
-          However, small amounts---at the level which could normally be created
-           by dither and rounding---are harmless and can even reduce clipping
-           somewhat due to the clipping sometimes reducing the dither + rounding
-           error.*/
-        _of->dither_b[ci*4]=mute>16?0:OP_CLAMP(-1.5F,si-s,1.5F);
+      }
+      ci=0;
+# if defined(OP_DITHER_SSE2)
+      for(;ci+4<=_nchannels;ci+=4){
+        op_shape_quantize4(_of->dither_a,_of->dither_b,ci,
+         dst+_nchannels*i+ci,_src+_nchannels*i+ci,r+ci,mute);
+      }
+# endif
+      for(;ci<_nchannels;ci++){
+        dst[_nchannels*i+ci]=op_shape_quantize(_of->dither_a,_of->dither_b,
+         ci,_src[_nchannels*i+ci],r[ci],mute);
       }
       mute++;
       if(!silent)mute=0;
@@ -3294,6 +5403,16 @@ int op_read_float(OggOpusFile *_of,float *_pcm,int _buf_size,int *_li){
   return op_read_native(_of,_pcm,_buf_size,_li);
 }
 
+int op_read_reverse(OggOpusFile *_of,opus_int16 *_pcm,int _buf_size,int *_li){
+  return op_filter_read_reverse(_of,_pcm,_buf_size,op_float2short_filter,_li);
+}
+
+int op_read_reverse_float(OggOpusFile *_of,
+ float *_pcm,int _buf_size,int *_li){
+  _of->state_channel_count=0;
+  return op_filter_read_reverse(_of,_pcm,_buf_size,op_copy_filter,_li);
+}
+
 static int op_stereo_filter(OggOpusFile *_of,void *_dst,int _dst_sz,
  op_sample *_src,int _nsamples,int _nchannels){
   (void)_of;
@@ -3355,3 +5474,253 @@ int op_read_float_stereo(OggOpusFile *_of,float *_pcm,int _buf_size){
 }
 
 #endif
+
+#if !defined(OP_FIXED_POINT)||!defined(OP_DISABLE_FLOAT_API)
+
+int op_decode_range_float(OggOpusFile *_of,ogg_int64_t _pcm_start,
+ ogg_int64_t _pcm_end,float *_pcm,int _buf_size){
+  ogg_int64_t left;
+  int         nchannels;
+  int         nsamples;
+  int         ret;
+  if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
+  if(OP_UNLIKELY(!_of->seekable))return OP_ENOSEEK;
+  if(OP_UNLIKELY(_pcm_start<0)||OP_UNLIKELY(_pcm_end<_pcm_start)){
+    return OP_EINVAL;
+  }
+  ret=op_pcm_seek(_of,_pcm_start);
+  if(OP_UNLIKELY(ret<0))return ret;
+  /*op_pcm_seek() leaves cur_link pointing at the link containing the target.*/
+  nchannels=op_channel_count(_of,-1);
+  left=_pcm_end-_pcm_start;
+  nsamples=0;
+  while(left>0){
+    int buf_size;
+    int li;
+    buf_size=_buf_size-nsamples*nchannels;
+    if(buf_size<nchannels)break;
+    if(left<buf_size/nchannels)buf_size=(int)left*nchannels;
+    ret=op_read_float(_of,_pcm+nsamples*nchannels,buf_size,&li);
+    if(OP_UNLIKELY(ret<0)){
+      /*Sequential decoding just carries on after a hole, so we do the same.*/
+      if(ret==OP_HOLE)continue;
+      /*Report other errors only if we have nothing to return.*/
+      return nsamples>0?nsamples:ret;
+    }
+    /*End of file.*/
+    if(ret==0)break;
+    /*Stop at a link with a different channel count, since its samples would
+       not fit the layout of the ones we already returned.
+      The caller can pick up from here with another call.*/
+    if(op_channel_count(_of,li)!=nchannels)break;
+    nsamples+=ret;
+    left-=ret;
+  }
+  return nsamples;
+}
+
+/*The shortest segment op_decode_range_parallel() will hand to a worker, in
+   samples (10 seconds).
+  Each segment costs an open, a seek, and 80 ms of pre-roll, so segments much
+   shorter than this spend more time getting started than decoding.*/
+#define OP_PARALLEL_SEGMENT_MIN (10*48000)
+
+typedef struct OpusDecodeRangeJob OpusDecodeRangeJob;
+
+/*One segment of a parallel decode.*/
+struct OpusDecodeRangeJob{
+  /*The stream to decode with, or NULL to open our own from the data below.*/
+  OggOpusFile         *of;
+  /*The stream data and link index used to open our own stream.*/
+  const unsigned char *data;
+  size_t               size;
+  const unsigned char *index;
+  size_t               index_size;
+  /*The gain settings to copy to our own stream.*/
+  int                  gain_type;
+  opus_int32           gain_offset_q8;
+  /*The segment to decode, and where to put it.*/
+  ogg_int64_t          pcm_start;
+  ogg_int64_t          pcm_end;
+  float               *pcm;
+  int                  buf_size;
+  /*The return value of op_decode_range_float(), or a negative value if we
+     could not open the stream.*/
+  int                  ret;
+};
+
+static void op_decode_range_job_run(OpusDecodeRangeJob *_job){
+  OggOpusFile *of;
+  int          ret;
+  of=_job->of;
+  if(of==NULL){
+    of=op_open_memory_with_index(_job->data,_job->size,
+     _job->index,_job->index_size,&ret);
+    if(OP_UNLIKELY(of==NULL)){
+      _job->ret=ret;
+      return;
+    }
+    op_set_gain_offset(of,_job->gain_type,_job->gain_offset_q8);
+  }
+  _job->ret=op_decode_range_float(of,_job->pcm_start,_job->pcm_end,
+   _job->pcm,_job->buf_size);
+  if(of!=_job->of)op_free(of);
+}
+
+#if defined(OP_HAVE_PTHREAD)
+typedef pthread_t OpusThread;
+
+static void *op_decode_range_thread(void *_job){
+  op_decode_range_job_run((OpusDecodeRangeJob *)_job);
+  return NULL;
+}
+
+/*Return: 0 on success, or a negative value if the thread could not be
+   started, in which case the caller must run the job itself.*/
+static int op_thread_start(OpusThread *_thread,OpusDecodeRangeJob *_job){
+  return pthread_create(_thread,NULL,op_decode_range_thread,_job)?-1:0;
+}
+
+static void op_thread_join(OpusThread *_thread){
+  pthread_join(*_thread,NULL);
+}
+#elif defined(_WIN32)
+typedef HANDLE OpusThread;
+
+static DWORD WINAPI op_decode_range_thread(LPVOID _job){
+  op_decode_range_job_run((OpusDecodeRangeJob *)_job);
+  return 0;
+}
+
+static int op_thread_start(OpusThread *_thread,OpusDecodeRangeJob *_job){
+  *_thread=CreateThread(NULL,0,op_decode_range_thread,_job,0,NULL);
+  return *_thread==NULL?-1:0;
+}
+
+static void op_thread_join(OpusThread *_thread){
+  WaitForSingleObject(*_thread,INFINITE);
+  CloseHandle(*_thread);
+}
+#else
+/*Without threads, every job runs on the calling thread, one after another.*/
+typedef int OpusThread;
+
+static int op_thread_start(OpusThread *_thread,OpusDecodeRangeJob *_job){
+  (void)_thread;
+  (void)_job;
+  return -1;
+}
+
+static void op_thread_join(OpusThread *_thread){
+  (void)_thread;
+}
+#endif
+
+int op_decode_range_parallel(OggOpusFile *_of,ogg_int64_t _pcm_start,
+ ogg_int64_t _pcm_end,float *_pcm,int _buf_size,int _nthreads){
+  OpusDecodeRangeJob *jobs;
+  OpusThread         *threads;
+  unsigned char      *index;
+  size_t              index_size;
+  ogg_int64_t         pcm_total;
+  ogg_int64_t         nsamples;
+  int                 nsegments;
+  int                 nchannels;
+  int                 nlinks;
+  int                 ret;
+  int                 li;
+  int                 si;
+  if(OP_UNLIKELY(_of->ready_state<OP_OPENED))return OP_EINVAL;
+  if(OP_UNLIKELY(!_of->seekable))return OP_ENOSEEK;
+  if(OP_UNLIKELY(_pcm_start<0)||OP_UNLIKELY(_pcm_end<_pcm_start)
+   ||OP_UNLIKELY(_nthreads<1)){
+    return OP_EINVAL;
+  }
+  /*We need every link to know how far the range can go, and to build the
+     index the workers open their streams with.*/
+  ret=op_discover_links(_of,INT_MAX,-1,-1);
+  if(OP_UNLIKELY(ret<0))return ret;
+  nlinks=_of->nlinks;
+  pcm_total=op_pcm_total(_of,-1);
+  if(OP_UNLIKELY(pcm_total<0))return (int)pcm_total;
+  if(_pcm_start>=pcm_total)return 0;
+  /*Clip the range to the end of the stream, the end of the buffer, and the
+     first link with a different channel count than the one it starts in, as
+     op_decode_range_float() would.*/
+  for(li=nlinks;li-->1&&_of->links[li].pcm_file_offset>_pcm_start;);
+  nchannels=_of->links[li].head.channel_count;
+  while(++li<nlinks&&_of->links[li].head.channel_count==nchannels);
+  if(li<nlinks)pcm_total=_of->links[li].pcm_file_offset;
+  nsamples=OP_MIN(_pcm_end,pcm_total)-_pcm_start;
+  nsamples=OP_MIN(nsamples,_buf_size/nchannels);
+  if(nsamples<=0)return 0;
+  nsegments=(int)OP_MAX(OP_MIN(nsamples/OP_PARALLEL_SEGMENT_MIN,_nthreads),1);
+  /*The workers need their own view of the data, which we can only provide
+     when it is already in memory.
+    They also can't call a decode callback, which might not be thread-safe.*/
+  if(_of->map_data==NULL||_of->decode_cb!=NULL)nsegments=1;
+  /*With one segment, this is exactly a sequential decode.*/
+  if(nsegments<=1){
+    return op_decode_range_float(_of,_pcm_start,_pcm_start+nsamples,
+     _pcm,(int)nsamples*nchannels);
+  }
+  index_size=0;
+  ret=op_link_index_export(_of,NULL,&index_size);
+  if(OP_UNLIKELY(ret<0))return ret;
+  index=(unsigned char *)_ogg_malloc(index_size);
+  jobs=(OpusDecodeRangeJob *)_ogg_malloc(sizeof(*jobs)*nsegments);
+  threads=(OpusThread *)_ogg_malloc(sizeof(*threads)*nsegments);
+  if(OP_UNLIKELY(index==NULL)||OP_UNLIKELY(jobs==NULL)
+   ||OP_UNLIKELY(threads==NULL)){
+    ret=OP_EFAULT;
+  }
+  else ret=op_link_index_export(_of,index,&index_size);
+  if(OP_LIKELY(ret>=0)){
+    for(si=0;si<nsegments;si++){
+      ogg_int64_t seg_start;
+      ogg_int64_t seg_end;
+      seg_start=nsamples*si/nsegments;
+      seg_end=nsamples*(si+1)/nsegments;
+      /*The first segment uses the caller's stream, which saves an open.*/
+      jobs[si].of=si==0?_of:NULL;
+      jobs[si].data=_of->map_data;
+      jobs[si].size=(size_t)_of->map_size;
+      jobs[si].index=index;
+      jobs[si].index_size=index_size;
+      jobs[si].gain_type=_of->gain_type;
+      jobs[si].gain_offset_q8=_of->gain_offset_q8;
+      jobs[si].pcm_start=_pcm_start+seg_start;
+      jobs[si].pcm_end=_pcm_start+seg_end;
+      jobs[si].pcm=_pcm+seg_start*nchannels;
+      jobs[si].buf_size=(int)(seg_end-seg_start)*nchannels;
+      jobs[si].ret=OP_EFAULT;
+    }
+    /*Start a thread for each segment after the first, which we decode
+       ourselves.
+      Any job we could not start a thread for runs here afterwards.*/
+    for(si=1;si<nsegments;si++){
+      if(op_thread_start(threads+si,jobs+si)<0)jobs[si].of=_of;
+    }
+    op_decode_range_job_run(jobs+0);
+    for(si=1;si<nsegments;si++){
+      if(jobs[si].of==_of)op_decode_range_job_run(jobs+si);
+      else op_thread_join(threads+si);
+    }
+    /*Return everything up to the first segment that came up short.*/
+    ret=0;
+    for(si=0;si<nsegments;si++){
+      if(OP_UNLIKELY(jobs[si].ret<0)){
+        /*Report an error only if we have nothing to return.*/
+        if(ret==0)ret=jobs[si].ret;
+        break;
+      }
+      ret+=jobs[si].ret;
+      if(OP_UNLIKELY(jobs[si].ret<jobs[si].buf_size/nchannels))break;
+    }
+  }
+  _ogg_free(threads);
+  _ogg_free(jobs);
+  _ogg_free(index);
+  return ret;
+}
+#endif
@@ -129,104 +129,6 @@ static const OpusFileCallbacks OP_FILE_CALLBACKS={
 # include <stddef.h>
 # include <errno.h>
 
-/*Windows doesn't accept UTF-8 by default, and we don't have a wchar_t API,
-   so if we just pass the path to fopen(), then there'd be no way for a user
-   of our API to open a Unicode filename.
-  Instead, we translate from UTF-8 to UTF-16 and use Windows' wchar_t API.
-  This makes this API more consistent with platforms where the character set
-   used by fopen is the same as used on disk, which is generally UTF-8, and
-   with our metadata API, which always uses UTF-8.*/
-static wchar_t *op_utf8_to_utf16(const char *_src){
-  wchar_t *dst;
-  size_t   len;
-  len=strlen(_src);
-  /*Worst-case output is 1 wide character per 1 input character.*/
-  dst=(wchar_t *)_ogg_malloc(sizeof(*dst)*(len+1));
-  if(dst!=NULL){
-    size_t si;
-    size_t di;
-    for(di=si=0;si<len;si++){
-      int c0;
-      c0=(unsigned char)_src[si];
-      if(!(c0&0x80)){
-        /*Start byte says this is a 1-byte sequence.*/
-        dst[di++]=(wchar_t)c0;
-        continue;
-      }
-      else{
-        int c1;
-        /*This is safe, because c0 was not 0 and _src is NUL-terminated.*/
-        c1=(unsigned char)_src[si+1];
-        if((c1&0xC0)==0x80){
-          /*Found at least one continuation byte.*/
-          if((c0&0xE0)==0xC0){
-            wchar_t w;
-            /*Start byte says this is a 2-byte sequence.*/
-            w=(c0&0x1F)<<6|c1&0x3F;
-            if(w>=0x80U){
-              /*This is a 2-byte sequence that is not overlong.*/
-              dst[di++]=w;
-              si++;
-              continue;
-            }
-          }
-          else{
-            int c2;
-            /*This is safe, because c1 was not 0 and _src is NUL-terminated.*/
-            c2=(unsigned char)_src[si+2];
-            if((c2&0xC0)==0x80){
-              /*Found at least two continuation bytes.*/
-              if((c0&0xF0)==0xE0){
-                wchar_t w;
-                /*Start byte says this is a 3-byte sequence.*/
-                w=(c0&0xF)<<12|(c1&0x3F)<<6|c2&0x3F;
-                if(w>=0x800U&&(w<0xD800||w>=0xE000)&&w<0xFFFE){
-                  /*This is a 3-byte sequence that is not overlong, not a
-                     UTF-16 surrogate pair value, and not a 'not a character'
-                     value.*/
-                  dst[di++]=w;
-                  si+=2;
-                  continue;
-                }
-              }
-              else{
-                int c3;
-                /*This is safe, because c2 was not 0 and _src is
-                   NUL-terminated.*/
-                c3=(unsigned char)_src[si+3];
-                if((c3&0xC0)==0x80){
-                  /*Found at least three continuation bytes.*/
-                  if((c0&0xF8)==0xF0){
-                    opus_uint32 w;
-                    /*Start byte says this is a 4-byte sequence.*/
-                    w=(c0&7)<<18|(c1&0x3F)<<12|(c2&0x3F)<<6&(c3&0x3F);
-                    if(w>=0x10000U&&w<0x110000U){
-                      /*This is a 4-byte sequence that is not overlong and not
-                         greater than the largest valid Unicode code point.
-                        Convert it to a surrogate pair.*/
-                      w-=0x10000;
-                      dst[di++]=(wchar_t)(0xD800+(w>>10));
-                      dst[di++]=(wchar_t)(0xDC00+(w&0x3FF));
-                      si+=3;
-                      continue;
-                    }
-                  }
-                }
-              }
-            }
-          }
-        }
-      }
-      /*If we got here, we encountered an illegal UTF-8 sequence.*/
-      _ogg_free(dst);
-      return NULL;
-    }
-    OP_ASSERT(di<=len);
-    dst[di]='\0';
-  }
-  return dst;
-}
-
 /*fsetpos() internally dispatches to the win32 API call SetFilePointer().
   According to SetFilePointer()'s documentation [0], the behavior is
    undefined if you do not call it on "a file stored on a seeking device".
@@ -413,3 +315,466 @@ void *op_mem_stream_create(OpusFileCallbacks *_cb,
   }
   return stream;
 }
+
+const unsigned char *op_mem_stream_get_data(void *_stream,
+ const OpusFileCallbacks *_cb,opus_int64 *_size){
+  OpusMemStream *stream;
+  /*Both memory streams and mapped files use op_mem_read(), so this is enough
+     to identify them, no matter who filled in the callbacks.*/
+  if(_cb->read!=op_mem_read)return NULL;
+  stream=(OpusMemStream *)_stream;
+  *_size=(opus_int64)stream->size;
+  return stream->data;
+}
+
+#if defined(_WIN32)
+
+static int op_mmap_close(void *_stream){
+  OpusMemStream *stream;
+  int            ret;
+  stream=(OpusMemStream *)_stream;
+  ret=0;
+  if(stream->data!=NULL&&!UnmapViewOfFile((LPCVOID)stream->data))ret=EOF;
+  _ogg_free(stream);
+  return ret;
+}
+
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+
+static int op_mmap_close(void *_stream){
+  OpusMemStream *stream;
+  int            ret;
+  stream=(OpusMemStream *)_stream;
+  ret=0;
+  if(stream->data!=NULL&&munmap((void *)stream->data,(size_t)stream->size)){
+    ret=EOF;
+  }
+  _ogg_free(stream);
+  return ret;
+}
+
+#endif
+
+static const OpusFileCallbacks OP_MMAP_CALLBACKS={
+  op_mem_read,
+  op_mem_seek,
+  op_mem_tell,
+  op_mmap_close
+};
+
+void *op_mmap_open(OpusFileCallbacks *_cb,const char *_path){
+  OpusMemStream *stream;
+  void          *data;
+  opus_int64     size;
+#if defined(_WIN32)
+  {
+    wchar_t       *wpath;
+    HANDLE         file;
+    HANDLE         mapping;
+    LARGE_INTEGER  file_size;
+    wpath=op_utf8_to_utf16(_path);
+    if(wpath==NULL){
+      errno=ENOENT;
+      return NULL;
+    }
+    file=CreateFileW(wpath,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,
+     FILE_FLAG_SEQUENTIAL_SCAN,NULL);
+    _ogg_free(wpath);
+    if(file==INVALID_HANDLE_VALUE){
+      errno=ENOENT;
+      return NULL;
+    }
+    if(!GetFileSizeEx(file,&file_size)){
+      CloseHandle(file);
+      errno=EIO;
+      return NULL;
+    }
+    size=(opus_int64)file_size.QuadPart;
+    if(size>(opus_int64)OP_MEM_SIZE_MAX){
+      CloseHandle(file);
+      errno=EFBIG;
+      return NULL;
+    }
+    data=NULL;
+    /*Windows refuses to map an empty file, but we can still "read" one.*/
+    if(size>0){
+      mapping=CreateFileMappingW(file,NULL,PAGE_READONLY,0,0,NULL);
+      if(mapping!=NULL){
+        data=MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+        /*The view keeps its own reference to the mapping.*/
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(file);
+    if(size>0&&data==NULL){
+      errno=ENOMEM;
+      return NULL;
+    }
+  }
+#else
+  {
+    struct stat st;
+    int         fd;
+    int         err;
+    fd=open(_path,O_RDONLY);
+    if(fd<0)return NULL;
+    if(fstat(fd,&st)<0){
+      err=errno;
+      close(fd);
+      errno=err;
+      return NULL;
+    }
+    /*Pipes, sockets, and the like cannot be mapped.*/
+    if(!S_ISREG(st.st_mode)){
+      close(fd);
+      errno=ENODEV;
+      return NULL;
+    }
+    size=(opus_int64)st.st_size;
+    if(size<0||size>(opus_int64)OP_MEM_SIZE_MAX){
+      close(fd);
+      errno=EFBIG;
+      return NULL;
+    }
+    data=NULL;
+    /*POSIX does not allow mapping 0 bytes, but we can still "read" them.*/
+    if(size>0){
+      data=mmap(NULL,(size_t)size,PROT_READ,MAP_PRIVATE,fd,0);
+      if(data==MAP_FAILED){
+        err=errno;
+        close(fd);
+        errno=err;
+        return NULL;
+      }
+# if defined(MADV_SEQUENTIAL)
+      /*Most access is a forward scan, so ask for aggressive read-ahead.
+        This is only a hint, so we don't care if it fails.*/
+      madvise(data,(size_t)size,MADV_SEQUENTIAL);
+# endif
+    }
+    /*The mapping remains valid after the descriptor is closed.*/
+    close(fd);
+  }
+#endif
+  stream=(OpusMemStream *)_ogg_malloc(sizeof(*stream));
+  if(stream==NULL){
+#if defined(_WIN32)
+    if(data!=NULL)UnmapViewOfFile(data);
+#else
+    if(data!=NULL)munmap(data,(size_t)size);
+#endif
+    errno=ENOMEM;
+    return NULL;
+  }
+  stream->data=(const unsigned char *)data;
+  stream->size=(ptrdiff_t)size;
+  stream->pos=0;
+  *_cb=*&OP_MMAP_CALLBACKS;
+  return stream;
+}
+
+typedef struct OpusChainMember OpusChainMember;
+typedef struct OpusChainStream OpusChainStream;
+
+/*One of the sources concatenated by a chain stream.*/
+struct OpusChainMember{
+  /*One of OP_CHAIN_SOURCE_FILE, OP_CHAIN_SOURCE_MEMORY, or
+     OP_CHAIN_SOURCE_CALLBACKS.*/
+  int                type;
+  /*Our own copy of the path, for OP_CHAIN_SOURCE_FILE.*/
+  char              *path;
+  /*The open stream, or NULL if it has been closed.
+    Only files ever get closed before the chain is.*/
+  void              *stream;
+  /*The callbacks used to access the stream.*/
+  OpusFileCallbacks  cb;
+  /*The offset of the start of this member in the chain.*/
+  opus_int64         offset;
+  /*The size of this member.*/
+  opus_int64         size;
+  /*The current position of the member's own stream, or -1 if unknown.*/
+  opus_int64         pos;
+  /*When this member was last read, for closing the least recently used
+     file.*/
+  opus_uint32        stamp;
+};
+
+/*The context information needed to read from a list of sources as if they
+   were a single file, one after another.*/
+struct OpusChainStream{
+  /*The sources, in order.*/
+  OpusChainMember *members;
+  /*The number of sources.*/
+  int              nmembers;
+  /*The number of files currently open.*/
+  int              nopen;
+  /*The maximum number of files to keep open at once.*/
+  int              max_open;
+  /*Whether or not closing the chain closes the streams of
+     OP_CHAIN_SOURCE_CALLBACKS sources.*/
+  int              own_callbacks;
+  /*The total size of all the sources.*/
+  opus_int64       size;
+  /*The current position in the chain.*/
+  opus_int64       pos;
+  /*A counter used to find the least recently used file.*/
+  opus_uint32      stamp;
+};
+
+/*Make sure the stream for member _mi is open, closing the least recently used
+   file if that would put us over the limit.*/
+static int op_chain_member_open(OpusChainStream *_chain,int _mi){
+  OpusChainMember *members;
+  OpusChainMember *member;
+  members=_chain->members;
+  member=members+_mi;
+  member->stamp=++_chain->stamp;
+  if(member->stream!=NULL)return 0;
+  OP_ASSERT(member->type==OP_CHAIN_SOURCE_FILE);
+  if(_chain->nopen>=_chain->max_open){
+    int mi;
+    int lru;
+    lru=-1;
+    for(mi=0;mi<_chain->nmembers;mi++){
+      if(members[mi].type==OP_CHAIN_SOURCE_FILE&&members[mi].stream!=NULL
+       &&(lru<0||_chain->stamp-members[mi].stamp
+       >_chain->stamp-members[lru].stamp)){
+        lru=mi;
+      }
+    }
+    if(lru>=0){
+      (*members[lru].cb.close)(members[lru].stream);
+      members[lru].stream=NULL;
+      _chain->nopen--;
+    }
+  }
+  member->stream=op_fopen(&member->cb,member->path,"rb");
+  if(member->stream==NULL)return -1;
+  _chain->nopen++;
+  member->pos=0;
+  return 0;
+}
+
+/*Find the member containing offset _pos, or nmembers if it is past the end.
+  Empty members never contain anything.*/
+static int op_chain_find(const OpusChainStream *_chain,opus_int64 _pos){
+  const OpusChainMember *members;
+  int                    lo;
+  int                    hi;
+  members=_chain->members;
+  if(_pos>=_chain->size)return _chain->nmembers;
+  /*Find the last member starting at or before _pos, which skips any empty
+     members that start at the same place.*/
+  lo=0;
+  hi=_chain->nmembers;
+  while(hi-lo>1){
+    int mid;
+    mid=lo+(hi-lo>>1);
+    if(members[mid].offset<=_pos)lo=mid;
+    else hi=mid;
+  }
+  return lo;
+}
+
+static int op_chain_read(void *_stream,unsigned char *_ptr,int _buf_size){
+  OpusChainStream *chain;
+  OpusChainMember *member;
+  opus_int64       rel;
+  int              mi;
+  int              ret;
+  chain=(OpusChainStream *)_stream;
+  /*Check for empty read.*/
+  if(_buf_size<=0)return 0;
+  mi=op_chain_find(chain,chain->pos);
+  /*Check for EOF.*/
+  if(mi>=chain->nmembers)return 0;
+  if(op_chain_member_open(chain,mi)<0)return -1;
+  member=chain->members+mi;
+  rel=chain->pos-member->offset;
+  if(member->pos!=rel){
+    if((*member->cb.seek)(member->stream,rel,SEEK_SET)){
+      member->pos=-1;
+      return -1;
+    }
+    member->pos=rel;
+  }
+  /*Never read past the end of a member, even if it has grown since we opened
+     it.
+    A short read is fine: the next one picks up with the following member.*/
+  _buf_size=(int)OP_MIN(member->size-rel,_buf_size);
+  ret=(*member->cb.read)(member->stream,_ptr,_buf_size);
+  if(ret<0){
+    member->pos=-1;
+    return ret;
+  }
+  member->pos+=ret;
+  chain->pos+=ret;
+  return ret;
+}
+
+static int op_chain_seek(void *_stream,opus_int64 _offset,int _whence){
+  OpusChainStream *chain;
+  opus_int64       pos;
+  chain=(OpusChainStream *)_stream;
+  switch(_whence){
+    case SEEK_SET:pos=0;break;
+    case SEEK_CUR:pos=chain->pos;break;
+    case SEEK_END:pos=chain->size;break;
+    default:return -1;
+  }
+  /*Check for overflow.*/
+  if(_offset<-pos||_offset>OP_INT64_MAX-pos)return -1;
+  /*Nothing is read until the next call to op_chain_read().*/
+  chain->pos=pos+_offset;
+  return 0;
+}
+
+static opus_int64 op_chain_tell(void *_stream){
+  OpusChainStream *chain;
+  chain=(OpusChainStream *)_stream;
+  return chain->pos;
+}
+
+static int op_chain_close(void *_stream){
+  OpusChainStream *chain;
+  int              ret;
+  int              mi;
+  chain=(OpusChainStream *)_stream;
+  ret=0;
+  for(mi=0;mi<chain->nmembers;mi++){
+    OpusChainMember *member;
+    member=chain->members+mi;
+    if(member->stream!=NULL&&member->cb.close!=NULL
+     &&(member->type!=OP_CHAIN_SOURCE_CALLBACKS||chain->own_callbacks)){
+      if((*member->cb.close)(member->stream))ret=EOF;
+    }
+    _ogg_free(member->path);
+  }
+  _ogg_free(chain->members);
+  _ogg_free(chain);
+  return ret;
+}
+
+static const OpusFileCallbacks OP_CHAIN_CALLBACKS={
+  op_chain_read,
+  op_chain_seek,
+  op_chain_tell,
+  op_chain_close
+};
+
+/*Set up member _mi from _source, and find its size.*/
+static int op_chain_member_init(OpusChainStream *_chain,int _mi,
+ const OpusChainSource *_source){
+  OpusChainMember *member;
+  opus_int64       size;
+  member=_chain->members+_mi;
+  member->type=_source->type;
+  member->path=NULL;
+  member->stream=NULL;
+  member->pos=-1;
+  member->stamp=0;
+  switch(_source->type){
+    case OP_CHAIN_SOURCE_FILE:{
+      size_t len;
+      if(_source->path==NULL)return -1;
+      len=strlen(_source->path)+1;
+      member->path=(char *)_ogg_malloc(len);
+      if(member->path==NULL)return -1;
+      memcpy(member->path,_source->path,len);
+      member->stream=op_fopen(&member->cb,member->path,"rb");
+      if(member->stream==NULL)return -1;
+      _chain->nopen++;
+    }break;
+    case OP_CHAIN_SOURCE_MEMORY:{
+      member->stream=op_mem_stream_create(&member->cb,
+       _source->data,_source->size);
+      if(member->stream==NULL)return -1;
+    }break;
+    case OP_CHAIN_SOURCE_CALLBACKS:{
+      if(_source->stream==NULL||_source->cb==NULL)return -1;
+      member->stream=_source->stream;
+      *&member->cb=*_source->cb;
+    }break;
+    default:return -1;
+  }
+  if(member->cb.seek==NULL||member->cb.tell==NULL
+   ||(*member->cb.seek)(member->stream,0,SEEK_END)){
+    return -1;
+  }
+  size=(*member->cb.tell)(member->stream);
+  if(size<0||size>OP_INT64_MAX-_chain->size)return -1;
+  member->offset=_chain->size;
+  member->size=size;
+  _chain->size+=size;
+  /*Don't hold on to more files than we're allowed.
+    Sizing them all up front is the only time every file gets opened.*/
+  if(member->type==OP_CHAIN_SOURCE_FILE&&_chain->nopen>_chain->max_open){
+    (*member->cb.close)(member->stream);
+    member->stream=NULL;
+    _chain->nopen--;
+  }
+  return 0;
+}
+
+void *op_chain_stream_create(OpusFileCallbacks *_cb,
+ const OpusChainSource *_sources,int _nsources,int _max_open){
+  OpusChainStream *chain;
+  int              mi;
+  if(_nsources<=0||_max_open<=0
+   ||(size_t)_nsources>~(size_t)0/sizeof(*chain->members)){
+    return NULL;
+  }
+  chain=(OpusChainStream *)_ogg_malloc(sizeof(*chain));
+  if(chain==NULL)return NULL;
+  chain->members=(OpusChainMember *)_ogg_malloc(
+   sizeof(*chain->members)*_nsources);
+  if(chain->members==NULL){
+    _ogg_free(chain);
+    return NULL;
+  }
+  chain->nmembers=0;
+  chain->nopen=0;
+  chain->max_open=_max_open;
+  chain->own_callbacks=0;
+  chain->size=0;
+  chain->pos=0;
+  chain->stamp=0;
+  for(mi=0;mi<_nsources;mi++){
+    int ret;
+    ret=op_chain_member_init(chain,mi,_sources+mi);
+    /*Count the member even on failure, so that closing the chain cleans up
+       whatever it managed to open.*/
+    chain->nmembers=mi+1;
+    if(ret<0){
+      op_chain_close(chain);
+      return NULL;
+    }
+  }
+  *_cb=*&OP_CHAIN_CALLBACKS;
+  return chain;
+}
+
+int op_is_chain_stream(const OpusFileCallbacks *_cb){
+  return _cb->read==op_chain_read;
+}
+
+void op_chain_stream_own_callbacks(void *_stream){
+  ((OpusChainStream *)_stream)->own_callbacks=1;
+}
+
+int op_chain_stream_nmembers(void *_stream){
+  return ((OpusChainStream *)_stream)->nmembers;
+}
+
+void op_chain_stream_member_range(void *_stream,int _mi,
+ opus_int64 *_offset,opus_int64 *_size){
+  OpusChainStream *chain;
+  chain=(OpusChainStream *)_stream;
+  OP_ASSERT(_mi>=0&&_mi<chain->nmembers);
+  *_offset=chain->members[_mi].offset;
+  *_size=chain->members[_mi].size;
+}